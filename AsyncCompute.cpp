@@ -0,0 +1,165 @@
+#include "AsyncCompute.h"
+
+#include <cassert>
+#include <chrono>
+
+AsyncCompute::AsyncCompute(VkDevice device, VkQueue queue, uint32_t queueFamily, uint32_t frameCount)
+	: mDevice(device), mQueue(queue), mQueueFamily(queueFamily), mFrames(frameCount)
+{
+	mTimeline = createTimeline(mDevice);
+
+	for (auto &frame : mFrames)
+	{
+		VkCommandPoolCreateInfo commandPoolCreateInfo{};
+		{
+			commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			commandPoolCreateInfo.queueFamilyIndex = mQueueFamily;
+		}
+
+		VkResult res = vkCreateCommandPool(mDevice, &commandPoolCreateInfo, nullptr, &frame.commandPool);
+		assert(res == VK_SUCCESS);
+
+		VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
+		{
+			commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			commandBufferAllocateInfo.commandPool = frame.commandPool;
+			commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			commandBufferAllocateInfo.commandBufferCount = 1;
+		}
+
+		res = vkAllocateCommandBuffers(mDevice, &commandBufferAllocateInfo, &frame.commandBuffer);
+		assert(res == VK_SUCCESS);
+	}
+}
+
+AsyncCompute::~AsyncCompute()
+{
+	// the owner waits for the device before destroying this.
+	for (auto &frame : mFrames)
+	{
+		vkDestroyCommandPool(mDevice, frame.commandPool, nullptr);
+	}
+	vkDestroySemaphore(mDevice, mTimeline, nullptr);
+}
+
+VkSemaphore AsyncCompute::createTimeline(VkDevice device)
+{
+	VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo{};
+	{
+		semaphoreTypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		semaphoreTypeCreateInfo.initialValue = 0;
+	}
+
+	VkSemaphoreCreateInfo semaphoreCreateInfo{};
+	{
+		semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+	}
+
+	VkSemaphore semaphore = VK_NULL_HANDLE;
+	VkResult res = vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphore);
+	assert(res == VK_SUCCESS);
+	return semaphore;
+}
+
+VkCommandBuffer AsyncCompute::begin(uint32_t frame)
+{
+	Frame &slot = mFrames[frame];
+
+	// usually long finished, the graphics frame that last used the slot waited on it.
+	wait(slot.value);
+	vkResetCommandPool(mDevice, slot.commandPool, 0);
+
+	VkCommandBufferBeginInfo commandBufferBeginInfo{};
+	{
+		commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	}
+
+	VkResult res = vkBeginCommandBuffer(slot.commandBuffer, &commandBufferBeginInfo);
+	assert(res == VK_SUCCESS);
+	return slot.commandBuffer;
+}
+
+uint64_t AsyncCompute::submit(uint32_t frame, VkSemaphore waitSemaphore, uint64_t waitValue, VkPipelineStageFlags2 waitStages)
+{
+	Frame &slot = mFrames[frame];
+
+	VkResult res = vkEndCommandBuffer(slot.commandBuffer);
+	assert(res == VK_SUCCESS);
+
+	slot.value = mNextValue++;
+
+	VkSemaphoreSubmitInfo waitInfo{};
+	{
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+		waitInfo.semaphore = waitSemaphore;
+		waitInfo.value = waitValue;
+		waitInfo.stageMask = waitStages;
+	}
+
+	VkSemaphoreSubmitInfo signalInfo{};
+	{
+		signalInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+		signalInfo.semaphore = mTimeline;
+		signalInfo.value = slot.value;
+		signalInfo.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+	}
+
+	VkCommandBufferSubmitInfo commandBufferInfo{};
+	{
+		commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+		commandBufferInfo.commandBuffer = slot.commandBuffer;
+	}
+
+	// waiting on a value the other queue already reached costs nothing.
+	bool waits = waitSemaphore != VK_NULL_HANDLE && waitValue > 0;
+	VkSubmitInfo2 submitInfo{};
+	{
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+		submitInfo.waitSemaphoreInfoCount = waits ? 1 : 0;
+		submitInfo.pWaitSemaphoreInfos = waits ? &waitInfo : nullptr;
+		submitInfo.commandBufferInfoCount = 1;
+		submitInfo.pCommandBufferInfos = &commandBufferInfo;
+		submitInfo.signalSemaphoreInfoCount = 1;
+		submitInfo.pSignalSemaphoreInfos = &signalInfo;
+	}
+
+	res = vkQueueSubmit2(mQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	assert(res == VK_SUCCESS);
+
+	++mStats.submitCount;
+	if (waits)
+	{
+		++mStats.waitCount;
+	}
+	return slot.value;
+}
+
+void AsyncCompute::waitIdle()
+{
+	wait(submittedValue());
+}
+
+void AsyncCompute::wait(uint64_t value)
+{
+	uint64_t completed = 0;
+	vkGetSemaphoreCounterValue(mDevice, mTimeline, &completed);
+	if (completed >= value)
+		return;
+
+	auto waitStart = std::chrono::steady_clock::now();
+	VkSemaphoreWaitInfo semaphoreWaitInfo{};
+	{
+		semaphoreWaitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		semaphoreWaitInfo.semaphoreCount = 1;
+		semaphoreWaitInfo.pSemaphores = &mTimeline;
+		semaphoreWaitInfo.pValues = &value;
+	}
+
+	VkResult res = vkWaitSemaphores(mDevice, &semaphoreWaitInfo, UINT64_MAX);
+	assert(res == VK_SUCCESS);
+	mStats.hostWaitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+struct AsyncComputeStats
+{
+	uint64_t submitCount = 0;
+	uint64_t waitCount = 0; // submits that waited on another queue's timeline.
+	double hostWaitMs = 0.0; // begin() blocked on a slot's previous submit.
+};
+
+// Submits compute work on its own queue, next to the graphics queue. Every submit signals the
+// next value of a timeline semaphore; a graphics submit consuming the results waits on that
+// value at the stage reading them, so compute of one frame overlaps the graphics work of the
+// previous one. A submit can in turn wait on a value of another queue's timeline semaphore.
+// Resources written here and read by graphics have to be shared by both queue families
+// (VK_SHARING_MODE_CONCURRENT) or transferred by the caller.
+class AsyncCompute
+{
+public:
+	// queue is the compute queue, a dedicated family or a second queue of the graphics family.
+	AsyncCompute(VkDevice device, VkQueue queue, uint32_t queueFamily, uint32_t frameCount);
+	~AsyncCompute();
+
+	AsyncCompute(const AsyncCompute &) = delete;
+	AsyncCompute &operator=(const AsyncCompute &) = delete;
+
+	// waits until the slot's previous submit finished, resets its pool and begins its command buffer.
+	VkCommandBuffer begin(uint32_t frame);
+
+	// ends the slot's command buffer and submits it, after waitSemaphore reached waitValue when
+	// one is given. Returns the timeline value signaled once the work finished.
+	uint64_t submit(uint32_t frame, VkSemaphore waitSemaphore = VK_NULL_HANDLE, uint64_t waitValue = 0,
+					VkPipelineStageFlags2 waitStages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+
+	VkSemaphore timeline() const { return mTimeline; }
+	uint32_t queueFamily() const { return mQueueFamily; }
+	// value of the last submit, 0 before the first one.
+	uint64_t submittedValue() const { return mNextValue - 1; }
+
+	// blocks until everything submitted so far finished, used by benchmarks and shutdown.
+	void waitIdle();
+
+	const AsyncComputeStats &stats() const { return mStats; }
+
+	// creates a timeline semaphore starting at 0, also used for the graphics side.
+	static VkSemaphore createTimeline(VkDevice device);
+
+private:
+	struct Frame
+	{
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		uint64_t value = 0; // timeline value of the slot's last submit.
+	};
+
+	void wait(uint64_t value);
+
+	VkDevice mDevice;
+	VkQueue mQueue;
+	uint32_t mQueueFamily;
+
+	VkSemaphore mTimeline = VK_NULL_HANDLE;
+	uint64_t mNextValue = 1;
+	std::vector<Frame> mFrames;
+	AsyncComputeStats mStats;
+};
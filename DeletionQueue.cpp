@@ -0,0 +1,29 @@
+#include "DeletionQueue.h"
+
+#include <algorithm>
+
+void DeletionQueue::push(uint64_t lastUseFrame, std::function<void()> deleter)
+{
+	// entries are almost always pushed in frame order, the search only skips a few later ones.
+	auto later = std::find_if(mEntries.rbegin(), mEntries.rend(), [lastUseFrame](const Entry &entry)
+							  { return entry.lastUseFrame <= lastUseFrame; });
+	mEntries.insert(later.base(), {lastUseFrame, std::move(deleter)});
+}
+
+void DeletionQueue::flush(uint64_t completedFrame)
+{
+	while (!mEntries.empty() && mEntries.front().lastUseFrame <= completedFrame)
+	{
+		mEntries.front().deleter();
+		mEntries.pop_front();
+	}
+}
+
+void DeletionQueue::flushAll()
+{
+	while (!mEntries.empty())
+	{
+		mEntries.front().deleter();
+		mEntries.pop_front();
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+// Defers destruction of GPU objects until the frames that may still use them completed.
+class DeletionQueue
+{
+public:
+	// deleter runs once every frame up to and including lastUseFrame finished on the GPU.
+	void push(uint64_t lastUseFrame, std::function<void()> deleter);
+
+	// runs the deleters of all entries whose last use is at or before completedFrame.
+	void flush(uint64_t completedFrame);
+
+	// runs everything, only valid once the device is idle.
+	void flushAll();
+
+	size_t size() const { return mEntries.size(); }
+
+private:
+	struct Entry
+	{
+		uint64_t lastUseFrame;
+		std::function<void()> deleter;
+	};
+
+	// sorted by frame, so the oldest entries are always at the front.
+	std::deque<Entry> mEntries;
+};
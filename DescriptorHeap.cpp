@@ -0,0 +1,222 @@
+#include "DescriptorHeap.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+	const VkDescriptorType kDescriptorTypes[] = {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_SAMPLER};
+	const char *const kDescriptorTypeNames[] = {"sampled image", "storage buffer", "sampler"};
+}
+
+uint32_t DescriptorSlotAllocator::allocate()
+{
+	if (!mFreeSlots.empty())
+	{
+		uint32_t slot = mFreeSlots.back();
+		mFreeSlots.pop_back();
+		return slot;
+	}
+	if (mNextSlot < mCapacity)
+	{
+		return mNextSlot++;
+	}
+	return kInvalidSlot;
+}
+
+void DescriptorSlotAllocator::free(uint32_t slot, uint64_t lastUseFrame)
+{
+	assert(slot < mNextSlot);
+	mPendingSlots.push_back({lastUseFrame, slot});
+}
+
+void DescriptorSlotAllocator::recycle(uint64_t completedFrame)
+{
+	while (!mPendingSlots.empty() && mPendingSlots.front().lastUseFrame <= completedFrame)
+	{
+		mFreeSlots.push_back(mPendingSlots.front().slot);
+		mPendingSlots.pop_front();
+	}
+}
+
+DescriptorHeap::DescriptorHeap(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t sampledImageCount,
+							   uint32_t storageBufferCount, uint32_t samplerCount)
+	: mDevice(device)
+{
+	VkPhysicalDeviceVulkan12Properties properties12{};
+	properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+	VkPhysicalDeviceProperties2 properties2{};
+	properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties2.pNext = &properties12;
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+
+	// every array is visible to all stages, so the per-stage limits apply as well as the per-set ones.
+	uint32_t counts[] = {
+		std::min({sampledImageCount, properties12.maxDescriptorSetUpdateAfterBindSampledImages, properties12.maxPerStageDescriptorUpdateAfterBindSampledImages}),
+		std::min({storageBufferCount, properties12.maxDescriptorSetUpdateAfterBindStorageBuffers, properties12.maxPerStageDescriptorUpdateAfterBindStorageBuffers}),
+		std::min({samplerCount, properties12.maxDescriptorSetUpdateAfterBindSamplers, properties12.maxPerStageDescriptorUpdateAfterBindSamplers})};
+
+	VkDescriptorSetLayoutBinding bindings[3]{};
+	VkDescriptorBindingFlags bindingFlags[3]{};
+	VkDescriptorPoolSize poolSizes[3]{};
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = kDescriptorTypes[i];
+		bindings[i].descriptorCount = counts[i];
+		bindings[i].stageFlags = VK_SHADER_STAGE_ALL;
+		bindingFlags[i] = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT |
+						  VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+		poolSizes[i].type = kDescriptorTypes[i];
+		poolSizes[i].descriptorCount = counts[i];
+		mSlots.emplace_back(counts[i]);
+	}
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo{};
+	{
+		bindingFlagsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+		bindingFlagsCreateInfo.bindingCount = 3;
+		bindingFlagsCreateInfo.pBindingFlags = bindingFlags;
+	}
+
+	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
+	{
+		descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		descriptorSetLayoutCreateInfo.pNext = &bindingFlagsCreateInfo;
+		descriptorSetLayoutCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+		descriptorSetLayoutCreateInfo.bindingCount = 3;
+		descriptorSetLayoutCreateInfo.pBindings = bindings;
+	}
+
+	VkResult res = vkCreateDescriptorSetLayout(mDevice, &descriptorSetLayoutCreateInfo, nullptr, &mSetLayout);
+	assert(res == VK_SUCCESS);
+
+	VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{};
+	{
+		descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		descriptorPoolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		descriptorPoolCreateInfo.maxSets = 1;
+		descriptorPoolCreateInfo.poolSizeCount = 3;
+		descriptorPoolCreateInfo.pPoolSizes = poolSizes;
+	}
+
+	res = vkCreateDescriptorPool(mDevice, &descriptorPoolCreateInfo, nullptr, &mPool);
+	assert(res == VK_SUCCESS);
+
+	VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{};
+	{
+		descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		descriptorSetAllocateInfo.descriptorPool = mPool;
+		descriptorSetAllocateInfo.descriptorSetCount = 1;
+		descriptorSetAllocateInfo.pSetLayouts = &mSetLayout;
+	}
+
+	res = vkAllocateDescriptorSets(mDevice, &descriptorSetAllocateInfo, &mSet);
+	assert(res == VK_SUCCESS);
+}
+
+DescriptorHeap::~DescriptorHeap()
+{
+	// destroying the pool frees the set.
+	vkDestroyDescriptorPool(mDevice, mPool, nullptr);
+	vkDestroyDescriptorSetLayout(mDevice, mSetLayout, nullptr);
+}
+
+uint32_t DescriptorHeap::addSampledImage(VkImageView imageView, VkImageLayout layout)
+{
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageView = imageView;
+	imageInfo.imageLayout = layout;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	uint32_t slot = allocateSlot(DescriptorType::SampledImage);
+	write(DescriptorType::SampledImage, slot, &imageInfo, nullptr);
+	return slot;
+}
+
+uint32_t DescriptorHeap::addStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	VkDescriptorBufferInfo bufferInfo{};
+	bufferInfo.buffer = buffer;
+	bufferInfo.offset = offset;
+	bufferInfo.range = range;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	uint32_t slot = allocateSlot(DescriptorType::StorageBuffer);
+	write(DescriptorType::StorageBuffer, slot, nullptr, &bufferInfo);
+	return slot;
+}
+
+uint32_t DescriptorHeap::addSampler(VkSampler sampler)
+{
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.sampler = sampler;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	uint32_t slot = allocateSlot(DescriptorType::Sampler);
+	write(DescriptorType::Sampler, slot, &imageInfo, nullptr);
+	return slot;
+}
+
+void DescriptorHeap::free(DescriptorType type, uint32_t slot, uint64_t lastUseFrame)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mSlots[static_cast<uint32_t>(type)].free(slot, lastUseFrame);
+}
+
+void DescriptorHeap::recycle(uint64_t completedFrame)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	for (auto &slots : mSlots)
+	{
+		slots.recycle(completedFrame);
+	}
+}
+
+void DescriptorHeap::bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t firstSet) const
+{
+	vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout, firstSet, 1, &mSet, 0, nullptr);
+}
+
+DescriptorHeapStats DescriptorHeap::stats()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	DescriptorHeapStats stats;
+	for (uint32_t i = 0; i < static_cast<uint32_t>(DescriptorType::Count); ++i)
+	{
+		stats.capacity[i] = mSlots[i].capacity();
+		stats.used[i] = mSlots[i].used();
+	}
+	stats.writeCount = mWriteCount;
+	return stats;
+}
+
+uint32_t DescriptorHeap::allocateSlot(DescriptorType type)
+{
+	uint32_t slot = mSlots[static_cast<uint32_t>(type)].allocate();
+	if (slot == kInvalidSlot)
+	{
+		throw std::runtime_error(std::string("DescriptorHeap: out of ") + kDescriptorTypeNames[static_cast<uint32_t>(type)] + " slots.");
+	}
+	return slot;
+}
+
+void DescriptorHeap::write(DescriptorType type, uint32_t slot, const VkDescriptorImageInfo *imageInfo, const VkDescriptorBufferInfo *bufferInfo)
+{
+	VkWriteDescriptorSet writeDescriptorSet{};
+	{
+		writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writeDescriptorSet.dstSet = mSet;
+		writeDescriptorSet.dstBinding = static_cast<uint32_t>(type);
+		writeDescriptorSet.dstArrayElement = slot;
+		writeDescriptorSet.descriptorCount = 1;
+		writeDescriptorSet.descriptorType = kDescriptorTypes[static_cast<uint32_t>(type)];
+		writeDescriptorSet.pImageInfo = imageInfo;
+		writeDescriptorSet.pBufferInfo = bufferInfo;
+	}
+
+	vkUpdateDescriptorSets(mDevice, 1, &writeDescriptorSet, 0, nullptr);
+	++mWriteCount;
+}
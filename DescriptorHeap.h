@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+// Hands out array slots and recycles freed ones only after the frames that may still read them
+// completed, in the same frame numbering the DeletionQueue uses.
+class DescriptorSlotAllocator
+{
+public:
+	static const uint32_t kInvalidSlot = 0xffffffffu;
+
+	explicit DescriptorSlotAllocator(uint32_t capacity) : mCapacity(capacity) {}
+
+	// kInvalidSlot when every slot is taken or waiting to be recycled.
+	uint32_t allocate();
+	void free(uint32_t slot, uint64_t lastUseFrame);
+	// makes slots freed at or before completedFrame allocatable again.
+	void recycle(uint64_t completedFrame);
+
+	uint32_t capacity() const { return mCapacity; }
+	uint32_t used() const { return mNextSlot - static_cast<uint32_t>(mFreeSlots.size()); }
+
+private:
+	struct PendingSlot
+	{
+		uint64_t lastUseFrame;
+		uint32_t slot;
+	};
+
+	uint32_t mCapacity;
+	uint32_t mNextSlot = 0; // slots at and above this were never handed out.
+	std::vector<uint32_t> mFreeSlots;
+	std::deque<PendingSlot> mPendingSlots; // freed in frame order, oldest first.
+};
+
+enum class DescriptorType : uint32_t
+{
+	SampledImage,
+	StorageBuffer,
+	Sampler,
+	Count
+};
+
+struct DescriptorHeapStats
+{
+	uint32_t capacity[static_cast<uint32_t>(DescriptorType::Count)] = {};
+	uint32_t used[static_cast<uint32_t>(DescriptorType::Count)] = {};
+	uint64_t writeCount = 0;
+};
+
+// One descriptor set holding large arrays of sampled images (binding 0), storage buffers
+// (binding 1) and samplers (binding 2). The set is bound once per command buffer and shaders
+// index the arrays with slots passed in push constants, so there is no per-draw set allocation
+// or binding. UPDATE_AFTER_BIND with UPDATE_UNUSED_WHILE_PENDING lets slots be written while
+// frames using other slots are in flight, PARTIALLY_BOUND allows holes in the arrays.
+class DescriptorHeap
+{
+public:
+	static const uint32_t kInvalidSlot = DescriptorSlotAllocator::kInvalidSlot;
+
+	// counts are clamped to the device's update-after-bind limits.
+	DescriptorHeap(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t sampledImageCount = 16384,
+				   uint32_t storageBufferCount = 16384, uint32_t samplerCount = 256);
+	~DescriptorHeap();
+
+	DescriptorHeap(const DescriptorHeap &) = delete;
+	DescriptorHeap &operator=(const DescriptorHeap &) = delete;
+
+	// the returned slot is written immediately. Throws when the array is full.
+	uint32_t addSampledImage(VkImageView imageView, VkImageLayout layout);
+	uint32_t addStorageBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+	uint32_t addSampler(VkSampler sampler);
+
+	// the slot is reused once lastUseFrame completed, the resource must outlive that as well.
+	void free(DescriptorType type, uint32_t slot, uint64_t lastUseFrame);
+	void recycle(uint64_t completedFrame);
+
+	void bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t firstSet = 0) const;
+
+	VkDescriptorSetLayout setLayout() const { return mSetLayout; }
+	DescriptorHeapStats stats();
+
+private:
+	uint32_t allocateSlot(DescriptorType type);
+	void write(DescriptorType type, uint32_t slot, const VkDescriptorImageInfo *imageInfo, const VkDescriptorBufferInfo *bufferInfo);
+
+	VkDevice mDevice;
+	VkDescriptorSetLayout mSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool mPool = VK_NULL_HANDLE;
+	VkDescriptorSet mSet = VK_NULL_HANDLE;
+
+	std::mutex mMutex;
+	std::vector<DescriptorSlotAllocator> mSlots; // indexed by DescriptorType.
+	uint64_t mWriteCount = 0;
+};
@@ -0,0 +1,216 @@
+#include "DrawQueue.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+	const uint32_t kKeyBytes = 8;
+	// below this the workers cost more than they save.
+	const uint32_t kParallelSortMinimum = 16384;
+}
+
+uint64_t DrawBindStats::totalIssued() const
+{
+	uint64_t total = 0;
+	for (uint64_t count : issued)
+	{
+		total += count;
+	}
+	return total;
+}
+
+uint64_t DrawBindStats::totalSkipped() const
+{
+	uint64_t total = 0;
+	for (uint64_t count : skipped)
+	{
+		total += count;
+	}
+	return total;
+}
+
+DrawBindStats &DrawBindStats::operator+=(const DrawBindStats &other)
+{
+	for (uint32_t state = 0; state < static_cast<uint32_t>(DrawState::Count); ++state)
+	{
+		issued[state] += other.issued[state];
+		skipped[state] += other.skipped[state];
+	}
+	return *this;
+}
+
+DrawStateFilter::DrawStateFilter()
+{
+	std::fill(std::begin(mBound), std::end(mBound), UINT32_MAX);
+}
+
+bool DrawStateFilter::changed(DrawState state, uint32_t value)
+{
+	uint32_t index = static_cast<uint32_t>(state);
+	if (mBound[index] == value)
+	{
+		++mStats.skipped[index];
+		return false;
+	}
+	mBound[index] = value;
+	++mStats.issued[index];
+	return true;
+}
+
+DrawQueue::DrawQueue(uint32_t threadCount)
+{
+	if (threadCount > 0)
+	{
+		mThreads = std::make_unique<ThreadPool>(threadCount);
+	}
+}
+
+DrawQueue::~DrawQueue() = default;
+
+uint64_t DrawQueue::makeKey(uint32_t pass, uint32_t pipeline, uint32_t mesh, uint32_t material, float depth)
+{
+	if (pass >= kMaxPasses || pipeline >= kMaxPipelines || mesh >= kMaxMeshes || material >= kMaxMaterials)
+		throw std::runtime_error("draw queue: pass, pipeline, mesh or material id out of range.");
+
+	// non-negative floats order like their bits; dropping 3 mantissa bits leaves 28, infinity included.
+	float clamped = depth > 0.0f ? depth : 0.0f;
+	uint32_t depthBits;
+	std::memcpy(&depthBits, &clamped, sizeof(depthBits));
+
+	return (static_cast<uint64_t>(pass) << 60) | (static_cast<uint64_t>(pipeline) << 52) | (static_cast<uint64_t>(mesh) << 44) |
+		   (static_cast<uint64_t>(material) << 28) | (depthBits >> 3);
+}
+
+void DrawQueue::clear()
+{
+	mPackets.clear();
+	mBatches.clear();
+}
+
+void DrawQueue::reserve(uint32_t count)
+{
+	mPackets.reserve(count);
+}
+
+void DrawQueue::sort()
+{
+	uint32_t count = size();
+	if (count < 2)
+		return;
+
+	// every chunk counts and scatters its own contiguous range, chunks in order keep the sort stable.
+	uint32_t chunkCount = count >= kParallelSortMinimum ? std::max(threadCount(), 1u) : 1;
+	uint32_t chunkSize = (count + chunkCount - 1) / chunkCount;
+	mScratch.resize(count);
+	mHistograms.assign(static_cast<size_t>(chunkCount) * kKeyBytes * 256, 0);
+	auto histogram = [this](uint32_t chunk, uint32_t byte)
+	{ return &mHistograms[(static_cast<size_t>(chunk) * kKeyBytes + byte) * 256]; };
+
+	// one read counts every byte, the totals show which bytes vary at all.
+	forEachChunk(chunkCount, [&](uint32_t chunk)
+				 {
+		uint32_t end = std::min(count, (chunk + 1) * chunkSize);
+		uint32_t *counts = histogram(chunk, 0);
+		for (uint32_t i = chunk * chunkSize; i < end; ++i)
+		{
+			uint64_t key = mPackets[i].key;
+			for (uint32_t byte = 0; byte < kKeyBytes; ++byte)
+			{
+				++counts[byte * 256 + ((key >> (byte * 8)) & 0xff)];
+			}
+		} });
+
+	bool countsCurrent = true;
+	for (uint32_t byte = 0; byte < kKeyBytes; ++byte)
+	{
+		// a byte all packets share would leave the order as it is.
+		uint32_t shift = byte * 8;
+		uint32_t value = static_cast<uint32_t>(mPackets[0].key >> shift) & 0xff;
+		uint32_t packetsWithValue = 0;
+		for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+		{
+			packetsWithValue += histogram(chunk, byte)[value];
+		}
+		if (packetsWithValue == count)
+			continue;
+
+		// the per chunk counts only describe the order they were taken in, a scatter moved packets.
+		if (!countsCurrent)
+		{
+			forEachChunk(chunkCount, [&](uint32_t chunk)
+						 {
+				uint32_t end = std::min(count, (chunk + 1) * chunkSize);
+				uint32_t *counts = histogram(chunk, byte);
+				std::fill(counts, counts + 256, 0u);
+				for (uint32_t i = chunk * chunkSize; i < end; ++i)
+				{
+					++counts[(mPackets[i].key >> shift) & 0xff];
+				} });
+		}
+
+		// a chunk's packets of one value go after all smaller values and the earlier chunks' packets.
+		uint32_t offset = 0;
+		for (uint32_t value = 0; value < 256; ++value)
+		{
+			for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+			{
+				uint32_t &slot = histogram(chunk, byte)[value];
+				uint32_t packets = slot;
+				slot = offset;
+				offset += packets;
+			}
+		}
+
+		forEachChunk(chunkCount, [&](uint32_t chunk)
+					 {
+			uint32_t end = std::min(count, (chunk + 1) * chunkSize);
+			uint32_t *offsets = histogram(chunk, byte);
+			for (uint32_t i = chunk * chunkSize; i < end; ++i)
+			{
+				mScratch[offsets[(mPackets[i].key >> shift) & 0xff]++] = mPackets[i];
+			} });
+		mPackets.swap(mScratch);
+		countsCurrent = false;
+	}
+}
+
+void DrawQueue::buildBatches(uint32_t *instances)
+{
+	mBatches.clear();
+	uint64_t currentState = UINT64_MAX;
+	for (uint32_t i = 0; i < size(); ++i)
+	{
+		uint64_t key = mPackets[i].key;
+		if (key >> 28 != currentState)
+		{
+			DrawBatch batch{};
+			batch.pass = pass(key);
+			batch.pipeline = pipeline(key);
+			batch.mesh = mesh(key);
+			batch.material = material(key);
+			batch.firstInstance = i;
+			mBatches.push_back(batch);
+			currentState = key >> 28;
+		}
+		++mBatches.back().instanceCount;
+		instances[i] = mPackets[i].object;
+	}
+}
+
+void DrawQueue::forEachChunk(uint32_t chunkCount, const std::function<void(uint32_t chunk)> &function)
+{
+	if (chunkCount == 1)
+	{
+		function(0);
+		return;
+	}
+	for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+	{
+		mThreads->submit([&function, chunk]()
+						 { function(chunk); });
+	}
+	// the jobs reference function, wait before returning.
+	mThreads->waitIdle();
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// one draw of the frame, object is its index into the scene.
+struct DrawPacket
+{
+	uint64_t key;
+	uint32_t object;
+};
+
+// packets merged into one instanced draw, instance i draws object instances[firstInstance + i].
+struct DrawBatch
+{
+	uint32_t pass;
+	uint32_t pipeline;
+	uint32_t mesh;
+	uint32_t material;
+	uint32_t firstInstance;
+	uint32_t instanceCount;
+};
+
+// State changes a draw can need, bound only when they differ from the previous draw's.
+enum class DrawState : uint32_t
+{
+	Pipeline,
+	Mesh,
+	Material,
+	Count
+};
+
+struct DrawBindStats
+{
+	uint64_t issued[static_cast<uint32_t>(DrawState::Count)] = {};
+	uint64_t skipped[static_cast<uint32_t>(DrawState::Count)] = {};
+
+	uint64_t totalIssued() const;
+	uint64_t totalSkipped() const;
+	DrawBindStats &operator+=(const DrawBindStats &other);
+};
+
+// The state last bound in one command buffer, which starts with nothing bound: secondaries
+// inherit no state from the primary, each needs a filter of its own.
+class DrawStateFilter
+{
+public:
+	DrawStateFilter();
+
+	// true if value differs from the bound state, the caller then records the bind.
+	bool changed(DrawState state, uint32_t value);
+	const DrawBindStats &stats() const { return mStats; }
+
+private:
+	uint32_t mBound[static_cast<uint32_t>(DrawState::Count)];
+	DrawBindStats mStats;
+};
+
+// Draw packets sorted by a 64-bit key holding, from high to low bits, the pass (4 bits), pipeline
+// (8), mesh (8), material (16) and view depth (28), so the sorted queue changes the costliest
+// state least often and draws each state's objects front to back. The sort is an LSD radix sort,
+// split across worker threads for large queues.
+class DrawQueue
+{
+public:
+	static const uint32_t kMaxPasses = 16;
+	static const uint32_t kMaxPipelines = 256;
+	static const uint32_t kMaxMeshes = 256;
+	static const uint32_t kMaxMaterials = 65536;
+
+	// threadCount 0 sorts on the calling thread.
+	explicit DrawQueue(uint32_t threadCount);
+	~DrawQueue();
+
+	DrawQueue(const DrawQueue &) = delete;
+	DrawQueue &operator=(const DrawQueue &) = delete;
+
+	// throws if an id exceeds its limit. depth is the view space distance, negative clamps to 0.
+	static uint64_t makeKey(uint32_t pass, uint32_t pipeline, uint32_t mesh, uint32_t material, float depth);
+	static uint32_t pass(uint64_t key) { return static_cast<uint32_t>(key >> 60); }
+	static uint32_t pipeline(uint64_t key) { return static_cast<uint32_t>(key >> 52) & 0xff; }
+	static uint32_t mesh(uint64_t key) { return static_cast<uint32_t>(key >> 44) & 0xff; }
+	static uint32_t material(uint64_t key) { return static_cast<uint32_t>(key >> 28) & 0xffff; }
+
+	void clear();
+	void reserve(uint32_t count);
+	void add(uint64_t key, uint32_t object) { mPackets.push_back({key, object}); }
+	uint32_t size() const { return static_cast<uint32_t>(mPackets.size()); }
+	uint32_t threadCount() const { return mThreads ? mThreads->threadCount() : 0; }
+
+	// stable, packets with equal keys keep the order they were added in.
+	void sort();
+	const std::vector<DrawPacket> &packets() const { return mPackets; }
+
+	// merges runs of sorted packets that differ only in depth into batches. instances receives
+	// size() object indices written front to back, so it may point into write-combined memory.
+	void buildBatches(uint32_t *instances);
+	const std::vector<DrawBatch> &batches() const { return mBatches; }
+
+private:
+	// runs function(chunk) for every chunk, on the workers when there is more than one.
+	void forEachChunk(uint32_t chunkCount, const std::function<void(uint32_t chunk)> &function);
+
+	std::vector<DrawPacket> mPackets;
+	std::vector<DrawPacket> mScratch;
+	std::vector<DrawBatch> mBatches;
+	std::vector<uint32_t> mHistograms; // [chunk][key byte][byte value] counts, then scatter offsets.
+	std::unique_ptr<ThreadPool> mThreads;
+};
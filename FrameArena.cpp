@@ -0,0 +1,84 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <string>
+
+FrameArena::FrameArena(VkDevice device, MemoryAllocator &allocator, uint32_t frameCount, VkDeviceSize frameCapacity)
+	: mDevice(device), mAllocator(allocator), mFrameCapacity(frameCapacity), mFrames(frameCount)
+{
+	for (auto &frame : mFrames)
+	{
+		VkBufferCreateInfo bufferCreateInfo{};
+		{
+			bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferCreateInfo.size = frameCapacity;
+			bufferCreateInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		}
+
+		VkResult res = vkCreateBuffer(mDevice, &bufferCreateInfo, nullptr, &frame.buffer.buffer);
+		assert(res == VK_SUCCESS);
+
+		// device local host visible memory (resizable BAR) spares the device reads over PCIe where available.
+		frame.buffer.allocation = mAllocator.allocateForBuffer(frame.buffer.buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+															   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		frame.linear = LinearAllocator(frameCapacity);
+	}
+}
+
+FrameArena::~FrameArena()
+{
+	for (auto &frame : mFrames)
+	{
+		vkDestroyBuffer(mDevice, frame.buffer.buffer, nullptr);
+		mAllocator.free(frame.buffer.allocation);
+	}
+}
+
+void FrameArena::beginFrame(uint32_t frame)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mCurrentFrame = frame;
+	mFrames[frame].linear.reset();
+}
+
+void FrameArena::flush()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	const Frame &frame = mFrames[mCurrentFrame];
+	if (frame.linear.used() > 0)
+	{
+		mAllocator.flush(frame.buffer.allocation);
+	}
+}
+
+ArenaSlice FrameArena::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	Frame &frame = mFrames[mCurrentFrame];
+
+	VkDeviceSize offset;
+	if (!frame.linear.allocate(size, alignment, offset))
+	{
+		throw std::runtime_error("FrameArena: " + std::to_string(size) + " bytes do not fit into the " +
+								 std::to_string(mFrameCapacity) + " byte frame budget.");
+	}
+
+	++mStats.allocationCount;
+	mStats.allocatedBytes += size;
+	mStats.peakFrameBytes = std::max(mStats.peakFrameBytes, frame.linear.used());
+
+	ArenaSlice slice;
+	slice.data = static_cast<uint8_t *>(frame.buffer.allocation.mapped) + offset;
+	slice.buffer = frame.buffer.buffer;
+	slice.offset = offset;
+	return slice;
+}
+
+FrameArenaStats FrameArena::stats()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mStats;
+}
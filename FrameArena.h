@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "MemoryAllocator.h"
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// A range of one frame's arena buffer, written through data until the frame is submitted.
+struct ArenaSlice
+{
+	void *data = nullptr;
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+};
+
+struct FrameArenaStats
+{
+	uint64_t allocationCount = 0;
+	uint64_t allocatedBytes = 0;
+	VkDeviceSize peakFrameBytes = 0; // most bytes one frame used.
+};
+
+// Per-frame constants (camera matrices, object transforms) bump-allocated out of one
+// persistently mapped buffer per frame in flight. The buffers are created once, so the hot path
+// never allocates memory; a frame's buffer is reset as a whole after its fence signaled.
+// Shaders read the data through the storage buffer the caller registers per frame, or through
+// dynamic offsets into it. Thread safe.
+class FrameArena
+{
+public:
+	FrameArena(VkDevice device, MemoryAllocator &allocator, uint32_t frameCount, VkDeviceSize frameCapacity);
+	~FrameArena();
+
+	FrameArena(const FrameArena &) = delete;
+	FrameArena &operator=(const FrameArena &) = delete;
+
+	// the frame's fence must have signaled, everything allocated in it before is released.
+	void beginFrame(uint32_t frame);
+	// makes the frame's writes visible to the device, a no-op on coherent memory.
+	void flush();
+
+	// throws when the frame's buffer is full, alignment must be a power of two.
+	ArenaSlice allocate(VkDeviceSize size, VkDeviceSize alignment);
+
+	// aligned to sizeof(T), so the returned element index addresses the array as T[] in a shader.
+	template <typename T>
+	T *allocateArray(uint32_t count, uint32_t &firstElement)
+	{
+		static_assert((sizeof(T) & (sizeof(T) - 1)) == 0, "element size must be a power of two");
+		ArenaSlice slice = allocate(sizeof(T) * count, sizeof(T));
+		firstElement = static_cast<uint32_t>(slice.offset / sizeof(T));
+		return static_cast<T *>(slice.data);
+	}
+
+	VkBuffer buffer(uint32_t frame) const { return mFrames[frame].buffer.buffer; }
+	uint32_t currentFrame() const { return mCurrentFrame; }
+	VkDeviceSize frameCapacity() const { return mFrameCapacity; }
+	FrameArenaStats stats();
+
+private:
+	struct Frame
+	{
+		GpuBuffer buffer;
+		LinearAllocator linear;
+	};
+
+	VkDevice mDevice;
+	MemoryAllocator &mAllocator;
+	VkDeviceSize mFrameCapacity;
+
+	std::mutex mMutex;
+	std::vector<Frame> mFrames;
+	uint32_t mCurrentFrame = 0;
+	FrameArenaStats mStats;
+};
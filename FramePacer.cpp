@@ -0,0 +1,181 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+namespace
+{
+	double toMs(FramePacer::clock::duration d)
+	{
+		return std::chrono::duration<double, std::milli>(d).count();
+	}
+}
+
+void LatencyHistogram::add(double ms)
+{
+	uint32_t bucket = static_cast<uint32_t>(std::max(ms, 0.0) / kBucketMs);
+	++mBuckets[std::min(bucket, kBucketCount - 1)];
+	++mCount;
+	mSumMs += ms;
+	mMaxMs = std::max(mMaxMs, ms);
+}
+
+void LatencyHistogram::reset()
+{
+	std::fill(mBuckets.begin(), mBuckets.end(), 0);
+	mCount = 0;
+	mSumMs = 0.0;
+	mMaxMs = 0.0;
+}
+
+double LatencyHistogram::percentile(double p) const
+{
+	if (mCount == 0)
+	{
+		return 0.0;
+	}
+
+	// rank of the sample, rounded up so p100 is the largest one.
+	uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(p / 100.0 * mCount + 0.999999));
+	uint64_t seen = 0;
+	for (uint32_t i = 0; i < kBucketCount; ++i)
+	{
+		seen += mBuckets[i];
+		if (seen >= rank)
+		{
+			// the overflow bucket has no upper edge, report the maximum instead.
+			return i == kBucketCount - 1 ? mMaxMs : std::min((i + 1) * kBucketMs, mMaxMs);
+		}
+	}
+	return mMaxMs;
+}
+
+void LatencyHistogram::print(const char *name) const
+{
+	if (mCount == 0)
+	{
+		return;
+	}
+
+	std::cout << "  " << name << " ms: p50 " << percentile(50.0) << ", p95 " << percentile(95.0) << ", p99 " << percentile(99.0)
+			  << ", avg " << average() << ", max " << max() << std::endl;
+}
+
+FramePacer::FramePacer(double targetFps)
+{
+	setTargetFps(targetFps);
+}
+
+void FramePacer::setTargetFps(double targetFps)
+{
+	mTargetFps = std::max(targetFps, 0.0);
+	mFramePeriod = mTargetFps > 0.0 ? std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / mTargetFps))
+									: clock::duration::zero();
+	mNextFrame = clock::now();
+}
+
+void FramePacer::limit()
+{
+	if (mFramePeriod == clock::duration::zero())
+	{
+		return;
+	}
+
+	auto start = clock::now();
+	// sleep is only accurate to a scheduler tick, sleep most of the way and spin for the rest.
+	const auto spinMargin = std::chrono::milliseconds(1);
+	if (mNextFrame - start > spinMargin)
+	{
+		std::this_thread::sleep_until(mNextFrame - spinMargin);
+	}
+	while (clock::now() < mNextFrame)
+	{
+		std::this_thread::yield();
+	}
+
+	auto end = clock::now();
+	mLimiterSleep.add(toMs(end - start));
+
+	// a frame that ran late does not make the following ones run early to catch up.
+	mNextFrame += mFramePeriod;
+	if (mNextFrame < end)
+	{
+		mNextFrame = end + mFramePeriod;
+	}
+}
+
+void FramePacer::markPoll(clock::time_point start, clock::time_point end)
+{
+	mPoll.add(toMs(end - start));
+	mInputTime = end;
+	mHasInput = true;
+}
+
+void FramePacer::markAcquire(clock::time_point start, clock::time_point end)
+{
+	mAcquire.add(toMs(end - start));
+}
+
+void FramePacer::markSubmit(clock::time_point start, clock::time_point end)
+{
+	mSubmit.add(toMs(end - start));
+}
+
+void FramePacer::markPresent(clock::time_point start, clock::time_point end)
+{
+	mPresent.add(toMs(end - start));
+}
+
+void FramePacer::endFrame(clock::time_point end)
+{
+	if (mHasLastFrame)
+	{
+		mFrameTime.add(toMs(end - mLastFrameEnd));
+	}
+	mLastFrameEnd = end;
+	mHasLastFrame = true;
+
+	if (mHasInput)
+	{
+		mLatency.add(toMs(end - mInputTime));
+		mHasInput = false;
+	}
+}
+
+void FramePacer::reset()
+{
+	mHasInput = false;
+	mHasLastFrame = false;
+	mFrameTime.reset();
+	mLatency.reset();
+	mPoll.reset();
+	mAcquire.reset();
+	mSubmit.reset();
+	mPresent.reset();
+	mLimiterSleep.reset();
+	mNextFrame = clock::now();
+}
+
+void FramePacer::report(const char *label) const
+{
+	if (mFrameTime.count() == 0)
+	{
+		return;
+	}
+
+	std::cout << "frame pacing (" << label;
+	if (mTargetFps > 0.0)
+	{
+		std::cout << ", limited to " << mTargetFps << " fps";
+	}
+	std::cout << "), " << mFrameTime.count() + 1 << " frames:" << std::endl;
+
+	mFrameTime.print("frame time");
+	mLatency.print("input to present");
+	mPoll.print("poll events");
+	mAcquire.print("acquire");
+	mSubmit.print("submit");
+	mPresent.print("present");
+	mLimiterSleep.print("limiter sleep");
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Fixed-width bucket histogram of millisecond samples, constant memory however long the run.
+class LatencyHistogram
+{
+public:
+	static constexpr double kBucketMs = 0.1;
+	static const uint32_t kBucketCount = 1000; // the last bucket collects everything above 100 ms.
+
+	LatencyHistogram() : mBuckets(kBucketCount, 0) {}
+
+	void add(double ms);
+	void reset();
+
+	// upper edge of the bucket holding the p-th percentile, p in [0, 100].
+	double percentile(double p) const;
+	uint64_t count() const { return mCount; }
+	double average() const { return mCount > 0 ? mSumMs / mCount : 0.0; }
+	double max() const { return mMaxMs; }
+
+	// p50/p95/p99, average and maximum on one line, nothing when empty.
+	void print(const char *name) const;
+
+private:
+	std::vector<uint64_t> mBuckets;
+	uint64_t mCount = 0;
+	double mSumMs = 0.0;
+	double mMaxMs = 0.0;
+};
+
+// Frame pacing and latency instrumentation around the phases of a frame.
+// Frame time is the interval between two frame ends (present, or submit when headless); latency
+// runs from the event poll that sampled input to the end of the frame that consumed it. This is
+// input-to-present, the display's scanout comes on top and is not observable without present timing.
+class FramePacer
+{
+public:
+	using clock = std::chrono::steady_clock;
+
+	// 0 disables the limiter.
+	explicit FramePacer(double targetFps = 0.0);
+
+	void setTargetFps(double targetFps);
+	double targetFps() const { return mTargetFps; }
+
+	// sleeps until the next frame is due, call right before polling events so input is sampled late.
+	void limit();
+
+	void markPoll(clock::time_point start, clock::time_point end);
+	void markAcquire(clock::time_point start, clock::time_point end);
+	void markSubmit(clock::time_point start, clock::time_point end);
+	void markPresent(clock::time_point start, clock::time_point end);
+	void endFrame(clock::time_point end);
+
+	// drops all samples, used when the present mode changes.
+	void reset();
+	void report(const char *label) const;
+
+private:
+	double mTargetFps = 0.0;
+	clock::duration mFramePeriod = clock::duration::zero();
+	clock::time_point mNextFrame;
+
+	clock::time_point mInputTime; // end of the last event poll.
+	bool mHasInput = false;
+	clock::time_point mLastFrameEnd;
+	bool mHasLastFrame = false;
+
+	LatencyHistogram mFrameTime;
+	LatencyHistogram mLatency;
+	LatencyHistogram mPoll;
+	LatencyHistogram mAcquire;
+	LatencyHistogram mSubmit;
+	LatencyHistogram mPresent;
+	LatencyHistogram mLimiterSleep;
+};
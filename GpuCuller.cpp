@@ -0,0 +1,235 @@
+#include "GpuCuller.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+GpuCuller::GpuCuller(VkDevice device, MemoryAllocator &allocator, VkPipelineCache pipelineCache,
+					 VkShaderModule computeModule, uint32_t frameCount, uint32_t maxObjects,
+					 const std::vector<uint32_t> &queueFamilies)
+	: mDevice(device), mAllocator(allocator), mQueueFamilies(queueFamilies), mMaxObjects(std::max(maxObjects, 1u))
+{
+	VkDescriptorSetLayoutBinding bindings[4]{};
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
+	{
+		descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		descriptorSetLayoutCreateInfo.bindingCount = 4;
+		descriptorSetLayoutCreateInfo.pBindings = bindings;
+	}
+
+	VkResult res = vkCreateDescriptorSetLayout(mDevice, &descriptorSetLayoutCreateInfo, nullptr, &mDescriptorSetLayout);
+	assert(res == VK_SUCCESS);
+
+	VkPushConstantRange pushConstantRange{};
+	{
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(PushConstants);
+	}
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+	{
+		pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutCreateInfo.setLayoutCount = 1;
+		pipelineLayoutCreateInfo.pSetLayouts = &mDescriptorSetLayout;
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+	}
+
+	res = vkCreatePipelineLayout(mDevice, &pipelineLayoutCreateInfo, nullptr, &mPipelineLayout);
+	assert(res == VK_SUCCESS);
+
+	VkComputePipelineCreateInfo computePipelineCreateInfo{};
+	{
+		computePipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		computePipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		computePipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		computePipelineCreateInfo.stage.module = computeModule;
+		computePipelineCreateInfo.stage.pName = "main";
+		computePipelineCreateInfo.layout = mPipelineLayout;
+	}
+
+	res = vkCreateComputePipelines(mDevice, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &mPipeline);
+	assert(res == VK_SUCCESS);
+
+	VkDescriptorPoolSize poolSize{};
+	{
+		poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSize.descriptorCount = 4 * frameCount;
+	}
+
+	VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{};
+	{
+		descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		descriptorPoolCreateInfo.maxSets = frameCount;
+		descriptorPoolCreateInfo.poolSizeCount = 1;
+		descriptorPoolCreateInfo.pPoolSizes = &poolSize;
+	}
+
+	res = vkCreateDescriptorPool(mDevice, &descriptorPoolCreateInfo, nullptr, &mDescriptorPool);
+	assert(res == VK_SUCCESS);
+
+	VkDeviceSize objectsSize = sizeof(glm::vec4) * mMaxObjects;
+	mObjects = createBuffer(objectsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+	// every frame in flight gets its own output, so culling never waits on an older draw.
+	mFrames.resize(frameCount);
+	for (auto &frame : mFrames)
+	{
+		frame.commands = createBuffer(sizeof(VkDrawIndexedIndirectCommand) * mMaxObjects,
+									  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+		frame.instances = createBuffer(objectsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+		frame.count = createBuffer(sizeof(uint32_t),
+								   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+		VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{};
+		{
+			descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+			descriptorSetAllocateInfo.descriptorPool = mDescriptorPool;
+			descriptorSetAllocateInfo.descriptorSetCount = 1;
+			descriptorSetAllocateInfo.pSetLayouts = &mDescriptorSetLayout;
+		}
+
+		res = vkAllocateDescriptorSets(mDevice, &descriptorSetAllocateInfo, &frame.descriptorSet);
+		assert(res == VK_SUCCESS);
+
+		VkDescriptorBufferInfo bufferInfos[4] = {
+			{mObjects.buffer, 0, VK_WHOLE_SIZE},
+			{frame.commands.buffer, 0, VK_WHOLE_SIZE},
+			{frame.instances.buffer, 0, VK_WHOLE_SIZE},
+			{frame.count.buffer, 0, VK_WHOLE_SIZE}};
+
+		VkWriteDescriptorSet writes[4]{};
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = frame.descriptorSet;
+			writes[i].dstBinding = i;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[i].pBufferInfo = &bufferInfos[i];
+		}
+		vkUpdateDescriptorSets(mDevice, 4, writes, 0, nullptr);
+	}
+}
+
+GpuCuller::~GpuCuller()
+{
+	for (auto &frame : mFrames)
+	{
+		destroyBuffer(frame.commands);
+		destroyBuffer(frame.instances);
+		destroyBuffer(frame.count);
+	}
+	destroyBuffer(mObjects);
+
+	// frees the descriptor sets as well.
+	vkDestroyDescriptorPool(mDevice, mDescriptorPool, nullptr);
+	vkDestroyPipeline(mDevice, mPipeline, nullptr);
+	vkDestroyPipelineLayout(mDevice, mPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(mDevice, mDescriptorSetLayout, nullptr);
+}
+
+GpuBuffer GpuCuller::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage)
+{
+	GpuBuffer buffer;
+
+	VkBufferCreateInfo bufferCreateInfo{};
+	{
+		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferCreateInfo.size = size;
+		bufferCreateInfo.usage = usage;
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		if (mQueueFamilies.size() > 1)
+		{
+			bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			bufferCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(mQueueFamilies.size());
+			bufferCreateInfo.pQueueFamilyIndices = mQueueFamilies.data();
+		}
+	}
+
+	VkResult res = vkCreateBuffer(mDevice, &bufferCreateInfo, nullptr, &buffer.buffer);
+	assert(res == VK_SUCCESS);
+	buffer.allocation = mAllocator.allocateForBuffer(buffer.buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	return buffer;
+}
+
+void GpuCuller::destroyBuffer(GpuBuffer &buffer)
+{
+	vkDestroyBuffer(mDevice, buffer.buffer, nullptr);
+	mAllocator.free(buffer.allocation);
+	buffer.buffer = VK_NULL_HANDLE;
+}
+
+uint64_t GpuCuller::setObjects(StagingUploader &uploader, const std::vector<glm::vec4> &spheres)
+{
+	assert(spheres.size() <= mMaxObjects);
+	mObjectCount = static_cast<uint32_t>(spheres.size());
+
+	return uploader.upload(mObjects.buffer, 0, spheres.data(), sizeof(glm::vec4) * spheres.size(),
+						   VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, mQueueFamilies.size() > 1);
+}
+
+void GpuCuller::recordReset(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+	vkCmdFillBuffer(commandBuffer, mFrames[frame].count.buffer, 0, sizeof(uint32_t), 0);
+}
+
+void GpuCuller::recordCull(VkCommandBuffer commandBuffer, uint32_t frame, const glm::mat4 &viewProj, uint32_t indexCount)
+{
+	FrameBuffers &buffers = mFrames[frame];
+
+	PushConstants pushConstants{};
+	{
+		extractFrustumPlanes(viewProj, pushConstants.planes);
+		pushConstants.objectCount = mObjectCount;
+		pushConstants.indexCount = indexCount;
+	}
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelineLayout, 0, 1, &buffers.descriptorSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, mPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+	vkCmdDispatch(commandBuffer, (mObjectCount + 63) / 64, 1, 1);
+}
+
+void GpuCuller::recordDraw(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+	FrameBuffers &buffers = mFrames[frame];
+
+	VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &buffers.instances.buffer, &offset);
+	vkCmdDrawIndexedIndirectCount(commandBuffer, buffers.commands.buffer, 0, buffers.count.buffer, 0,
+								  mMaxObjects, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void GpuCuller::extractFrustumPlanes(const glm::mat4 &viewProj, glm::vec4 planes[6])
+{
+	// rows of the matrix, glm stores columns.
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; ++i)
+	{
+		rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+	}
+
+	planes[0] = rows[3] + rows[0]; // left
+	planes[1] = rows[3] - rows[0]; // right
+	planes[2] = rows[3] + rows[1]; // bottom
+	planes[3] = rows[3] - rows[1]; // top
+	planes[4] = rows[2];		   // near, depth is [0, 1]
+	planes[5] = rows[3] - rows[2]; // far
+
+	for (int i = 0; i < 6; ++i)
+	{
+		float length = std::sqrt(planes[i].x * planes[i].x + planes[i].y * planes[i].y + planes[i].z * planes[i].z);
+		planes[i] = glm::vec4(planes[i].x / length, planes[i].y / length, planes[i].z / length, planes[i].w / length);
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "MemoryAllocator.h"
+#include "StagingUploader.h"
+
+#include <cstdint>
+#include <vector>
+
+// Culls object bounding spheres against the view frustum in a compute pass, which appends one
+// VkDrawIndexedIndirectCommand per visible object plus a draw count. The graphics pass consumes
+// them with vkCmdDrawIndexedIndirectCount, so recording cost does not depend on the object count.
+// The caller orders reset, cull and draw, e.g. as render graph passes using the frame's buffers.
+class GpuCuller
+{
+public:
+	// computeModule is only used during construction and stays owned by the caller. With more than
+	// one queue family the buffers are shared by them, so the cull can run on a compute queue.
+	GpuCuller(VkDevice device, MemoryAllocator &allocator, VkPipelineCache pipelineCache,
+			  VkShaderModule computeModule, uint32_t frameCount, uint32_t maxObjects,
+			  const std::vector<uint32_t> &queueFamilies = {});
+	~GpuCuller();
+
+	GpuCuller(const GpuCuller &) = delete;
+	GpuCuller &operator=(const GpuCuller &) = delete;
+
+	// spheres are xyz center, w radius. Returns the upload batch, the objects must not be
+	// culled before that batch is acquired.
+	uint64_t setObjects(StagingUploader &uploader, const std::vector<glm::vec4> &spheres);
+
+	// zeroes the draw count of one slot of the frames-in-flight ring with a transfer write.
+	void recordReset(VkCommandBuffer commandBuffer, uint32_t frame);
+
+	// records the cull dispatch for the slot, outside a render pass. It reads and increments the
+	// count and writes the commands and instances from the compute shader.
+	void recordCull(VkCommandBuffer commandBuffer, uint32_t frame, const glm::mat4 &viewProj, uint32_t indexCount);
+
+	// binds the visible instances to vertex binding 0 and draws them, inside a render pass with
+	// the mesh vertex and index buffers bound.
+	void recordDraw(VkCommandBuffer commandBuffer, uint32_t frame);
+
+	VkBuffer indirectBuffer(uint32_t frame) const { return mFrames[frame].commands.buffer; }
+	VkBuffer instanceBuffer(uint32_t frame) const { return mFrames[frame].instances.buffer; }
+	VkBuffer countBuffer(uint32_t frame) const { return mFrames[frame].count.buffer; }
+
+	uint32_t objectCount() const { return mObjectCount; }
+	// all object spheres, also usable as an instance-rate vertex stream.
+	VkBuffer objectBuffer() const { return mObjects.buffer; }
+
+	// normalized planes facing inwards, for a [0, 1] depth range.
+	static void extractFrustumPlanes(const glm::mat4 &viewProj, glm::vec4 planes[6]);
+
+private:
+	struct PushConstants
+	{
+		glm::vec4 planes[6];
+		uint32_t objectCount;
+		uint32_t indexCount;
+	};
+
+	// written by the cull pass of one frame, read by its draw.
+	struct FrameBuffers
+	{
+		GpuBuffer commands;
+		GpuBuffer instances;
+		GpuBuffer count;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	};
+
+	GpuBuffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage);
+	void destroyBuffer(GpuBuffer &buffer);
+
+	VkDevice mDevice;
+	MemoryAllocator &mAllocator;
+	std::vector<uint32_t> mQueueFamilies;
+	uint32_t mMaxObjects;
+	uint32_t mObjectCount = 0;
+
+	GpuBuffer mObjects;
+	std::vector<FrameBuffers> mFrames;
+
+	VkDescriptorSetLayout mDescriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool mDescriptorPool = VK_NULL_HANDLE;
+	VkPipelineLayout mPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline mPipeline = VK_NULL_HANDLE;
+};
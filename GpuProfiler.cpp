@@ -0,0 +1,305 @@
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace
+{
+	// the order of the results, which is the order of the flag bits.
+	const VkQueryPipelineStatisticFlags kStatisticFlags =
+		VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+	const char *const kStatisticNames[] = {
+		"ia vertices", "ia primitives", "vs invocations", "clip invocations", "clip primitives", "fs invocations", "cs invocations"};
+
+	std::string escapeJson(const std::string &text)
+	{
+		std::string escaped;
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+			{
+				escaped += '\\';
+			}
+			escaped += c;
+		}
+		return escaped;
+	}
+}
+
+void RollingAverage::add(double value)
+{
+	mSamples.push_back(value);
+	mSum += value;
+	if (mSamples.size() > kWindow)
+	{
+		mSum -= mSamples.front();
+		mSamples.pop_front();
+	}
+}
+
+GpuProfiler::GpuProfiler(VkDevice device, float timestampPeriod, uint32_t timestampValidBits, uint32_t frameCount,
+						 bool synchronization2, bool pipelineStatistics, uint32_t maxScopes)
+	: mDevice(device), mTimestampPeriodNs(timestampPeriod),
+	  mTimestampMask(timestampValidBits >= 64 ? ~0ull : (1ull << timestampValidBits) - 1),
+	  mSynchronization2(synchronization2), mPipelineStatistics(pipelineStatistics), mMaxScopes(maxScopes),
+	  mStartTime(clock::now())
+{
+	mFrames.resize(frameCount);
+	for (auto &frame : mFrames)
+	{
+		VkQueryPoolCreateInfo queryPoolCreateInfo{};
+		{
+			queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolCreateInfo.queryCount = mMaxScopes * 2;
+		}
+
+		VkResult res = vkCreateQueryPool(mDevice, &queryPoolCreateInfo, nullptr, &frame.timestamps);
+		assert(res == VK_SUCCESS);
+
+		if (mPipelineStatistics)
+		{
+			queryPoolCreateInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+			queryPoolCreateInfo.queryCount = mMaxScopes;
+			queryPoolCreateInfo.pipelineStatistics = kStatisticFlags;
+
+			res = vkCreateQueryPool(mDevice, &queryPoolCreateInfo, nullptr, &frame.statistics);
+			assert(res == VK_SUCCESS);
+		}
+	}
+}
+
+GpuProfiler::~GpuProfiler()
+{
+	for (auto &frame : mFrames)
+	{
+		vkDestroyQueryPool(mDevice, frame.timestamps, nullptr);
+		if (frame.statistics != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(mDevice, frame.statistics, nullptr);
+		}
+	}
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+	// every scope of the previous frame must have been closed.
+	assert(mOpenScopes == 0);
+
+	FrameQueries &queries = mFrames[frame];
+	collect(queries);
+
+	queries.scopes.clear();
+	queries.statisticsUsed = 0;
+	mCurrentFrame = frame;
+
+	// queries must be reset before every use, outside a render pass.
+	vkCmdResetQueryPool(commandBuffer, queries.timestamps, 0, mMaxScopes * 2);
+	if (queries.statistics != VK_NULL_HANDLE)
+	{
+		vkCmdResetQueryPool(commandBuffer, queries.statistics, 0, mMaxScopes);
+	}
+}
+
+uint32_t GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const char *name, bool statistics)
+{
+	FrameQueries &queries = mFrames[mCurrentFrame];
+	if (queries.scopes.size() >= mMaxScopes)
+	{
+		throw std::runtime_error("GpuProfiler: too many scopes in one frame.");
+	}
+
+	Scope scope{};
+	scope.name = name;
+	scope.timestampQuery = static_cast<uint32_t>(queries.scopes.size()) * 2;
+	scope.statisticsQuery = -1;
+	++mOpenScopes;
+
+	writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, queries.timestamps, scope.timestampQuery);
+
+	if (statistics && queries.statistics != VK_NULL_HANDLE)
+	{
+		scope.statisticsQuery = static_cast<int32_t>(queries.statisticsUsed++);
+		vkCmdBeginQuery(commandBuffer, queries.statistics, scope.statisticsQuery, 0);
+	}
+
+	queries.scopes.push_back(scope);
+	return static_cast<uint32_t>(queries.scopes.size()) - 1;
+}
+
+void GpuProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t scope)
+{
+	FrameQueries &queries = mFrames[mCurrentFrame];
+	const Scope &s = queries.scopes[scope];
+
+	if (s.statisticsQuery >= 0)
+	{
+		vkCmdEndQuery(commandBuffer, queries.statistics, s.statisticsQuery);
+	}
+
+	// written once all previously submitted work of the scope finished.
+	writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, queries.timestamps, s.timestampQuery + 1);
+	--mOpenScopes;
+}
+
+void GpuProfiler::markSubmit(uint32_t frame, clock::time_point submitTime)
+{
+	mFrames[frame].submitTime = submitTime;
+}
+
+void GpuProfiler::addCpuSample(const char *name, clock::time_point start, clock::time_point end)
+{
+	double durationMs = std::chrono::duration<double, std::milli>(end - start).count();
+	mCpuMs[name].add(durationMs);
+
+	double startUs = std::chrono::duration<double, std::micro>(start - mStartTime).count();
+	addTraceEvent(name, startUs, durationMs * 1000.0, 0);
+}
+
+void GpuProfiler::collectPending()
+{
+	assert(mOpenScopes == 0);
+	for (auto &queries : mFrames)
+	{
+		collect(queries);
+		queries.scopes.clear();
+		queries.statisticsUsed = 0;
+	}
+}
+
+void GpuProfiler::writeTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlags2 stage, VkQueryPool pool, uint32_t query)
+{
+	if (mSynchronization2)
+	{
+		vkCmdWriteTimestamp2(commandBuffer, stage, pool, query);
+	}
+	else
+	{
+		vkCmdWriteTimestamp(commandBuffer, stage == VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+							pool, query);
+	}
+}
+
+void GpuProfiler::collect(FrameQueries &queries)
+{
+	if (queries.scopes.empty())
+	{
+		return;
+	}
+
+	// the slot's fence signaled, so no WAIT flag: a NOT_READY here means a scope was never
+	// submitted and the frame is dropped rather than stalling on it.
+	uint32_t timestampCount = static_cast<uint32_t>(queries.scopes.size()) * 2;
+	std::vector<uint64_t> timestamps(timestampCount);
+	VkResult res = vkGetQueryPoolResults(mDevice, queries.timestamps, 0, timestampCount, timestamps.size() * sizeof(uint64_t),
+										 timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	if (res != VK_SUCCESS)
+	{
+		return;
+	}
+
+	std::vector<uint64_t> statistics(queries.statisticsUsed * kStatisticCount);
+	if (queries.statisticsUsed > 0)
+	{
+		res = vkGetQueryPoolResults(mDevice, queries.statistics, 0, queries.statisticsUsed, statistics.size() * sizeof(uint64_t),
+									statistics.data(), kStatisticCount * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+		if (res != VK_SUCCESS)
+		{
+			statistics.clear();
+		}
+	}
+
+	// there is no shared clock between host and device without calibrated timestamps, the GPU
+	// track is placed relative to the frame's submit.
+	uint64_t frameStart = timestamps[0] & mTimestampMask;
+	double submitUs = std::chrono::duration<double, std::micro>(queries.submitTime - mStartTime).count();
+
+	for (const auto &scope : queries.scopes)
+	{
+		uint64_t begin = timestamps[scope.timestampQuery] & mTimestampMask;
+		uint64_t end = timestamps[scope.timestampQuery + 1] & mTimestampMask;
+		double durationMs = ((end - begin) & mTimestampMask) * mTimestampPeriodNs / 1e6;
+		mGpuMs[scope.name].add(durationMs);
+
+		double offsetUs = ((begin - frameStart) & mTimestampMask) * mTimestampPeriodNs / 1e3;
+		addTraceEvent(scope.name, submitUs + offsetUs, durationMs * 1000.0, 1);
+
+		if (scope.statisticsQuery >= 0 && !statistics.empty())
+		{
+			auto &averages = mGpuStatistics[scope.name];
+			averages.resize(kStatisticCount);
+			for (uint32_t i = 0; i < kStatisticCount; ++i)
+			{
+				averages[i].add(static_cast<double>(statistics[scope.statisticsQuery * kStatisticCount + i]));
+			}
+		}
+	}
+}
+
+void GpuProfiler::addTraceEvent(const std::string &name, double startUs, double durationUs, uint32_t track)
+{
+	if (mTrace.size() < kMaxTraceEvents)
+	{
+		mTrace.push_back({name, startUs, durationUs, track});
+	}
+}
+
+void GpuProfiler::report() const
+{
+	std::cout << "gpu ms (avg of last " << RollingAverage::kWindow << " frames):" << std::endl;
+	for (const auto &scope : mGpuMs)
+	{
+		std::cout << "  " << scope.first << ": " << scope.second.average() << std::endl;
+
+		auto statistics = mGpuStatistics.find(scope.first);
+		if (statistics != mGpuStatistics.end())
+		{
+			std::cout << "   ";
+			for (uint32_t i = 0; i < kStatisticCount; ++i)
+			{
+				std::cout << " " << kStatisticNames[i] << " " << static_cast<uint64_t>(statistics->second[i].average());
+			}
+			std::cout << std::endl;
+		}
+	}
+
+	std::cout << "cpu ms (avg of last " << RollingAverage::kWindow << " frames):" << std::endl;
+	for (const auto &scope : mCpuMs)
+	{
+		std::cout << "  " << scope.first << ": " << scope.second.average() << std::endl;
+	}
+}
+
+bool GpuProfiler::writeChromeTrace(const std::string &path) const
+{
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	// chrome://tracing and Perfetto both read the JSON object format, ts and dur in microseconds.
+	file << std::fixed;
+	file.precision(3);
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n";
+	file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"GPU\"}}";
+	for (const auto &event : mTrace)
+	{
+		file << ",\n{\"name\":\"" << escapeJson(event.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.track
+			 << ",\"ts\":" << event.startUs << ",\"dur\":" << event.durationUs << "}";
+	}
+	file << "\n]}\n";
+
+	return file.good();
+}
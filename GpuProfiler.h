@@ -0,0 +1,111 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+// Rolling average over the last kWindow samples.
+class RollingAverage
+{
+public:
+	static const size_t kWindow = 120;
+
+	void add(double value);
+	double average() const { return mSamples.empty() ? 0.0 : mSum / mSamples.size(); }
+	double last() const { return mSamples.empty() ? 0.0 : mSamples.back(); }
+
+private:
+	std::deque<double> mSamples;
+	double mSum = 0.0;
+};
+
+// GPU scopes are timed with timestamp queries and optionally pipeline-statistics queries, one
+// query pool pair per slot of the frames-in-flight ring. Results are read when the slot comes
+// round again, so they arrive frames-in-flight frames late and reading never stalls.
+// CPU scopes are plain wall clock samples. Both feed rolling averages and a Chrome trace.
+class GpuProfiler
+{
+public:
+	using clock = std::chrono::steady_clock;
+
+	GpuProfiler(VkDevice device, float timestampPeriod, uint32_t timestampValidBits, uint32_t frameCount,
+				bool synchronization2, bool pipelineStatistics, uint32_t maxScopes = 32);
+	~GpuProfiler();
+
+	GpuProfiler(const GpuProfiler &) = delete;
+	GpuProfiler &operator=(const GpuProfiler &) = delete;
+
+	// collects the slot's previous results and resets its queries, call right after
+	// vkBeginCommandBuffer once the slot's fence signaled.
+	void beginFrame(VkCommandBuffer commandBuffer, uint32_t frame);
+
+	// scopes may nest, statistics scopes must begin and end on the same side of a render pass.
+	uint32_t beginScope(VkCommandBuffer commandBuffer, const char *name, bool statistics = false);
+	void endScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+	// the GPU track of the trace is anchored to the submit time of each frame.
+	void markSubmit(uint32_t frame, clock::time_point submitTime);
+
+	void addCpuSample(const char *name, clock::time_point start, clock::time_point end);
+
+	// collects every slot that still holds results, the device must be idle.
+	void collectPending();
+
+	void report() const;
+	bool writeChromeTrace(const std::string &path) const;
+
+private:
+	static const uint32_t kStatisticCount = 7;
+	static const size_t kMaxTraceEvents = 1 << 20;
+
+	struct Scope
+	{
+		const char *name;
+		uint32_t timestampQuery;
+		int32_t statisticsQuery; // -1 without pipeline statistics.
+	};
+
+	struct FrameQueries
+	{
+		VkQueryPool timestamps = VK_NULL_HANDLE;
+		VkQueryPool statistics = VK_NULL_HANDLE;
+		std::vector<Scope> scopes;
+		uint32_t statisticsUsed = 0;
+		clock::time_point submitTime;
+	};
+
+	struct TraceEvent
+	{
+		std::string name;
+		double startUs;
+		double durationUs;
+		uint32_t track; // 0 CPU, 1 GPU.
+	};
+
+	void collect(FrameQueries &queries);
+	void writeTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlags2 stage, VkQueryPool pool, uint32_t query);
+	void addTraceEvent(const std::string &name, double startUs, double durationUs, uint32_t track);
+
+	VkDevice mDevice;
+	double mTimestampPeriodNs;
+	uint64_t mTimestampMask;
+	bool mSynchronization2;
+	bool mPipelineStatistics;
+	uint32_t mMaxScopes;
+
+	std::vector<FrameQueries> mFrames;
+	uint32_t mCurrentFrame = 0;
+	uint32_t mOpenScopes = 0;
+
+	std::map<std::string, RollingAverage> mGpuMs;
+	std::map<std::string, std::vector<RollingAverage>> mGpuStatistics;
+	std::map<std::string, RollingAverage> mCpuMs;
+
+	clock::time_point mStartTime;
+	std::vector<TraceEvent> mTrace; // capped, the oldest events are kept.
+};
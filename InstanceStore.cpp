@@ -0,0 +1,341 @@
+#include "InstanceStore.h"
+
+#include <cassert>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+	// the widest float vector the target was compiled for, the kernels below are written once against it.
+#if defined(__AVX2__)
+	const uint32_t kWidth = 8;
+	const char *const kName = "AVX2";
+
+	struct Lanes
+	{
+		__m256 v;
+	};
+
+	inline Lanes load(const float *p) { return {_mm256_loadu_ps(p)}; }
+	inline void store(float *p, Lanes a) { _mm256_storeu_ps(p, a.v); }
+	inline Lanes splat(float f) { return {_mm256_set1_ps(f)}; }
+	inline Lanes operator+(Lanes a, Lanes b) { return {_mm256_add_ps(a.v, b.v)}; }
+	inline Lanes operator-(Lanes a, Lanes b) { return {_mm256_sub_ps(a.v, b.v)}; }
+	inline Lanes operator*(Lanes a, Lanes b) { return {_mm256_mul_ps(a.v, b.v)}; }
+#if defined(__FMA__)
+	inline Lanes mulAdd(Lanes a, Lanes b, Lanes c) { return {_mm256_fmadd_ps(a.v, b.v, c.v)}; }
+#else
+	inline Lanes mulAdd(Lanes a, Lanes b, Lanes c) { return {_mm256_add_ps(_mm256_mul_ps(a.v, b.v), c.v)}; }
+#endif
+	inline Lanes abs(Lanes a) { return {_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)}; }
+	inline Lanes sqrt(Lanes a) { return {_mm256_sqrt_ps(a.v)}; }
+	// bit i set where lane i of a >= b.
+	inline uint32_t greaterEqual(Lanes a, Lanes b) { return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ))); }
+#elif defined(__SSE2__)
+	const uint32_t kWidth = 4;
+	const char *const kName = "SSE2";
+
+	struct Lanes
+	{
+		__m128 v;
+	};
+
+	inline Lanes load(const float *p) { return {_mm_loadu_ps(p)}; }
+	inline void store(float *p, Lanes a) { _mm_storeu_ps(p, a.v); }
+	inline Lanes splat(float f) { return {_mm_set1_ps(f)}; }
+	inline Lanes operator+(Lanes a, Lanes b) { return {_mm_add_ps(a.v, b.v)}; }
+	inline Lanes operator-(Lanes a, Lanes b) { return {_mm_sub_ps(a.v, b.v)}; }
+	inline Lanes operator*(Lanes a, Lanes b) { return {_mm_mul_ps(a.v, b.v)}; }
+	inline Lanes mulAdd(Lanes a, Lanes b, Lanes c) { return {_mm_add_ps(_mm_mul_ps(a.v, b.v), c.v)}; }
+	inline Lanes abs(Lanes a) { return {_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)}; }
+	inline Lanes sqrt(Lanes a) { return {_mm_sqrt_ps(a.v)}; }
+	inline uint32_t greaterEqual(Lanes a, Lanes b) { return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpge_ps(a.v, b.v))); }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	const uint32_t kWidth = 4;
+	const char *const kName = "NEON";
+
+	struct Lanes
+	{
+		float32x4_t v;
+	};
+
+	inline Lanes load(const float *p) { return {vld1q_f32(p)}; }
+	inline void store(float *p, Lanes a) { vst1q_f32(p, a.v); }
+	inline Lanes splat(float f) { return {vdupq_n_f32(f)}; }
+	inline Lanes operator+(Lanes a, Lanes b) { return {vaddq_f32(a.v, b.v)}; }
+	inline Lanes operator-(Lanes a, Lanes b) { return {vsubq_f32(a.v, b.v)}; }
+	inline Lanes operator*(Lanes a, Lanes b) { return {vmulq_f32(a.v, b.v)}; }
+	inline Lanes mulAdd(Lanes a, Lanes b, Lanes c) { return {vfmaq_f32(c.v, a.v, b.v)}; }
+	inline Lanes abs(Lanes a) { return {vabsq_f32(a.v)}; }
+	inline Lanes sqrt(Lanes a) { return {vsqrtq_f32(a.v)}; }
+	inline uint32_t greaterEqual(Lanes a, Lanes b)
+	{
+		const uint32x4_t bits = {1, 2, 4, 8};
+		return vaddvq_u32(vandq_u32(vcgeq_f32(a.v, b.v), bits));
+	}
+#else
+	const uint32_t kWidth = 1;
+	const char *const kName = "scalar";
+
+	struct Lanes
+	{
+		float v;
+	};
+
+	inline Lanes load(const float *p) { return {*p}; }
+	inline void store(float *p, Lanes a) { *p = a.v; }
+	inline Lanes splat(float f) { return {f}; }
+	inline Lanes operator+(Lanes a, Lanes b) { return {a.v + b.v}; }
+	inline Lanes operator-(Lanes a, Lanes b) { return {a.v - b.v}; }
+	inline Lanes operator*(Lanes a, Lanes b) { return {a.v * b.v}; }
+	inline Lanes mulAdd(Lanes a, Lanes b, Lanes c) { return {a.v * b.v + c.v}; }
+	inline Lanes abs(Lanes a) { return {std::fabs(a.v)}; }
+	inline Lanes sqrt(Lanes a) { return {std::sqrt(a.v)}; }
+	inline uint32_t greaterEqual(Lanes a, Lanes b) { return a.v >= b.v ? 1u : 0u; }
+#endif
+
+	// the upper three rows of kWidth column-major matrices, one register per element.
+	struct MatrixLanes
+	{
+		Lanes m[4][3]; // [column][row]
+	};
+
+	// writes count <= kWidth matrices of 16 floats each, adding the constant bottom row.
+	inline void storeMatrices(const MatrixLanes &matrices, float *out, uint32_t count)
+	{
+#if defined(__SSE2__)
+		// 4x4 transposes turn four lanes of (x, y, z, 0) into four columns, one per matrix.
+		for (uint32_t half = 0; half < kWidth / 4; ++half)
+		{
+			uint32_t halfCount = count > half * 4 ? count - half * 4 : 0;
+			if (halfCount == 0)
+				break;
+			for (uint32_t column = 0; column < 4; ++column)
+			{
+#if defined(__AVX2__)
+				__m128 x = half == 0 ? _mm256_castps256_ps128(matrices.m[column][0].v) : _mm256_extractf128_ps(matrices.m[column][0].v, 1);
+				__m128 y = half == 0 ? _mm256_castps256_ps128(matrices.m[column][1].v) : _mm256_extractf128_ps(matrices.m[column][1].v, 1);
+				__m128 z = half == 0 ? _mm256_castps256_ps128(matrices.m[column][2].v) : _mm256_extractf128_ps(matrices.m[column][2].v, 1);
+#else
+				__m128 x = matrices.m[column][0].v;
+				__m128 y = matrices.m[column][1].v;
+				__m128 z = matrices.m[column][2].v;
+#endif
+				__m128 w = _mm_set1_ps(column == 3 ? 1.0f : 0.0f);
+				_MM_TRANSPOSE4_PS(x, y, z, w);
+				float *base = out + half * 64 + column * 4;
+				_mm_storeu_ps(base, x);
+				if (halfCount > 1)
+					_mm_storeu_ps(base + 16, y);
+				if (halfCount > 2)
+					_mm_storeu_ps(base + 32, z);
+				if (halfCount > 3)
+					_mm_storeu_ps(base + 48, w);
+			}
+		}
+#else
+		float elements[4][3][kWidth];
+		for (uint32_t column = 0; column < 4; ++column)
+		{
+			for (uint32_t row = 0; row < 3; ++row)
+			{
+				store(elements[column][row], matrices.m[column][row]);
+			}
+		}
+		for (uint32_t lane = 0; lane < count; ++lane)
+		{
+			float *matrix = out + lane * 16;
+			for (uint32_t column = 0; column < 4; ++column)
+			{
+				matrix[column * 4 + 0] = elements[column][0][lane];
+				matrix[column * 4 + 1] = elements[column][1][lane];
+				matrix[column * 4 + 2] = elements[column][2][lane];
+				matrix[column * 4 + 3] = column == 3 ? 1.0f : 0.0f;
+			}
+		}
+#endif
+	}
+}
+
+const uint32_t InstanceStore::kSimdWidth = kWidth;
+
+const char *InstanceStore::simdName()
+{
+	return kName;
+}
+
+uint32_t InstanceStore::add(const InstanceTransform &transform, const glm::vec3 &boundsCenter, const glm::vec3 &boundsExtent)
+{
+	// grow by a whole batch of zeroed instances, the padding is processed but never reported.
+	if (mCount == mStreams[0].size())
+	{
+		for (auto &stream : mStreams)
+		{
+			stream.resize(stream.size() + kWidth, 0.0f);
+		}
+	}
+
+	uint32_t index = mCount++;
+	setTransform(index, transform);
+	mStreams[BoundsCenterX][index] = boundsCenter.x;
+	mStreams[BoundsCenterY][index] = boundsCenter.y;
+	mStreams[BoundsCenterZ][index] = boundsCenter.z;
+	mStreams[BoundsExtentX][index] = boundsExtent.x;
+	mStreams[BoundsExtentY][index] = boundsExtent.y;
+	mStreams[BoundsExtentZ][index] = boundsExtent.z;
+	return index;
+}
+
+void InstanceStore::setTransform(uint32_t index, const InstanceTransform &transform)
+{
+	assert(index < mCount);
+	mStreams[PositionX][index] = transform.position.x;
+	mStreams[PositionY][index] = transform.position.y;
+	mStreams[PositionZ][index] = transform.position.z;
+	mStreams[RotationX][index] = transform.rotation.x;
+	mStreams[RotationY][index] = transform.rotation.y;
+	mStreams[RotationZ][index] = transform.rotation.z;
+	mStreams[RotationW][index] = transform.rotation.w;
+	mStreams[ScaleX][index] = transform.scale.x;
+	mStreams[ScaleY][index] = transform.scale.y;
+	mStreams[ScaleZ][index] = transform.scale.z;
+}
+
+void InstanceStore::clear()
+{
+	mCount = 0;
+	for (auto &stream : mStreams)
+	{
+		stream.clear();
+	}
+}
+
+void InstanceStore::reserve(uint32_t count)
+{
+	for (auto &stream : mStreams)
+	{
+		stream.reserve((count + kWidth - 1) / kWidth * kWidth);
+	}
+}
+
+void InstanceStore::computeTransforms(glm::mat4 *matrices)
+{
+	const Lanes one = splat(1.0f);
+	const Lanes two = splat(2.0f);
+	float *out = reinterpret_cast<float *>(matrices);
+
+	for (uint32_t i = 0; i < mCount; i += kWidth)
+	{
+		Lanes qx = load(&mStreams[RotationX][i]);
+		Lanes qy = load(&mStreams[RotationY][i]);
+		Lanes qz = load(&mStreams[RotationZ][i]);
+		Lanes qw = load(&mStreams[RotationW][i]);
+
+		// rotation matrix of a unit quaternion, the same terms as glm::mat3_cast.
+		Lanes x2 = qx * two, y2 = qy * two, z2 = qz * two;
+		Lanes xx = qx * x2, yy = qy * y2, zz = qz * z2;
+		Lanes xy = qx * y2, xz = qx * z2, yz = qy * z2;
+		Lanes wx = qw * x2, wy = qw * y2, wz = qw * z2;
+
+		Lanes sx = load(&mStreams[ScaleX][i]);
+		Lanes sy = load(&mStreams[ScaleY][i]);
+		Lanes sz = load(&mStreams[ScaleZ][i]);
+
+		MatrixLanes m;
+		m.m[0][0] = (one - (yy + zz)) * sx;
+		m.m[0][1] = (xy + wz) * sx;
+		m.m[0][2] = (xz - wy) * sx;
+		m.m[1][0] = (xy - wz) * sy;
+		m.m[1][1] = (one - (xx + zz)) * sy;
+		m.m[1][2] = (yz + wx) * sy;
+		m.m[2][0] = (xz + wy) * sz;
+		m.m[2][1] = (yz - wx) * sz;
+		m.m[2][2] = (one - (xx + yy)) * sz;
+		m.m[3][0] = load(&mStreams[PositionX][i]);
+		m.m[3][1] = load(&mStreams[PositionY][i]);
+		m.m[3][2] = load(&mStreams[PositionZ][i]);
+
+		// the box center is transformed as a point, the extent by the absolute upper 3x3 (Arvo).
+		Lanes cx = load(&mStreams[BoundsCenterX][i]);
+		Lanes cy = load(&mStreams[BoundsCenterY][i]);
+		Lanes cz = load(&mStreams[BoundsCenterZ][i]);
+		Lanes ex = load(&mStreams[BoundsExtentX][i]);
+		Lanes ey = load(&mStreams[BoundsExtentY][i]);
+		Lanes ez = load(&mStreams[BoundsExtentZ][i]);
+		Lanes worldExtent[3];
+		for (uint32_t row = 0; row < 3; ++row)
+		{
+			Lanes center = mulAdd(m.m[0][row], cx, mulAdd(m.m[1][row], cy, mulAdd(m.m[2][row], cz, m.m[3][row])));
+			store(&mStreams[WorldCenterX + row][i], center);
+			worldExtent[row] = mulAdd(abs(m.m[0][row]), ex, mulAdd(abs(m.m[1][row]), ey, abs(m.m[2][row]) * ez));
+			store(&mStreams[WorldExtentX + row][i], worldExtent[row]);
+		}
+		Lanes radius = sqrt(mulAdd(worldExtent[0], worldExtent[0], mulAdd(worldExtent[1], worldExtent[1], worldExtent[2] * worldExtent[2])));
+		store(&mStreams[WorldRadius][i], radius);
+
+		if (out != nullptr)
+		{
+			uint32_t count = mCount - i < kWidth ? mCount - i : kWidth;
+			storeMatrices(m, out + static_cast<size_t>(i) * 16, count);
+		}
+	}
+}
+
+uint32_t InstanceStore::cullSpheres(const glm::vec4 planes[6], uint32_t *visible) const
+{
+	Lanes planeLanes[6][4];
+	for (uint32_t p = 0; p < 6; ++p)
+	{
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			planeLanes[p][c] = splat(planes[p][c]);
+		}
+	}
+
+	const uint32_t fullMask = (1u << kWidth) - 1;
+	uint32_t visibleCount = 0;
+	for (uint32_t i = 0; i < mCount; i += kWidth)
+	{
+		Lanes cx = load(&mStreams[WorldCenterX][i]);
+		Lanes cy = load(&mStreams[WorldCenterY][i]);
+		Lanes cz = load(&mStreams[WorldCenterZ][i]);
+		Lanes negativeRadius = splat(0.0f) - load(&mStreams[WorldRadius][i]);
+
+		// same test as cull.comp: outside once the center is further than the radius behind a plane.
+		uint32_t mask = mCount - i < kWidth ? (1u << (mCount - i)) - 1 : fullMask;
+		for (uint32_t p = 0; p < 6 && mask != 0; ++p)
+		{
+			Lanes distance = mulAdd(planeLanes[p][0], cx, mulAdd(planeLanes[p][1], cy, mulAdd(planeLanes[p][2], cz, planeLanes[p][3])));
+			mask &= greaterEqual(distance, negativeRadius);
+		}
+
+		while (mask != 0)
+		{
+			visible[visibleCount++] = i + static_cast<uint32_t>(__builtin_ctz(mask));
+			mask &= mask - 1;
+		}
+	}
+	return visibleCount;
+}
+
+glm::vec3 InstanceStore::worldCenter(uint32_t index) const
+{
+	return glm::vec3(mStreams[WorldCenterX][index], mStreams[WorldCenterY][index], mStreams[WorldCenterZ][index]);
+}
+
+glm::vec3 InstanceStore::worldExtent(uint32_t index) const
+{
+	return glm::vec3(mStreams[WorldExtentX][index], mStreams[WorldExtentY][index], mStreams[WorldExtentZ][index]);
+}
+
+float InstanceStore::worldRadius(uint32_t index) const
+{
+	return mStreams[WorldRadius][index];
+}
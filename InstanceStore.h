@@ -0,0 +1,82 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// translation, rotation as a unit quaternion (xyz vector part, w scalar part) and scale.
+struct InstanceTransform
+{
+	glm::vec3 position = glm::vec3(0.0f);
+	glm::vec4 rotation = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	glm::vec3 scale = glm::vec3(1.0f);
+};
+
+// Object instances kept as structure of arrays, one float stream per component, so the batch
+// kernels process kSimdWidth instances per instruction: 8 with AVX2 (-mavx2 -mfma), 4 with
+// SSE2 or NEON, 1 otherwise. Streams are padded to a multiple of the width with zeroed
+// instances, the kernels never branch on a remainder.
+class InstanceStore
+{
+public:
+	static const uint32_t kSimdWidth;
+	static const char *simdName();
+
+	// bounds are the local axis aligned box of the instance's mesh.
+	uint32_t add(const InstanceTransform &transform, const glm::vec3 &boundsCenter, const glm::vec3 &boundsExtent);
+	void setTransform(uint32_t index, const InstanceTransform &transform);
+	void clear();
+	void reserve(uint32_t count);
+	uint32_t size() const { return mCount; }
+
+	// TRS to column-major model matrices and the local boxes to world boxes in one pass. matrices
+	// may be null, otherwise it receives size() matrices written front to back, so it can point
+	// into write-combined memory such as the frame arena.
+	void computeTransforms(glm::mat4 *matrices);
+
+	// tests the sphere around each world box against inward facing planes, as computed by the
+	// last computeTransforms(). Writes the indices of intersecting instances in ascending order
+	// and returns their count, visible needs room for size() indices.
+	uint32_t cullSpheres(const glm::vec4 planes[6], uint32_t *visible) const;
+
+	// world box center and extent, the bounding sphere radius is the extent's length.
+	glm::vec3 worldCenter(uint32_t index) const;
+	glm::vec3 worldExtent(uint32_t index) const;
+	float worldRadius(uint32_t index) const;
+
+private:
+	enum Stream
+	{
+		PositionX,
+		PositionY,
+		PositionZ,
+		RotationX,
+		RotationY,
+		RotationZ,
+		RotationW,
+		ScaleX,
+		ScaleY,
+		ScaleZ,
+		BoundsCenterX,
+		BoundsCenterY,
+		BoundsCenterZ,
+		BoundsExtentX,
+		BoundsExtentY,
+		BoundsExtentZ,
+		// outputs of computeTransforms().
+		WorldCenterX,
+		WorldCenterY,
+		WorldCenterZ,
+		WorldExtentX,
+		WorldExtentY,
+		WorldExtentZ,
+		WorldRadius,
+		StreamCount
+	};
+
+	uint32_t mCount = 0;
+	std::vector<float> mStreams[StreamCount];
+};
@@ -0,0 +1,510 @@
+#include "MemoryAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace
+{
+	VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	VkDeviceSize nextPowerOfTwo(VkDeviceSize value)
+	{
+		VkDeviceSize result = 1;
+		while (result < value)
+			result <<= 1;
+		return result;
+	}
+
+	uint8_t log2(VkDeviceSize value)
+	{
+		uint8_t result = 0;
+		while (value > 1)
+		{
+			value >>= 1;
+			++result;
+		}
+		return result;
+	}
+}
+
+double MemoryPoolStats::fragmentation() const
+{
+	VkDeviceSize freeBytes = reservedBytes - usedBytes;
+	if (freeBytes == 0)
+		return 0.0;
+
+	return 1.0 - static_cast<double>(largestFreeRange) / static_cast<double>(freeBytes);
+}
+
+MemoryAllocator::MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize)
+	: mDevice(device)
+{
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &mMemoryProperties);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	mNonCoherentAtomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+	mMaxAllocationCount = properties.limits.maxMemoryAllocationCount;
+
+	// buddy ranges need a power of two block.
+	mBlockSize = nextPowerOfTwo(std::max(blockSize, kMinRangeSize));
+	mMaxOrder = log2(mBlockSize / kMinRangeSize);
+
+	mPools.resize(mMemoryProperties.memoryTypeCount * 2);
+	for (uint32_t i = 0; i < mMemoryProperties.memoryTypeCount; ++i)
+	{
+		mPools[i * 2].memoryTypeIndex = i;
+		mPools[i * 2].usage = AllocationUsage::Buffer;
+		mPools[i * 2 + 1].memoryTypeIndex = i;
+		mPools[i * 2 + 1].usage = AllocationUsage::Image;
+	}
+}
+
+MemoryAllocator::~MemoryAllocator()
+{
+	for (auto &pool : mPools)
+	{
+		for (auto &block : pool.blocks)
+		{
+			if (block)
+			{
+				destroyBlock(*block);
+			}
+		}
+	}
+	assert(mDedicatedAllocationCount == 0);
+}
+
+Allocation MemoryAllocator::allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags required,
+									 VkMemoryPropertyFlags preferred, AllocationUsage usage)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	Allocation allocation;
+	for (int pass = preferred != 0 ? 0 : 1; pass < 2; ++pass)
+	{
+		VkMemoryPropertyFlags properties = pass == 0 ? required | preferred : required;
+		for (uint32_t i = 0; i < mMemoryProperties.memoryTypeCount; ++i)
+		{
+			if (!(requirements.memoryTypeBits & (1 << i)) || (mMemoryProperties.memoryTypes[i].propertyFlags & properties) != properties)
+				continue;
+
+			// a full heap is not an error yet, another type may still have room.
+			if (tryAllocate(requirements, i, usage, allocation))
+				return allocation;
+		}
+	}
+
+	throw std::runtime_error("failed to allocate device memory.");
+}
+
+bool MemoryAllocator::tryAllocate(const VkMemoryRequirements &requirements, uint32_t memoryTypeIndex, AllocationUsage usage, Allocation &allocation)
+{
+	allocation.memoryTypeIndex = memoryTypeIndex;
+	allocation.propertyFlags = mMemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+	allocation.size = requirements.size;
+
+	VkDeviceSize rangeSize = nextPowerOfTwo(std::max({requirements.size, requirements.alignment, kMinRangeSize}));
+	if (rangeSize > mBlockSize / 2)
+		return allocateDedicated(requirements.size, memoryTypeIndex, allocation);
+
+	uint32_t poolIndex = memoryTypeIndex * 2 + static_cast<uint32_t>(usage);
+	Pool &pool = mPools[poolIndex];
+	uint8_t order = log2(rangeSize / kMinRangeSize);
+
+	uint32_t blockIndex = 0;
+	VkDeviceSize offset = 0;
+	bool found = false;
+	for (; blockIndex < pool.blocks.size(); ++blockIndex)
+	{
+		if (pool.blocks[blockIndex] && allocateFromBlock(*pool.blocks[blockIndex], order, offset))
+		{
+			found = true;
+			break;
+		}
+	}
+
+	if (!found)
+	{
+		if (!createBlock(pool, blockIndex))
+			return false;
+		found = allocateFromBlock(*pool.blocks[blockIndex], order, offset);
+		assert(found);
+	}
+
+	Block &block = *pool.blocks[blockIndex];
+	block.usedBytes += rangeSize;
+	block.requestedBytes += requirements.size;
+	++block.allocationCount;
+
+	allocation.memory = block.memory;
+	allocation.offset = offset;
+	allocation.mapped = block.mapped != nullptr ? static_cast<char *>(block.mapped) + offset : nullptr;
+	allocation.mPool = poolIndex;
+	allocation.mBlock = blockIndex;
+	allocation.mOrder = order;
+	allocation.mDedicated = false;
+	return true;
+}
+
+bool MemoryAllocator::allocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex, Allocation &allocation)
+{
+	if (mDeviceAllocationCount >= mMaxAllocationCount)
+		return false;
+
+	VkMemoryAllocateInfo memoryAllocateInfo{};
+	{
+		memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memoryAllocateInfo.allocationSize = size;
+		memoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
+	}
+
+	VkResult res = vkAllocateMemory(mDevice, &memoryAllocateInfo, nullptr, &allocation.memory);
+	if (res != VK_SUCCESS)
+		return false;
+
+	allocation.offset = 0;
+	allocation.mapped = nullptr;
+	if (allocation.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		res = vkMapMemory(mDevice, allocation.memory, 0, VK_WHOLE_SIZE, 0, &allocation.mapped);
+		assert(res == VK_SUCCESS);
+	}
+	allocation.mDedicated = true;
+
+	++mDeviceAllocationCount;
+	++mDedicatedAllocationCount;
+	mDedicatedBytes += size;
+	return true;
+}
+
+void MemoryAllocator::free(Allocation &allocation)
+{
+	if (allocation.memory == VK_NULL_HANDLE)
+		return;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	if (allocation.mDedicated)
+	{
+		if (allocation.mapped != nullptr)
+		{
+			vkUnmapMemory(mDevice, allocation.memory);
+		}
+		vkFreeMemory(mDevice, allocation.memory, nullptr);
+		--mDeviceAllocationCount;
+		--mDedicatedAllocationCount;
+		mDedicatedBytes -= allocation.size;
+	}
+	else
+	{
+		Pool &pool = mPools[allocation.mPool];
+		Block &block = *pool.blocks[allocation.mBlock];
+		freeToBlock(block, allocation.offset, allocation.mOrder);
+		block.usedBytes -= kMinRangeSize << allocation.mOrder;
+		block.requestedBytes -= allocation.size;
+		--block.allocationCount;
+
+		// keep one empty block per pool around so a free/allocate pattern does not thrash vkAllocateMemory.
+		if (block.allocationCount == 0)
+		{
+			bool hasOtherEmpty = false;
+			for (uint32_t i = 0; i < pool.blocks.size(); ++i)
+			{
+				if (i != allocation.mBlock && pool.blocks[i] && pool.blocks[i]->allocationCount == 0)
+				{
+					hasOtherEmpty = true;
+					break;
+				}
+			}
+			if (hasOtherEmpty)
+			{
+				destroyBlock(block);
+				pool.blocks[allocation.mBlock].reset();
+			}
+		}
+	}
+
+	allocation = Allocation{};
+}
+
+Allocation MemoryAllocator::allocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred)
+{
+	VkMemoryRequirements memoryRequirements;
+	vkGetBufferMemoryRequirements(mDevice, buffer, &memoryRequirements);
+
+	Allocation allocation = allocate(memoryRequirements, required, preferred, AllocationUsage::Buffer);
+	VkResult res = vkBindBufferMemory(mDevice, buffer, allocation.memory, allocation.offset);
+	assert(res == VK_SUCCESS);
+	return allocation;
+}
+
+Allocation MemoryAllocator::allocateForImage(VkImage image, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred)
+{
+	VkMemoryRequirements memoryRequirements;
+	vkGetImageMemoryRequirements(mDevice, image, &memoryRequirements);
+
+	Allocation allocation = allocate(memoryRequirements, required, preferred, AllocationUsage::Image);
+	VkResult res = vkBindImageMemory(mDevice, image, allocation.memory, allocation.offset);
+	assert(res == VK_SUCCESS);
+	return allocation;
+}
+
+VkMappedMemoryRange MemoryAllocator::mappedRange(const Allocation &allocation) const
+{
+	VkMappedMemoryRange range{};
+	{
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory = allocation.memory;
+		range.offset = allocation.offset & ~(mNonCoherentAtomSize - 1);
+		range.size = alignUp(allocation.offset + allocation.size, mNonCoherentAtomSize) - range.offset;
+
+		// the widened range must not run past the end of the memory object.
+		VkDeviceSize memorySize = allocation.mDedicated ? allocation.size : mBlockSize;
+		if (range.offset + range.size > memorySize)
+		{
+			range.size = VK_WHOLE_SIZE;
+		}
+	}
+	return range;
+}
+
+void MemoryAllocator::flush(const Allocation &allocation)
+{
+	if (allocation.propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+		return;
+
+	VkMappedMemoryRange range = mappedRange(allocation);
+	vkFlushMappedMemoryRanges(mDevice, 1, &range);
+}
+
+void MemoryAllocator::invalidate(const Allocation &allocation)
+{
+	if (allocation.propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+		return;
+
+	VkMappedMemoryRange range = mappedRange(allocation);
+	vkInvalidateMappedMemoryRanges(mDevice, 1, &range);
+}
+
+bool MemoryAllocator::allocateFromBlock(Block &block, uint8_t order, VkDeviceSize &offset)
+{
+	// smallest free range that fits, lowest offset first to keep the top of the block free.
+	uint8_t found = order;
+	while (found <= mMaxOrder && block.freeLists[found].empty())
+		++found;
+	if (found > mMaxOrder)
+		return false;
+
+	offset = *block.freeLists[found].begin();
+	block.freeLists[found].erase(block.freeLists[found].begin());
+
+	// split down, the upper halves go back on the free lists.
+	while (found > order)
+	{
+		--found;
+		block.freeLists[found].insert(offset + (kMinRangeSize << found));
+	}
+	return true;
+}
+
+void MemoryAllocator::freeToBlock(Block &block, VkDeviceSize offset, uint8_t order)
+{
+	// merge with the buddy for as long as it is free as well.
+	while (order < mMaxOrder)
+	{
+		VkDeviceSize buddy = offset ^ (kMinRangeSize << order);
+		if (block.freeLists[order].erase(buddy) == 0)
+			break;
+		offset = std::min(offset, buddy);
+		++order;
+	}
+	block.freeLists[order].insert(offset);
+}
+
+bool MemoryAllocator::createBlock(Pool &pool, uint32_t &blockIndex)
+{
+	if (mDeviceAllocationCount >= mMaxAllocationCount)
+		return false;
+
+	VkMemoryAllocateInfo memoryAllocateInfo{};
+	{
+		memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memoryAllocateInfo.allocationSize = mBlockSize;
+		memoryAllocateInfo.memoryTypeIndex = pool.memoryTypeIndex;
+	}
+
+	auto block = std::make_unique<Block>();
+	VkResult res = vkAllocateMemory(mDevice, &memoryAllocateInfo, nullptr, &block->memory);
+	if (res != VK_SUCCESS)
+		return false;
+
+	// host visible blocks stay mapped for their whole lifetime.
+	if (mMemoryProperties.memoryTypes[pool.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		res = vkMapMemory(mDevice, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped);
+		assert(res == VK_SUCCESS);
+	}
+
+	block->freeLists.resize(mMaxOrder + 1);
+	block->freeLists[mMaxOrder].insert(0);
+	++mDeviceAllocationCount;
+
+	auto slot = std::find(pool.blocks.begin(), pool.blocks.end(), nullptr);
+	blockIndex = static_cast<uint32_t>(slot - pool.blocks.begin());
+	if (slot == pool.blocks.end())
+	{
+		pool.blocks.push_back(std::move(block));
+	}
+	else
+	{
+		*slot = std::move(block);
+	}
+	return true;
+}
+
+void MemoryAllocator::destroyBlock(Block &block)
+{
+	if (block.mapped != nullptr)
+	{
+		vkUnmapMemory(mDevice, block.memory);
+	}
+	vkFreeMemory(mDevice, block.memory, nullptr);
+	--mDeviceAllocationCount;
+}
+
+MemoryAllocatorStats MemoryAllocator::stats()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	MemoryAllocatorStats result;
+	result.deviceAllocationCount = mDeviceAllocationCount;
+	result.maxDeviceAllocationCount = mMaxAllocationCount;
+	result.dedicatedAllocationCount = mDedicatedAllocationCount;
+	result.dedicatedBytes = mDedicatedBytes;
+
+	for (auto &pool : mPools)
+	{
+		MemoryPoolStats poolStats;
+		poolStats.memoryTypeIndex = pool.memoryTypeIndex;
+		poolStats.usage = pool.usage;
+
+		for (auto &block : pool.blocks)
+		{
+			if (!block)
+				continue;
+
+			++poolStats.blockCount;
+			poolStats.allocationCount += block->allocationCount;
+			poolStats.reservedBytes += mBlockSize;
+			poolStats.usedBytes += block->usedBytes;
+			poolStats.requestedBytes += block->requestedBytes;
+			for (uint8_t order = 0; order <= mMaxOrder; ++order)
+			{
+				if (block->freeLists[order].empty())
+					continue;
+				poolStats.freeRangeCount += static_cast<uint32_t>(block->freeLists[order].size());
+				poolStats.largestFreeRange = std::max(poolStats.largestFreeRange, kMinRangeSize << order);
+			}
+		}
+
+		if (poolStats.blockCount > 0)
+		{
+			result.pools.push_back(poolStats);
+		}
+	}
+
+	return result;
+}
+
+bool LinearAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset)
+{
+	VkDeviceSize start = alignUp(mHead, alignment);
+	if (start + size > mCapacity)
+		return false;
+
+	offset = start;
+	mHead = start + size;
+	return true;
+}
+
+bool RingAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment, uint64_t frame, VkDeviceSize &offset)
+{
+	if (size == 0 || size > mCapacity)
+		return false;
+
+	if (mUsed == 0)
+	{
+		mHead = mTail = 0;
+	}
+	else if (mHead == mTail)
+	{
+		return false; // full.
+	}
+
+	VkDeviceSize start = alignUp(mHead, alignment);
+	VkDeviceSize consumed = 0;
+	if (mHead >= mTail)
+	{
+		// free space is [head, capacity) followed by [0, tail).
+		if (start + size <= mCapacity)
+		{
+			consumed = start - mHead + size;
+		}
+		else if (size <= mTail)
+		{
+			// the end of the ring is skipped and counted as used until the frame retires.
+			consumed = mCapacity - mHead + size;
+			start = 0;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	else
+	{
+		if (start + size > mTail)
+			return false;
+		consumed = start - mHead + size;
+	}
+
+	offset = start;
+	mHead = start + size;
+	if (mHead == mCapacity)
+	{
+		mHead = 0;
+	}
+	mUsed += consumed;
+
+	if (!mFrames.empty() && mFrames.back().frame == frame)
+	{
+		mFrames.back().end = mHead;
+	}
+	else
+	{
+		mFrames.push_back({frame, mHead});
+	}
+	return true;
+}
+
+void RingAllocator::release(uint64_t completedFrame)
+{
+	while (!mFrames.empty() && mFrames.front().frame <= completedFrame)
+	{
+		VkDeviceSize end = mFrames.front().end;
+		mUsed -= (end + mCapacity - mTail) % mCapacity;
+		mTail = end;
+		mFrames.pop_front();
+	}
+
+	if (mFrames.empty())
+	{
+		mUsed = 0;
+		mHead = mTail = 0;
+	}
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+// Buffers and optimal-tiling images never share a block, so bufferImageGranularity can be ignored.
+enum class AllocationUsage : uint8_t
+{
+	Buffer,
+	Image
+};
+
+// A range of device memory handed out by MemoryAllocator.
+struct Allocation
+{
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	void *mapped = nullptr; // already offset, null unless the memory is host visible.
+	uint32_t memoryTypeIndex = 0;
+	VkMemoryPropertyFlags propertyFlags = 0;
+
+private:
+	friend class MemoryAllocator;
+	uint32_t mPool = 0;
+	uint32_t mBlock = 0;
+	uint8_t mOrder = 0;
+	bool mDedicated = false;
+};
+
+// buffer together with the memory backing it.
+struct GpuBuffer
+{
+	VkBuffer buffer = VK_NULL_HANDLE;
+	Allocation allocation;
+};
+
+struct MemoryPoolStats
+{
+	uint32_t memoryTypeIndex = 0;
+	AllocationUsage usage = AllocationUsage::Buffer;
+	uint32_t blockCount = 0;
+	uint32_t allocationCount = 0;
+	VkDeviceSize reservedBytes = 0;	 // sum of the block sizes.
+	VkDeviceSize usedBytes = 0;		 // buddy ranges handed out, including rounding.
+	VkDeviceSize requestedBytes = 0; // what callers asked for.
+	VkDeviceSize largestFreeRange = 0;
+	uint32_t freeRangeCount = 0;
+
+	// 0 when all free memory is one range, approaching 1 as it splits into small pieces.
+	double fragmentation() const;
+};
+
+struct MemoryAllocatorStats
+{
+	std::vector<MemoryPoolStats> pools; // only pools owning at least one block.
+	uint32_t deviceAllocationCount = 0; // live vkAllocateMemory calls, blocks plus dedicated.
+	uint32_t maxDeviceAllocationCount = 0;
+	uint32_t dedicatedAllocationCount = 0;
+	VkDeviceSize dedicatedBytes = 0;
+};
+
+// Sub-allocates device memory out of large per-memory-type blocks managed as buddy heaps.
+// Requests larger than half a block get their own vkAllocateMemory. Thread safe.
+class MemoryAllocator
+{
+public:
+	MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize = 64ull << 20);
+	~MemoryAllocator();
+
+	MemoryAllocator(const MemoryAllocator &) = delete;
+	MemoryAllocator &operator=(const MemoryAllocator &) = delete;
+
+	// tries required | preferred first, then required alone, throws when nothing fits.
+	Allocation allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags required,
+						VkMemoryPropertyFlags preferred, AllocationUsage usage);
+	void free(Allocation &allocation);
+
+	// helpers allocating and binding memory for an existing resource.
+	Allocation allocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0);
+	Allocation allocateForImage(VkImage image, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0);
+
+	// no-ops on coherent memory, ranges are widened to nonCoherentAtomSize.
+	void flush(const Allocation &allocation);
+	void invalidate(const Allocation &allocation);
+
+	MemoryAllocatorStats stats();
+	VkDeviceSize blockSize() const { return mBlockSize; }
+
+private:
+	static constexpr VkDeviceSize kMinRangeSize = 256;
+
+	struct Block
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		void *mapped = nullptr;
+		VkDeviceSize usedBytes = 0;
+		VkDeviceSize requestedBytes = 0;
+		uint32_t allocationCount = 0;
+		// free range offsets per order, a range of order n is kMinRangeSize << n bytes.
+		std::vector<std::set<VkDeviceSize>> freeLists;
+	};
+
+	struct Pool
+	{
+		uint32_t memoryTypeIndex = 0;
+		AllocationUsage usage = AllocationUsage::Buffer;
+		std::vector<std::unique_ptr<Block>> blocks; // null entries are reused.
+	};
+
+	bool tryAllocate(const VkMemoryRequirements &requirements, uint32_t memoryTypeIndex, AllocationUsage usage, Allocation &allocation);
+	bool allocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex, Allocation &allocation);
+	bool allocateFromBlock(Block &block, uint8_t order, VkDeviceSize &offset);
+	void freeToBlock(Block &block, VkDeviceSize offset, uint8_t order);
+	bool createBlock(Pool &pool, uint32_t &blockIndex);
+	void destroyBlock(Block &block);
+	VkMappedMemoryRange mappedRange(const Allocation &allocation) const;
+
+	VkDevice mDevice;
+	VkPhysicalDeviceMemoryProperties mMemoryProperties;
+	VkDeviceSize mNonCoherentAtomSize;
+	uint32_t mMaxAllocationCount;
+	VkDeviceSize mBlockSize;
+	uint8_t mMaxOrder;
+
+	std::mutex mMutex;
+	std::vector<Pool> mPools; // indexed by memoryTypeIndex * 2 + usage.
+	uint32_t mDeviceAllocationCount = 0;
+	uint32_t mDedicatedAllocationCount = 0;
+	VkDeviceSize mDedicatedBytes = 0;
+};
+
+// Bump allocator over a caller-owned range, everything is released at once by reset().
+class LinearAllocator
+{
+public:
+	explicit LinearAllocator(VkDeviceSize capacity = 0) : mCapacity(capacity) {}
+
+	// returns false when the range is exhausted, alignment must be a power of two.
+	bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset);
+	void reset() { mHead = 0; }
+
+	VkDeviceSize capacity() const { return mCapacity; }
+	VkDeviceSize used() const { return mHead; }
+
+private:
+	VkDeviceSize mCapacity;
+	VkDeviceSize mHead = 0;
+};
+
+// Ring allocator for per-frame transient data, space is reclaimed once the frame that
+// used it completed on the GPU.
+class RingAllocator
+{
+public:
+	explicit RingAllocator(VkDeviceSize capacity = 0) : mCapacity(capacity) {}
+
+	// frame numbers passed in must not decrease.
+	bool allocate(VkDeviceSize size, VkDeviceSize alignment, uint64_t frame, VkDeviceSize &offset);
+	void release(uint64_t completedFrame);
+
+	VkDeviceSize capacity() const { return mCapacity; }
+	VkDeviceSize used() const { return mUsed; }
+
+private:
+	struct FrameRange
+	{
+		uint64_t frame;
+		VkDeviceSize end; // head position after the frame's last allocation.
+	};
+
+	VkDeviceSize mCapacity;
+	VkDeviceSize mHead = 0;
+	VkDeviceSize mTail = 0;
+	VkDeviceSize mUsed = 0;
+	std::deque<FrameRange> mFrames;
+};
@@ -0,0 +1,591 @@
+#include "MeshFile.h"
+
+#include "VertexLayout.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace
+{
+	const uint32_t kNoVertex = UINT32_MAX;
+
+	uint64_t alignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// the encodings the vertex layouts and the meshlet tables read, anything else cannot be uploaded as is.
+	bool knownEncoding(MeshStream type, VkFormat format, uint32_t stride)
+	{
+		switch (type)
+		{
+		case MeshStream::Position:
+			return format == VK_FORMAT_R32G32B32_SFLOAT && stride == 12;
+		case MeshStream::Normal:
+			return format == VK_FORMAT_R16G16_SNORM && stride == 4;
+		case MeshStream::Uv:
+			return format == VK_FORMAT_R16G16_UNORM && stride == 4;
+		case MeshStream::Index:
+			return (format == VK_FORMAT_R16_UINT && stride == 2) || (format == VK_FORMAT_R32_UINT && stride == 4);
+		case MeshStream::Meshlets:
+			return format == VK_FORMAT_UNDEFINED && stride == sizeof(Meshlet);
+		case MeshStream::MeshletVertices:
+			return format == VK_FORMAT_UNDEFINED && stride == 4;
+		case MeshStream::MeshletTriangles:
+			return format == VK_FORMAT_UNDEFINED && stride == 1;
+		default:
+			return false;
+		}
+	}
+
+	// vertices null means the first count vertices.
+	void boundingSphere(const std::vector<float> &positions, const uint32_t *vertices, size_t count, float center[3], float &radius)
+	{
+		float lower[3] = {INFINITY, INFINITY, INFINITY};
+		float upper[3] = {-INFINITY, -INFINITY, -INFINITY};
+		for (size_t i = 0; i < count; ++i)
+		{
+			const float *position = &positions[(vertices ? vertices[i] : i) * 3];
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				lower[axis] = std::min(lower[axis], position[axis]);
+				upper[axis] = std::max(upper[axis], position[axis]);
+			}
+		}
+
+		float radiusSquared = 0.0f;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			center[axis] = count > 0 ? (lower[axis] + upper[axis]) * 0.5f : 0.0f;
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			const float *position = &positions[(vertices ? vertices[i] : i) * 3];
+			float dx = position[0] - center[0], dy = position[1] - center[1], dz = position[2] - center[2];
+			radiusSquared = std::max(radiusSquared, dx * dx + dy * dy + dz * dz);
+		}
+		radius = std::sqrt(radiusSquared);
+	}
+
+	// area weighted face normals, for sources without any.
+	std::vector<float> computeNormals(const MeshData &mesh)
+	{
+		std::vector<float> normals(mesh.positions.size(), 0.0f);
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			const float *a = &mesh.positions[mesh.indices[i] * 3];
+			const float *b = &mesh.positions[mesh.indices[i + 1] * 3];
+			const float *c = &mesh.positions[mesh.indices[i + 2] * 3];
+			float ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+			float ac[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+			float face[3] = {ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0]};
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				float *normal = &normals[mesh.indices[i + corner] * 3];
+				normal[0] += face[0];
+				normal[1] += face[1];
+				normal[2] += face[2];
+			}
+		}
+		return normals;
+	}
+
+	// the mapping is not null terminated, so neither parser reads past end.
+	const char *skipSpaces(const char *cursor, const char *end)
+	{
+		while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\r'))
+			++cursor;
+		return cursor;
+	}
+
+	bool parseInt(const char *&cursor, const char *end, int64_t &value)
+	{
+		bool negative = cursor < end && *cursor == '-';
+		if (cursor < end && (*cursor == '-' || *cursor == '+'))
+			++cursor;
+		if (cursor == end || *cursor < '0' || *cursor > '9')
+			return false;
+
+		value = 0;
+		while (cursor < end && *cursor >= '0' && *cursor <= '9')
+			value = value * 10 + (*cursor++ - '0');
+		value = negative ? -value : value;
+		return true;
+	}
+
+	bool parseFloat(const char *&cursor, const char *end, float &value)
+	{
+		cursor = skipSpaces(cursor, end);
+		bool negative = cursor < end && *cursor == '-';
+		if (cursor < end && (*cursor == '-' || *cursor == '+'))
+			++cursor;
+
+		double mantissa = 0.0;
+		bool digits = false;
+		while (cursor < end && *cursor >= '0' && *cursor <= '9')
+		{
+			mantissa = mantissa * 10.0 + (*cursor++ - '0');
+			digits = true;
+		}
+		if (cursor < end && *cursor == '.')
+		{
+			double scale = 0.1;
+			for (++cursor; cursor < end && *cursor >= '0' && *cursor <= '9'; ++cursor, scale *= 0.1)
+			{
+				mantissa += (*cursor - '0') * scale;
+				digits = true;
+			}
+		}
+		if (!digits)
+			return false;
+
+		if (cursor < end && (*cursor == 'e' || *cursor == 'E'))
+		{
+			++cursor;
+			int64_t exponent = 0;
+			if (!parseInt(cursor, end, exponent))
+				return false;
+			mantissa *= std::pow(10.0, static_cast<double>(exponent));
+		}
+		value = static_cast<float>(negative ? -mantissa : mantissa);
+		return true;
+	}
+
+	// OBJ indices are 1-based, negative ones count back from the last element so far.
+	bool resolveIndex(int64_t index, size_t count, int64_t &resolved)
+	{
+		resolved = index < 0 ? static_cast<int64_t>(count) + index : index - 1;
+		return index != 0 && resolved >= 0 && resolved < static_cast<int64_t>(count);
+	}
+
+	struct ObjCorner
+	{
+		int64_t position;
+		int64_t uv;
+		int64_t normal;
+
+		bool operator==(const ObjCorner &other) const { return position == other.position && uv == other.uv && normal == other.normal; }
+	};
+
+	struct ObjCornerHash
+	{
+		size_t operator()(const ObjCorner &corner) const
+		{
+			return static_cast<size_t>(corner.position * 73856093) ^ static_cast<size_t>(corner.uv * 19349663) ^ static_cast<size_t>(corner.normal * 83492791);
+		}
+	};
+}
+
+bool MeshFile::open(const std::string &path)
+{
+	if (!mFile.open(path))
+		return false;
+
+	open(mFile.data(), mFile.size(), path);
+	return true;
+}
+
+void MeshFile::open(const uint8_t *data, size_t size, const std::string &name)
+{
+	mHeader = {};
+	for (auto &stream : mStreams)
+	{
+		stream = {};
+	}
+
+	if (size < sizeof(mHeader))
+		throw std::runtime_error("mesh file: " + name + " is truncated.");
+	std::memcpy(&mHeader, data, sizeof(mHeader));
+	if (mHeader.magic != kMagic || mHeader.version != kVersion)
+		throw std::runtime_error("mesh file: " + name + " has an unknown format.");
+
+	size_t tableEnd = sizeof(mHeader) + static_cast<size_t>(mHeader.streamCount) * sizeof(StreamEntry);
+	if (mHeader.streamCount > static_cast<uint32_t>(MeshStream::Count) || tableEnd > size)
+		throw std::runtime_error("mesh file: " + name + " is truncated.");
+
+	// the table and the index values are checked, the streams themselves go to the GPU untouched.
+	for (uint32_t i = 0; i < mHeader.streamCount; ++i)
+	{
+		StreamEntry entry;
+		std::memcpy(&entry, data + sizeof(mHeader) + i * sizeof(StreamEntry), sizeof(entry));
+		if (entry.type >= MeshStream::Count || entry.offset % kStreamAlignment != 0 || entry.offset < tableEnd || entry.offset > size ||
+			entry.size > size - entry.offset || entry.size != static_cast<uint64_t>(entry.count) * entry.stride)
+			throw std::runtime_error("mesh file: " + name + " has a corrupt stream table.");
+
+		Stream &stream = mStreams[static_cast<uint32_t>(entry.type)];
+		if (stream.data)
+			throw std::runtime_error("mesh file: " + name + " has a duplicate stream.");
+		if (!knownEncoding(entry.type, entry.format, entry.stride))
+			throw std::runtime_error("mesh file: " + name + " has a stream in an unsupported format.");
+		stream.data = data + entry.offset;
+		stream.size = entry.size;
+		stream.count = entry.count;
+		stream.stride = entry.stride;
+		stream.format = entry.format;
+	}
+
+	const Stream &positions = stream(MeshStream::Position);
+	const Stream &indices = stream(MeshStream::Index);
+	bool attributesMatch = (!stream(MeshStream::Normal).data || stream(MeshStream::Normal).count == mHeader.vertexCount) &&
+						   (!stream(MeshStream::Uv).data || stream(MeshStream::Uv).count == mHeader.vertexCount);
+	if (!positions.data || positions.count != mHeader.vertexCount || !indices.data || indices.count != mHeader.indexCount ||
+		stream(MeshStream::Meshlets).count != mHeader.meshletCount || !attributesMatch)
+		throw std::runtime_error("mesh file: " + name + " has inconsistent streams.");
+
+	// one pass over the mapped indices, an index past the vertices would make draws fetch
+	// outside the vertex buffers.
+	uint32_t maxIndex = 0;
+	for (uint32_t i = 0; i < indices.count; ++i)
+	{
+		uint32_t index;
+		if (indices.stride == 2)
+		{
+			uint16_t shortIndex;
+			std::memcpy(&shortIndex, indices.data + i * 2, sizeof(shortIndex));
+			index = shortIndex;
+		}
+		else
+		{
+			std::memcpy(&index, indices.data + i * 4, sizeof(index));
+		}
+		maxIndex = std::max(maxIndex, index);
+	}
+	if (indices.count > 0 && maxIndex >= mHeader.vertexCount)
+		throw std::runtime_error("mesh file: " + name + " has an index out of range.");
+}
+
+VkIndexType MeshFile::indexType() const
+{
+	return stream(MeshStream::Index).stride == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+std::vector<uint8_t> MeshFile::pack(const MeshData &mesh)
+{
+	size_t vertexCount = mesh.positions.size() / 3;
+	if (mesh.positions.size() % 3 != 0 || mesh.indices.size() % 3 != 0 || (!mesh.normals.empty() && mesh.normals.size() != mesh.positions.size()) ||
+		(!mesh.uvs.empty() && mesh.uvs.size() != vertexCount * 2) || vertexCount > UINT32_MAX)
+		throw std::runtime_error("mesh file: attribute counts do not match.");
+	for (uint32_t index : mesh.indices)
+	{
+		if (index >= vertexCount)
+			throw std::runtime_error("mesh file: index out of range.");
+	}
+
+	MeshFileHeader header{};
+	header.magic = kMagic;
+	header.version = kVersion;
+	header.vertexCount = static_cast<uint32_t>(vertexCount);
+	header.indexCount = static_cast<uint32_t>(mesh.indices.size());
+	boundingSphere(mesh.positions, nullptr, vertexCount, header.center, header.radius);
+
+	std::vector<int16_t> normals(vertexCount * 2);
+	{
+		std::vector<float> computed;
+		const std::vector<float> &source = mesh.normals.empty() ? (computed = computeNormals(mesh)) : mesh.normals;
+		for (size_t i = 0; i < vertexCount; ++i)
+		{
+			VertexLayout::encodeOctahedral(&source[i * 3], &normals[i * 2]);
+		}
+	}
+
+	std::vector<uint16_t> uvs;
+	if (!mesh.uvs.empty())
+	{
+		float lower[2] = {INFINITY, INFINITY};
+		float upper[2] = {-INFINITY, -INFINITY};
+		for (size_t i = 0; i < mesh.uvs.size(); ++i)
+		{
+			lower[i % 2] = std::min(lower[i % 2], mesh.uvs[i]);
+			upper[i % 2] = std::max(upper[i % 2], mesh.uvs[i]);
+		}
+		for (int axis = 0; axis < 2; ++axis)
+		{
+			header.uvOffset[axis] = lower[axis];
+			header.uvScale[axis] = upper[axis] > lower[axis] ? upper[axis] - lower[axis] : 1.0f;
+		}
+
+		uvs.resize(mesh.uvs.size());
+		for (size_t i = 0; i < mesh.uvs.size(); ++i)
+		{
+			float unorm = (mesh.uvs[i] - header.uvOffset[i % 2]) / header.uvScale[i % 2];
+			uvs[i] = static_cast<uint16_t>(std::lround(std::clamp(unorm, 0.0f, 1.0f) * 65535.0f));
+		}
+	}
+
+	bool shortIndices = vertexCount <= 65536;
+	std::vector<uint16_t> indices16;
+	if (shortIndices)
+	{
+		indices16.assign(mesh.indices.begin(), mesh.indices.end());
+	}
+
+	// greedy in index order: a meshlet is closed once the next triangle would exceed a limit.
+	std::vector<Meshlet> meshlets;
+	std::vector<uint32_t> meshletVertices;
+	std::vector<uint8_t> meshletTriangles;
+	std::vector<uint32_t> localVertex(vertexCount, kNoVertex);
+	Meshlet meshlet{};
+	auto closeMeshlet = [&]()
+	{
+		if (meshlet.triangleCount == 0)
+			return;
+
+		const uint32_t *vertices = meshletVertices.data() + meshlet.vertexOffset;
+		boundingSphere(mesh.positions, vertices, meshlet.vertexCount, meshlet.center, meshlet.radius);
+		for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+		{
+			localVertex[vertices[i]] = kNoVertex;
+		}
+		meshletTriangles.resize(alignUp(meshletTriangles.size(), 4), 0);
+		meshlets.push_back(meshlet);
+
+		meshlet = {};
+		meshlet.vertexOffset = static_cast<uint32_t>(meshletVertices.size());
+		meshlet.triangleOffset = static_cast<uint32_t>(meshletTriangles.size());
+	};
+	for (size_t i = 0; i < mesh.indices.size(); i += 3)
+	{
+		uint32_t a = mesh.indices[i], b = mesh.indices[i + 1], c = mesh.indices[i + 2];
+		uint32_t newVertices = (localVertex[a] == kNoVertex) + (b != a && localVertex[b] == kNoVertex) +
+							   (c != a && c != b && localVertex[c] == kNoVertex);
+		if (meshlet.vertexCount + newVertices > kMaxMeshletVertices || meshlet.triangleCount == kMaxMeshletTriangles)
+		{
+			closeMeshlet();
+		}
+
+		for (uint32_t vertex : {a, b, c})
+		{
+			if (localVertex[vertex] == kNoVertex)
+			{
+				localVertex[vertex] = meshlet.vertexCount++;
+				meshletVertices.push_back(vertex);
+			}
+			meshletTriangles.push_back(static_cast<uint8_t>(localVertex[vertex]));
+		}
+		++meshlet.triangleCount;
+	}
+	closeMeshlet();
+	header.meshletCount = static_cast<uint32_t>(meshlets.size());
+
+	struct Source
+	{
+		StreamEntry entry;
+		const void *data;
+	};
+	auto source = [](MeshStream type, VkFormat format, uint32_t stride, size_t count, const void *data) -> Source
+	{
+		return {{type, format, stride, static_cast<uint32_t>(count), 0, static_cast<uint64_t>(stride) * count}, data};
+	};
+	std::vector<Source> sources = {
+		source(MeshStream::Position, VK_FORMAT_R32G32B32_SFLOAT, 12, vertexCount, mesh.positions.data()),
+		source(MeshStream::Normal, VK_FORMAT_R16G16_SNORM, 4, vertexCount, normals.data()),
+		source(MeshStream::Index, shortIndices ? VK_FORMAT_R16_UINT : VK_FORMAT_R32_UINT, shortIndices ? 2 : 4, mesh.indices.size(),
+			   shortIndices ? static_cast<const void *>(indices16.data()) : mesh.indices.data()),
+		source(MeshStream::Meshlets, VK_FORMAT_UNDEFINED, sizeof(Meshlet), meshlets.size(), meshlets.data()),
+		source(MeshStream::MeshletVertices, VK_FORMAT_UNDEFINED, 4, meshletVertices.size(), meshletVertices.data()),
+		source(MeshStream::MeshletTriangles, VK_FORMAT_UNDEFINED, 1, meshletTriangles.size(), meshletTriangles.data())};
+	if (!uvs.empty())
+	{
+		sources.push_back(source(MeshStream::Uv, VK_FORMAT_R16G16_UNORM, 4, vertexCount, uvs.data()));
+	}
+	header.streamCount = static_cast<uint32_t>(sources.size());
+
+	uint64_t offset = alignUp(sizeof(header) + sources.size() * sizeof(StreamEntry), kStreamAlignment);
+	for (auto &stream : sources)
+	{
+		stream.entry.offset = offset;
+		offset = alignUp(offset + stream.entry.size, kStreamAlignment);
+	}
+
+	std::vector<uint8_t> image(offset, 0);
+	std::memcpy(image.data(), &header, sizeof(header));
+	for (size_t i = 0; i < sources.size(); ++i)
+	{
+		std::memcpy(image.data() + sizeof(header) + i * sizeof(StreamEntry), &sources[i].entry, sizeof(StreamEntry));
+		if (sources[i].entry.size > 0)
+		{
+			std::memcpy(image.data() + sources[i].entry.offset, sources[i].data, sources[i].entry.size);
+		}
+	}
+	return image;
+}
+
+MeshData MeshFile::unpack() const
+{
+	MeshData mesh;
+	const Stream &positions = stream(MeshStream::Position);
+	mesh.positions.resize(static_cast<size_t>(positions.count) * 3);
+	std::memcpy(mesh.positions.data(), positions.data, positions.size);
+
+	const Stream &normals = stream(MeshStream::Normal);
+	if (normals.data)
+	{
+		mesh.normals.resize(static_cast<size_t>(normals.count) * 3);
+		for (uint32_t i = 0; i < normals.count; ++i)
+		{
+			int16_t encoded[2];
+			std::memcpy(encoded, normals.data + i * 4, sizeof(encoded));
+			VertexLayout::decodeOctahedral(encoded, &mesh.normals[i * 3]);
+		}
+	}
+
+	const Stream &uvs = stream(MeshStream::Uv);
+	if (uvs.data)
+	{
+		mesh.uvs.resize(static_cast<size_t>(uvs.count) * 2);
+		for (size_t i = 0; i < mesh.uvs.size(); ++i)
+		{
+			uint16_t unorm;
+			std::memcpy(&unorm, uvs.data + i * 2, sizeof(unorm));
+			mesh.uvs[i] = unorm / 65535.0f * mHeader.uvScale[i % 2] + mHeader.uvOffset[i % 2];
+		}
+	}
+
+	const Stream &indices = stream(MeshStream::Index);
+	mesh.indices.resize(indices.count);
+	for (uint32_t i = 0; i < indices.count; ++i)
+	{
+		if (indices.stride == 2)
+		{
+			uint16_t index;
+			std::memcpy(&index, indices.data + i * 2, sizeof(index));
+			mesh.indices[i] = index;
+		}
+		else
+		{
+			std::memcpy(&mesh.indices[i], indices.data + i * 4, sizeof(uint32_t));
+		}
+	}
+	return mesh;
+}
+
+void MeshFile::write(const std::string &path, const MeshData &mesh)
+{
+	std::vector<uint8_t> image = pack(mesh);
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char *>(image.data()), static_cast<std::streamsize>(image.size()));
+	if (!file)
+		throw std::runtime_error("mesh file: failed to write " + path + ".");
+}
+
+MeshData MeshFile::importObj(const std::string &path)
+{
+	MappedFile file;
+	if (!file.open(path))
+		throw std::runtime_error("OBJ: cannot open " + path + ".");
+
+	std::vector<float> positions;
+	std::vector<float> uvs;
+	std::vector<float> normals;
+	std::unordered_map<ObjCorner, uint32_t, ObjCornerHash> vertices;
+	std::vector<uint32_t> polygon;
+	bool hasUvs = false;
+	bool hasNormals = false;
+	MeshData mesh;
+
+	const char *cursor = reinterpret_cast<const char *>(file.data());
+	const char *end = cursor + file.size();
+	for (size_t line = 1; cursor < end; ++line)
+	{
+		const char *lineEnd = static_cast<const char *>(std::memchr(cursor, '\n', end - cursor));
+		lineEnd = lineEnd ? lineEnd : end;
+		cursor = skipSpaces(cursor, lineEnd);
+
+		bool valid = true;
+		if (lineEnd - cursor > 2 && cursor[0] == 'v' && (cursor[1] == ' ' || cursor[1] == '\t'))
+		{
+			cursor += 2;
+			float xyz[3];
+			valid = parseFloat(cursor, lineEnd, xyz[0]) && parseFloat(cursor, lineEnd, xyz[1]) && parseFloat(cursor, lineEnd, xyz[2]);
+			positions.insert(positions.end(), xyz, xyz + 3);
+		}
+		else if (lineEnd - cursor > 3 && cursor[0] == 'v' && cursor[1] == 't')
+		{
+			cursor += 2;
+			float uv[2];
+			valid = parseFloat(cursor, lineEnd, uv[0]) && parseFloat(cursor, lineEnd, uv[1]);
+			// OBJ has v pointing up, Vulkan samples with it pointing down.
+			uvs.push_back(uv[0]);
+			uvs.push_back(1.0f - uv[1]);
+		}
+		else if (lineEnd - cursor > 3 && cursor[0] == 'v' && cursor[1] == 'n')
+		{
+			cursor += 2;
+			float xyz[3];
+			valid = parseFloat(cursor, lineEnd, xyz[0]) && parseFloat(cursor, lineEnd, xyz[1]) && parseFloat(cursor, lineEnd, xyz[2]);
+			normals.insert(normals.end(), xyz, xyz + 3);
+		}
+		else if (lineEnd - cursor > 2 && cursor[0] == 'f' && (cursor[1] == ' ' || cursor[1] == '\t'))
+		{
+			cursor += 2;
+			polygon.clear();
+			for (cursor = skipSpaces(cursor, lineEnd); valid && cursor < lineEnd; cursor = skipSpaces(cursor, lineEnd))
+			{
+				// p, p/t, p//n or p/t/n.
+				int64_t position = 0, uv = 0, normal = 0;
+				ObjCorner corner{0, -1, -1};
+				valid = parseInt(cursor, lineEnd, position) && resolveIndex(position, positions.size() / 3, corner.position);
+				if (valid && cursor < lineEnd && *cursor == '/')
+				{
+					++cursor;
+					if (cursor < lineEnd && *cursor != '/')
+					{
+						valid = parseInt(cursor, lineEnd, uv) && resolveIndex(uv, uvs.size() / 2, corner.uv);
+					}
+					if (valid && cursor < lineEnd && *cursor == '/')
+					{
+						++cursor;
+						valid = parseInt(cursor, lineEnd, normal) && resolveIndex(normal, normals.size() / 3, corner.normal);
+					}
+				}
+				if (!valid)
+					break;
+
+				auto found = vertices.find(corner);
+				if (found == vertices.end())
+				{
+					found = vertices.emplace(corner, static_cast<uint32_t>(mesh.positions.size() / 3)).first;
+					const float *p = &positions[corner.position * 3];
+					mesh.positions.insert(mesh.positions.end(), p, p + 3);
+					const float *t = corner.uv >= 0 ? &uvs[corner.uv * 2] : nullptr;
+					mesh.uvs.push_back(t ? t[0] : 0.0f);
+					mesh.uvs.push_back(t ? t[1] : 0.0f);
+					const float *n = corner.normal >= 0 ? &normals[corner.normal * 3] : nullptr;
+					mesh.normals.push_back(n ? n[0] : 0.0f);
+					mesh.normals.push_back(n ? n[1] : 0.0f);
+					mesh.normals.push_back(n ? n[2] : 0.0f);
+					hasUvs = hasUvs || t;
+					hasNormals = hasNormals || n;
+				}
+				polygon.push_back(found->second);
+			}
+
+			valid = valid && polygon.size() >= 3;
+			for (size_t i = 2; valid && i < polygon.size(); ++i)
+			{
+				mesh.indices.push_back(polygon[0]);
+				mesh.indices.push_back(polygon[i - 1]);
+				mesh.indices.push_back(polygon[i]);
+			}
+		}
+		// comments, groups, smoothing groups and materials are ignored.
+
+		if (!valid)
+			throw std::runtime_error("OBJ: " + path + ":" + std::to_string(line) + " is malformed.");
+		cursor = lineEnd + (lineEnd < end ? 1 : 0);
+	}
+
+	if (!hasUvs)
+	{
+		mesh.uvs.clear();
+	}
+	if (!hasNormals)
+	{
+		mesh.normals.clear();
+	}
+	return mesh;
+}
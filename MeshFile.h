@@ -0,0 +1,118 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "ShaderStore.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// host-side triangle mesh, the input of the packer. Normals and uvs are either empty or hold
+// one entry per position.
+struct MeshData
+{
+	std::vector<float> positions; // xyz per vertex.
+	std::vector<float> normals;	  // xyz per vertex.
+	std::vector<float> uvs;		  // uv per vertex.
+	std::vector<uint32_t> indices;
+};
+
+enum class MeshStream : uint32_t
+{
+	Position,		  // R32G32B32_SFLOAT.
+	Normal,			  // octahedral encoding, R16G16_SNORM.
+	Uv,				  // R16G16_UNORM over the uv bounds in the header.
+	Index,			  // R16_UINT up to 65536 vertices, R32_UINT above.
+	Meshlets,		  // one Meshlet each.
+	MeshletVertices,  // uint32 mesh vertex per meshlet vertex.
+	MeshletTriangles, // three uint8 meshlet vertices per triangle, each meshlet padded to 4 bytes.
+	Count
+};
+
+// a cluster of triangles small enough for a mesh shader workgroup or cluster culling.
+struct Meshlet
+{
+	uint32_t vertexOffset;	 // into MeshletVertices.
+	uint32_t triangleOffset; // into MeshletTriangles, in bytes.
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+	float center[3]; // bounding sphere.
+	float radius;
+};
+
+struct MeshFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t meshletCount;
+	uint32_t streamCount;
+	float center[3]; // bounding sphere of all vertices.
+	float radius;
+	float uvOffset[2]; // uv = unorm * uvScale + uvOffset.
+	float uvScale[2];
+};
+
+// Packed binary mesh: a header, an offset table with an entry per stream present and the stream
+// data, every stream aligned to kStreamAlignment. Streams are stored in their GPU formats, so the
+// loader only maps and validates the file; stream() points into the mapping and the data is
+// copied from there straight into staging memory.
+class MeshFile
+{
+public:
+	static const uint32_t kMaxMeshletVertices = 64;
+	static const uint32_t kMaxMeshletTriangles = 124;
+	static const uint32_t kStreamAlignment = 64;
+
+	struct Stream
+	{
+		const uint8_t *data = nullptr; // null when the file has no such stream.
+		uint64_t size = 0;
+		uint32_t count = 0; // elements, bytes for MeshletTriangles.
+		uint32_t stride = 0;
+		VkFormat format = VK_FORMAT_UNDEFINED; // undefined for the meshlet tables.
+	};
+
+	// false if the file cannot be mapped, throws if it is not a valid mesh file.
+	bool open(const std::string &path);
+	// the same over a packed image in memory, which has to outlive the MeshFile.
+	void open(const uint8_t *data, size_t size, const std::string &name);
+
+	const MeshFileHeader &header() const { return mHeader; }
+	const Stream &stream(MeshStream type) const { return mStreams[static_cast<uint32_t>(type)]; }
+	VkIndexType indexType() const;
+
+	// quantizes the attributes, builds the meshlets and returns the file image. Throws for
+	// meshes with mismatched attribute counts or out-of-range indices.
+	static std::vector<uint8_t> pack(const MeshData &mesh);
+	// the inverse of pack(): the vertex and index streams back in floats and 32-bit indices,
+	// without the meshlets. Normals and uvs keep their quantization error.
+	MeshData unpack() const;
+	// pack() written to path, throws on failure.
+	static void write(const std::string &path, const MeshData &mesh);
+
+	// Wavefront OBJ: v, vt, vn and f, polygons fanned into triangles and vertices deduplicated
+	// per position/uv/normal triple. Throws for unreadable or malformed files.
+	static MeshData importObj(const std::string &path);
+
+private:
+	static const uint32_t kMagic = 0x3148534d; // "MSH1"
+	static const uint32_t kVersion = 1;
+
+	struct StreamEntry
+	{
+		MeshStream type;
+		VkFormat format;
+		uint32_t stride;
+		uint32_t count;
+		uint64_t offset; // from the start of the file.
+		uint64_t size;
+	};
+
+	MappedFile mFile;
+	MeshFileHeader mHeader{};
+	Stream mStreams[static_cast<uint32_t>(MeshStream::Count)];
+};
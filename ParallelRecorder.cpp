@@ -0,0 +1,97 @@
+#include "ParallelRecorder.h"
+
+#include <algorithm>
+#include <cassert>
+
+ParallelRecorder::ParallelRecorder(VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCount, uint32_t threadCount)
+	: mDevice(device), mThreads(std::max(threadCount, 1u))
+{
+	mPools.resize(frameCount);
+	for (auto &framePools : mPools)
+	{
+		framePools.resize(mThreads.threadCount());
+		for (auto &worker : framePools)
+		{
+			// no RESET_COMMAND_BUFFER flag, the whole pool is reset at once.
+			VkCommandPoolCreateInfo commandPoolCreateInfo{};
+			{
+				commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+				commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+				commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+			}
+
+			VkResult res = vkCreateCommandPool(mDevice, &commandPoolCreateInfo, nullptr, &worker.commandPool);
+			assert(res == VK_SUCCESS);
+
+			VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
+			{
+				commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+				commandBufferAllocateInfo.commandPool = worker.commandPool;
+				commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+				commandBufferAllocateInfo.commandBufferCount = 1;
+			}
+
+			res = vkAllocateCommandBuffers(mDevice, &commandBufferAllocateInfo, &worker.commandBuffer);
+			assert(res == VK_SUCCESS);
+		}
+	}
+}
+
+ParallelRecorder::~ParallelRecorder()
+{
+	mThreads.waitIdle();
+
+	// destroying the pools frees their command buffers as well.
+	for (auto &framePools : mPools)
+	{
+		for (auto &worker : framePools)
+		{
+			vkDestroyCommandPool(mDevice, worker.commandPool, nullptr);
+		}
+	}
+}
+
+void ParallelRecorder::beginFrame(uint32_t frame)
+{
+	for (auto &worker : mPools[frame])
+	{
+		vkResetCommandPool(mDevice, worker.commandPool, 0);
+	}
+}
+
+const std::vector<VkCommandBuffer> &ParallelRecorder::record(uint32_t frame, const VkCommandBufferInheritanceInfo &inheritance,
+															 uint32_t itemCount, const RecordFunction &recordFunction)
+{
+	// never more ranges than items, a worker with nothing to record would only add overhead.
+	uint32_t workerCount = std::min(mThreads.threadCount(), std::max(itemCount, 1u));
+	uint32_t itemsPerWorker = (itemCount + workerCount - 1) / workerCount;
+
+	mRecorded.resize(workerCount);
+	for (uint32_t i = 0; i < workerCount; ++i)
+	{
+		WorkerPool &worker = mPools[frame][i];
+		mRecorded[i] = worker.commandBuffer;
+
+		uint32_t first = std::min(i * itemsPerWorker, itemCount);
+		uint32_t count = std::min(itemsPerWorker, itemCount - first);
+
+		mThreads.submit([&worker, &inheritance, &recordFunction, first, count]()
+						{
+			VkCommandBufferBeginInfo commandBufferBeginInfo{};
+			{
+				commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+				commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+				commandBufferBeginInfo.pInheritanceInfo = &inheritance;
+			}
+
+			VkResult res = vkBeginCommandBuffer(worker.commandBuffer, &commandBufferBeginInfo);
+			assert(res == VK_SUCCESS);
+			recordFunction(worker.commandBuffer, first, count);
+			res = vkEndCommandBuffer(worker.commandBuffer);
+			assert(res == VK_SUCCESS); });
+	}
+
+	// the lambdas reference the caller's inheritance info and function, wait before returning.
+	mThreads.waitIdle();
+	return mRecorded;
+}
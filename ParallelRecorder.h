@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Records a frame's draw list into secondary command buffers on worker threads.
+// Every worker owns one command pool per slot of the frames-in-flight ring; the pools of a
+// slot are reset wholesale once its fence signaled, no buffer is reset individually.
+class ParallelRecorder
+{
+public:
+	// records items [first, first + count) of the draw list into a secondary buffer that
+	// was begun with the frame's inheritance info.
+	using RecordFunction = std::function<void(VkCommandBuffer commandBuffer, uint32_t first, uint32_t count)>;
+
+	ParallelRecorder(VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCount, uint32_t threadCount);
+	~ParallelRecorder();
+
+	ParallelRecorder(const ParallelRecorder &) = delete;
+	ParallelRecorder &operator=(const ParallelRecorder &) = delete;
+
+	// resets every pool of the slot, the slot's previous submission must have completed.
+	void beginFrame(uint32_t frame);
+
+	// splits the draw list into one contiguous range per worker and blocks until all of them
+	// are recorded. The returned buffers are in draw list order, ready for vkCmdExecuteCommands.
+	const std::vector<VkCommandBuffer> &record(uint32_t frame, const VkCommandBufferInheritanceInfo &inheritance,
+											   uint32_t itemCount, const RecordFunction &recordFunction);
+
+	uint32_t threadCount() const { return mThreads.threadCount(); }
+
+private:
+	struct WorkerPool
+	{
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE; // allocated once, reused after every pool reset.
+	};
+
+	VkDevice mDevice;
+	std::vector<std::vector<WorkerPool>> mPools; // [frame][worker]
+	std::vector<VkCommandBuffer> mRecorded;
+	ThreadPool mThreads;
+};
@@ -0,0 +1,110 @@
+#include "PipelineCompiler.h"
+
+#include <chrono>
+
+uint64_t PipelineVariant::key() const
+{
+	uint64_t key = 0;
+	key |= static_cast<uint64_t>(cullMode & 0x3);
+	key |= static_cast<uint64_t>(polygonMode & 0x3) << 2;
+	key |= static_cast<uint64_t>(blendMode) << 4;
+	key |= static_cast<uint64_t>(topology & 0xf) << 8;
+	key |= static_cast<uint64_t>(samples & 0x7f) << 12;
+	key |= static_cast<uint64_t>(vertexLayout) << 19;
+	key |= static_cast<uint64_t>(positionOnly) << 23;
+	return key;
+}
+
+PipelineCompiler::PipelineCompiler(VkDevice device, BuildFunction build, uint32_t threadCount)
+	: mDevice(device), mBuild(std::move(build)), mThreadPool(threadCount)
+{
+}
+
+PipelineCompiler::~PipelineCompiler()
+{
+	destroyPipelines();
+}
+
+void PipelineCompiler::addReady(const PipelineVariant &variant, VkPipeline pipeline)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	Entry &entry = mEntries[variant.key()];
+	entry.state = State::Ready;
+	entry.pipeline = pipeline;
+}
+
+VkPipeline PipelineCompiler::request(const PipelineVariant &variant, VkPipeline fallback)
+{
+	uint64_t key = variant.key();
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		auto it = mEntries.find(key);
+		if (it != mEntries.end())
+		{
+			return it->second.state == State::Ready ? it->second.pipeline : fallback;
+		}
+
+		mEntries.emplace(key, Entry{});
+	}
+
+	mThreadPool.submit([this, variant]()
+					   { compile(variant); });
+	return fallback;
+}
+
+void PipelineCompiler::compile(PipelineVariant variant)
+{
+	auto start = std::chrono::steady_clock::now();
+	VkPipeline pipeline = mBuild(variant);
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	Entry &entry = mEntries[variant.key()];
+	entry.pipeline = pipeline;
+	entry.state = pipeline != VK_NULL_HANDLE ? State::Ready : State::Failed;
+	if (pipeline != VK_NULL_HANDLE)
+	{
+		++mStats.compiled;
+	}
+	else
+	{
+		++mStats.failed;
+	}
+	mStats.compileMs += ms;
+}
+
+void PipelineCompiler::waitIdle()
+{
+	mThreadPool.waitIdle();
+}
+
+bool PipelineCompiler::idle()
+{
+	return mThreadPool.idle();
+}
+
+void PipelineCompiler::cancelPending()
+{
+	mThreadPool.cancelPending();
+}
+
+void PipelineCompiler::destroyPipelines()
+{
+	mThreadPool.waitIdle();
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	for (auto &entry : mEntries)
+	{
+		if (entry.second.pipeline != VK_NULL_HANDLE)
+		{
+			vkDestroyPipeline(mDevice, entry.second.pipeline, nullptr);
+		}
+	}
+	mEntries.clear();
+}
+
+PipelineCompilerStats PipelineCompiler::stats()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mStats;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "ThreadPool.h"
+#include "VertexLayout.h"
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+enum class BlendMode : uint8_t
+{
+	Opaque,
+	Alpha,
+	Additive
+};
+
+// Fixed-function state that differs between graphics pipeline variants.
+struct PipelineVariant
+{
+	VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+	VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+	BlendMode blendMode = BlendMode::Opaque;
+	VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+	VertexLayoutPreset vertexLayout = VertexLayoutPreset::Quantized;
+	// only the position stream and a vertex shader, no color writes; for depth/shadow passes.
+	bool positionOnly = false;
+
+	// every field packed into its own bits, so equal keys mean equal variants.
+	uint64_t key() const;
+
+	bool operator==(const PipelineVariant &other) const { return key() == other.key(); }
+};
+
+struct PipelineCompilerStats
+{
+	uint32_t compiled = 0;
+	uint32_t failed = 0;
+	double compileMs = 0.0; // summed over all worker threads.
+};
+
+// Compiles pipeline variants on worker threads against a shared VkPipelineCache.
+// request() never blocks, it returns the fallback until the variant is ready.
+class PipelineCompiler
+{
+public:
+	// builds one variant, must be thread safe, returns VK_NULL_HANDLE on failure.
+	using BuildFunction = std::function<VkPipeline(const PipelineVariant &)>;
+
+	PipelineCompiler(VkDevice device, BuildFunction build, uint32_t threadCount);
+	~PipelineCompiler();
+
+	// registers a pipeline built elsewhere (e.g. synchronously at startup).
+	void addReady(const PipelineVariant &variant, VkPipeline pipeline);
+
+	// returns the compiled pipeline or queues the variant and returns fallback.
+	VkPipeline request(const PipelineVariant &variant, VkPipeline fallback);
+
+	void waitIdle();
+	bool idle();
+
+	// drops the variants queued but not yet compiling, for a compiler no longer requested from:
+	// their entries stay pending.
+	void cancelPending();
+
+	// waits for running jobs, then destroys every pipeline owned by the compiler.
+	void destroyPipelines();
+
+	PipelineCompilerStats stats();
+
+private:
+	enum class State : uint8_t
+	{
+		Pending,
+		Ready,
+		Failed
+	};
+
+	struct Entry
+	{
+		State state = State::Pending;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+	};
+
+	void compile(PipelineVariant variant);
+
+private:
+	VkDevice mDevice;
+	BuildFunction mBuild;
+	ThreadPool mThreadPool;
+
+	std::mutex mMutex;
+	std::unordered_map<uint64_t, Entry> mEntries;
+	PipelineCompilerStats mStats;
+};
@@ -0,0 +1,553 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace
+{
+	const VkAccessFlags2 kWriteAccess = VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+										VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT |
+										VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+	bool isOutput(const RenderGraphAccess &final)
+	{
+		return final.stages != VK_PIPELINE_STAGE_2_NONE || final.layout != VK_IMAGE_LAYOUT_UNDEFINED;
+	}
+
+	bool sameImage(const VkImageCreateInfo &a, const VkImageCreateInfo &b)
+	{
+		return a.flags == b.flags && a.imageType == b.imageType && a.format == b.format && a.extent.width == b.extent.width &&
+			   a.extent.height == b.extent.height && a.extent.depth == b.extent.depth && a.mipLevels == b.mipLevels &&
+			   a.arrayLayers == b.arrayLayers && a.samples == b.samples && a.tiling == b.tiling && a.usage == b.usage;
+	}
+
+	VkImageMemoryBarrier2 imageBarrier(VkImage image, VkImageAspectFlags aspect, VkPipelineStageFlags2 srcStages, VkAccessFlags2 srcAccess,
+									   const RenderGraphAccess &dst, VkImageLayout oldLayout, VkImageLayout newLayout)
+	{
+		VkImageMemoryBarrier2 barrier{};
+		{
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+			barrier.srcStageMask = srcStages;
+			barrier.srcAccessMask = srcAccess;
+			barrier.dstStageMask = dst.stages;
+			barrier.dstAccessMask = dst.access;
+			barrier.oldLayout = oldLayout;
+			barrier.newLayout = newLayout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = image;
+			barrier.subresourceRange.aspectMask = aspect;
+			barrier.subresourceRange.baseMipLevel = 0;
+			barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+			barrier.subresourceRange.baseArrayLayer = 0;
+			barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+		}
+		return barrier;
+	}
+
+	VkBufferMemoryBarrier2 bufferBarrier(VkBuffer buffer, VkPipelineStageFlags2 srcStages, VkAccessFlags2 srcAccess, const RenderGraphAccess &dst)
+	{
+		VkBufferMemoryBarrier2 barrier{};
+		{
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+			barrier.srcStageMask = srcStages;
+			barrier.srcAccessMask = srcAccess;
+			barrier.dstStageMask = dst.stages;
+			barrier.dstAccessMask = dst.access;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.buffer = buffer;
+			barrier.offset = 0;
+			barrier.size = VK_WHOLE_SIZE;
+		}
+		return barrier;
+	}
+}
+
+RenderGraph::RenderGraph(VkDevice device, MemoryAllocator &allocator, DeletionQueue &deletionQueue)
+	: mDevice(device), mAllocator(allocator), mDeletionQueue(deletionQueue)
+{
+}
+
+RenderGraph::~RenderGraph()
+{
+	// the owner waits for the device before destroying the graph.
+	for (auto &transient : mTransients)
+	{
+		vkDestroyImageView(mDevice, transient.view, nullptr);
+		vkDestroyImage(mDevice, transient.image, nullptr);
+	}
+	for (auto &slot : mSlots)
+	{
+		mAllocator.free(slot);
+	}
+}
+
+void RenderGraph::reset()
+{
+	mResources.clear();
+	mPasses.clear();
+	mFinalImageBarriers.clear();
+	mFinalBufferBarriers.clear();
+	mCompiled = false;
+}
+
+uint32_t RenderGraph::importImage(const std::string &name, VkImage image, VkImageAspectFlags aspect, const RenderGraphAccess &initial,
+								  const RenderGraphAccess &final)
+{
+	Resource resource;
+	resource.name = name;
+	resource.type = ResourceType::ImportedImage;
+	resource.image = image;
+	resource.aspect = aspect;
+	resource.initial = initial;
+	resource.final = final;
+	mResources.push_back(resource);
+	return static_cast<uint32_t>(mResources.size() - 1);
+}
+
+uint32_t RenderGraph::importBuffer(const std::string &name, VkBuffer buffer, const RenderGraphAccess &initial, const RenderGraphAccess &final)
+{
+	Resource resource;
+	resource.name = name;
+	resource.type = ResourceType::ImportedBuffer;
+	resource.buffer = buffer;
+	resource.initial = initial;
+	resource.final = final;
+	mResources.push_back(resource);
+	return static_cast<uint32_t>(mResources.size() - 1);
+}
+
+uint32_t RenderGraph::createImage(const std::string &name, const VkImageCreateInfo &createInfo, VkImageAspectFlags aspect)
+{
+	Resource resource;
+	resource.name = name;
+	resource.type = ResourceType::TransientImage;
+	resource.aspect = aspect;
+	resource.createInfo = createInfo;
+	mResources.push_back(resource);
+	return static_cast<uint32_t>(mResources.size() - 1);
+}
+
+uint32_t RenderGraph::addPass(const std::string &name, RecordFunction record)
+{
+	Pass pass;
+	pass.name = name;
+	pass.record = std::move(record);
+	mPasses.push_back(std::move(pass));
+	return static_cast<uint32_t>(mPasses.size() - 1);
+}
+
+void RenderGraph::read(uint32_t pass, uint32_t resource, const RenderGraphAccess &access)
+{
+	addUse(pass, resource, access, true, false);
+}
+
+void RenderGraph::write(uint32_t pass, uint32_t resource, const RenderGraphAccess &access)
+{
+	addUse(pass, resource, access, false, true);
+}
+
+void RenderGraph::setSideEffects(uint32_t pass)
+{
+	mPasses[pass].sideEffects = true;
+}
+
+VkImage RenderGraph::image(uint32_t resource) const
+{
+	assert(mCompiled || mResources[resource].type != ResourceType::TransientImage);
+	return mResources[resource].image;
+}
+
+VkImageView RenderGraph::imageView(uint32_t resource) const
+{
+	assert(mCompiled && mResources[resource].type == ResourceType::TransientImage);
+	return mResources[resource].view;
+}
+
+VkBuffer RenderGraph::buffer(uint32_t resource) const
+{
+	return mResources[resource].buffer;
+}
+
+void RenderGraph::addUse(uint32_t pass, uint32_t resource, const RenderGraphAccess &access, bool read, bool write)
+{
+	assert(!mCompiled);
+	// a pass touching a resource twice needs one barrier covering both uses.
+	for (auto &use : mPasses[pass].uses)
+	{
+		if (use.resource == resource)
+		{
+			if (use.access.layout != access.layout)
+				throw std::runtime_error("RenderGraph: pass " + mPasses[pass].name + " uses " + mResources[resource].name + " in two layouts.");
+			use.access.stages |= access.stages;
+			use.access.access |= access.access;
+			use.access.discard = use.access.discard && access.discard;
+			if (access.endLayout != VK_IMAGE_LAYOUT_UNDEFINED)
+				use.access.endLayout = access.endLayout;
+			use.read = use.read || read;
+			use.write = use.write || write;
+			return;
+		}
+	}
+	mPasses[pass].uses.push_back({resource, access, read, write});
+}
+
+void RenderGraph::compile(uint64_t frameNumber)
+{
+	cullPasses();
+	buildTransients(frameNumber);
+
+	std::vector<ResourceState> states(mResources.size());
+	for (size_t i = 0; i < mResources.size(); ++i)
+	{
+		// imported resources enter with their initial access as the last write.
+		const Resource &resource = mResources[i];
+		states[i].writeStages = resource.initial.stages;
+		states[i].writeAccess = resource.initial.access & kWriteAccess;
+		states[i].layout = resource.initial.layout;
+	}
+
+	// the last access to each memory slot, the next transient placed there has to wait for it.
+	// Earlier frames may still use the slots, so the first user waits for all prior work.
+	std::vector<ResourceState> slotStates(mSlots.size());
+	for (auto &slotState : slotStates)
+	{
+		slotState.writeStages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+		slotState.writeAccess = VK_ACCESS_2_MEMORY_WRITE_BIT;
+	}
+
+	for (uint32_t p = 0; p < mPasses.size(); ++p)
+	{
+		Pass &pass = mPasses[p];
+		if (!pass.alive)
+			continue;
+
+		for (const auto &use : pass.uses)
+		{
+			const Resource &resource = mResources[use.resource];
+			ResourceState &state = states[use.resource];
+			RenderGraphAccess access = use.access;
+			if (resource.type == ResourceType::TransientImage && resource.firstPass == p)
+			{
+				// nothing to keep from the previous user of the memory.
+				const ResourceState &slotState = slotStates[mTransients[resource.transient].slot];
+				state.writeStages = slotState.writeStages | slotState.readStages;
+				state.writeAccess = slotState.writeAccess;
+				access.discard = true;
+			}
+			transition(state, resource, access, use.write, pass.imageBarriers, pass.bufferBarriers);
+		}
+
+		for (const auto &use : pass.uses)
+		{
+			const Resource &resource = mResources[use.resource];
+			if (resource.type == ResourceType::TransientImage && resource.lastPass == p)
+			{
+				slotStates[mTransients[resource.transient].slot] = states[use.resource];
+			}
+		}
+	}
+
+	// hand imported outputs over in the state the rest of the frame expects.
+	for (size_t i = 0; i < mResources.size(); ++i)
+	{
+		const Resource &resource = mResources[i];
+		if (resource.type == ResourceType::TransientImage || !isOutput(resource.final))
+			continue;
+
+		ResourceState &state = states[i];
+		VkPipelineStageFlags2 srcStages = state.writeStages | state.readStages;
+		if (resource.type == ResourceType::ImportedImage && resource.final.layout != VK_IMAGE_LAYOUT_UNDEFINED && resource.final.layout != state.layout)
+		{
+			mFinalImageBarriers.push_back(imageBarrier(resource.image, resource.aspect, srcStages, state.writeAccess, resource.final, state.layout, resource.final.layout));
+		}
+		else if (state.writeAccess != VK_ACCESS_2_NONE && (resource.final.access & ~state.visibleAccess) != 0)
+		{
+			if (resource.type == ResourceType::ImportedBuffer)
+				mFinalBufferBarriers.push_back(bufferBarrier(resource.buffer, state.writeStages, state.writeAccess, resource.final));
+			else if (state.layout != VK_IMAGE_LAYOUT_UNDEFINED)
+				mFinalImageBarriers.push_back(imageBarrier(resource.image, resource.aspect, state.writeStages, state.writeAccess, resource.final, state.layout, state.layout));
+		}
+	}
+
+	mCompiled = true;
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer)
+{
+	assert(mCompiled);
+	for (auto &pass : mPasses)
+	{
+		if (!pass.alive)
+			continue;
+		recordBarriers(commandBuffer, pass.imageBarriers, pass.bufferBarriers);
+		pass.record(commandBuffer);
+	}
+	recordBarriers(commandBuffer, mFinalImageBarriers, mFinalBufferBarriers);
+}
+
+void RenderGraph::cullPasses()
+{
+	// walking backwards from the outputs, a pass lives if a later pass or the frame needs one
+	// of its writes; what it reads is then needed from the passes before it.
+	for (auto &resource : mResources)
+	{
+		resource.needed = resource.type != ResourceType::TransientImage && isOutput(resource.final);
+		resource.firstPass = UINT32_MAX;
+		resource.lastPass = 0;
+	}
+
+	for (uint32_t p = static_cast<uint32_t>(mPasses.size()); p-- > 0;)
+	{
+		Pass &pass = mPasses[p];
+		pass.alive = pass.sideEffects;
+		for (const auto &use : pass.uses)
+		{
+			pass.alive = pass.alive || (use.write && mResources[use.resource].needed);
+		}
+
+		++mStats.passCount;
+		if (!pass.alive)
+		{
+			++mStats.culledPassCount;
+			continue;
+		}
+
+		// a plain overwrite satisfies the need, earlier writers are not required for it.
+		for (const auto &use : pass.uses)
+		{
+			if (use.write && !use.read)
+				mResources[use.resource].needed = false;
+		}
+		for (const auto &use : pass.uses)
+		{
+			Resource &resource = mResources[use.resource];
+			if (use.read)
+				resource.needed = true;
+			resource.firstPass = std::min(resource.firstPass, p);
+			resource.lastPass = std::max(resource.lastPass, p);
+		}
+	}
+}
+
+void RenderGraph::buildTransients(uint64_t frameNumber)
+{
+	// transients unused by any alive pass get no memory at all.
+	std::vector<uint32_t> used;
+	for (uint32_t i = 0; i < mResources.size(); ++i)
+	{
+		if (mResources[i].type == ResourceType::TransientImage && mResources[i].firstPass != UINT32_MAX)
+			used.push_back(i);
+	}
+
+	bool unchanged = used.size() == mTransients.size();
+	for (size_t i = 0; unchanged && i < used.size(); ++i)
+	{
+		const Resource &resource = mResources[used[i]];
+		const Transient &transient = mTransients[i];
+		unchanged = sameImage(resource.createInfo, transient.createInfo) && resource.aspect == transient.aspect &&
+					resource.firstPass == transient.firstPass && resource.lastPass == transient.lastPass;
+	}
+
+	if (!unchanged)
+	{
+		destroyTransients(frameNumber > 0 ? frameNumber - 1 : 0);
+
+		for (uint32_t index : used)
+		{
+			const Resource &resource = mResources[index];
+			Transient transient;
+			transient.createInfo = resource.createInfo;
+			transient.aspect = resource.aspect;
+			transient.firstPass = resource.firstPass;
+			transient.lastPass = resource.lastPass;
+
+			VkResult res = vkCreateImage(mDevice, &transient.createInfo, nullptr, &transient.image);
+			assert(res == VK_SUCCESS);
+			vkGetImageMemoryRequirements(mDevice, transient.image, &transient.requirements);
+			mTransients.push_back(transient);
+		}
+
+		// first fit in order of first use: a slot takes an image if no lifetime there overlaps
+		// its own and a memory type suits both. Largest images first would pack tighter, but
+		// frames have few transients and this keeps placement stable.
+		std::vector<uint32_t> order(mTransients.size());
+		for (uint32_t i = 0; i < order.size(); ++i)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b)
+				  { return mTransients[a].firstPass < mTransients[b].firstPass; });
+
+		std::vector<VkMemoryRequirements> slotRequirements;
+		std::vector<std::vector<uint32_t>> slotTransients;
+		for (uint32_t t : order)
+		{
+			Transient &transient = mTransients[t];
+			mStats.transientBytes += transient.requirements.size;
+
+			uint32_t slot = 0;
+			for (; slot < slotRequirements.size(); ++slot)
+			{
+				bool overlaps = std::any_of(slotTransients[slot].begin(), slotTransients[slot].end(), [&](uint32_t other)
+											{ return mTransients[other].firstPass <= transient.lastPass && transient.firstPass <= mTransients[other].lastPass; });
+				if (!overlaps && (slotRequirements[slot].memoryTypeBits & transient.requirements.memoryTypeBits) != 0)
+					break;
+			}
+			if (slot == slotRequirements.size())
+			{
+				slotRequirements.push_back(transient.requirements);
+				slotTransients.emplace_back();
+			}
+
+			VkMemoryRequirements &requirements = slotRequirements[slot];
+			requirements.size = std::max(requirements.size, transient.requirements.size);
+			requirements.alignment = std::max(requirements.alignment, transient.requirements.alignment);
+			requirements.memoryTypeBits &= transient.requirements.memoryTypeBits;
+			slotTransients[slot].push_back(t);
+			transient.slot = slot;
+		}
+
+		for (const auto &requirements : slotRequirements)
+		{
+			mSlots.push_back(mAllocator.allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, AllocationUsage::Image));
+			mStats.aliasedBytes += requirements.size;
+		}
+
+		for (auto &transient : mTransients)
+		{
+			const Allocation &slot = mSlots[transient.slot];
+			VkResult res = vkBindImageMemory(mDevice, transient.image, slot.memory, slot.offset);
+			assert(res == VK_SUCCESS);
+
+			VkImageViewCreateInfo imageViewCreateInfo{};
+			{
+				imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+				imageViewCreateInfo.image = transient.image;
+				imageViewCreateInfo.viewType = transient.createInfo.arrayLayers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+				imageViewCreateInfo.format = transient.createInfo.format;
+				imageViewCreateInfo.subresourceRange.aspectMask = transient.aspect;
+				imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+				imageViewCreateInfo.subresourceRange.levelCount = transient.createInfo.mipLevels;
+				imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+				imageViewCreateInfo.subresourceRange.layerCount = transient.createInfo.arrayLayers;
+			}
+
+			res = vkCreateImageView(mDevice, &imageViewCreateInfo, nullptr, &transient.view);
+			assert(res == VK_SUCCESS);
+		}
+	}
+
+	for (uint32_t i = 0; i < used.size(); ++i)
+	{
+		Resource &resource = mResources[used[i]];
+		resource.transient = i;
+		resource.image = mTransients[i].image;
+		resource.view = mTransients[i].view;
+	}
+}
+
+void RenderGraph::destroyTransients(uint64_t lastUseFrame)
+{
+	if (mTransients.empty())
+		return;
+
+	VkDevice device = mDevice;
+	MemoryAllocator *allocator = &mAllocator;
+	std::vector<Transient> transients = std::move(mTransients);
+	std::vector<Allocation> slots = std::move(mSlots);
+	mDeletionQueue.push(lastUseFrame, [device, allocator, transients, slots]() mutable
+						{
+		for (auto &transient : transients)
+		{
+			vkDestroyImageView(device, transient.view, nullptr);
+			vkDestroyImage(device, transient.image, nullptr);
+		}
+		for (auto &slot : slots)
+		{
+			allocator->free(slot);
+		} });
+	mTransients.clear();
+	mSlots.clear();
+	mStats.transientBytes = 0;
+	mStats.aliasedBytes = 0;
+}
+
+void RenderGraph::transition(ResourceState &state, const Resource &resource, const RenderGraphAccess &access, bool write,
+							 std::vector<VkImageMemoryBarrier2> &imageBarriers, std::vector<VkBufferMemoryBarrier2> &bufferBarriers)
+{
+	bool isImage = resource.type != ResourceType::ImportedBuffer;
+	VkPipelineStageFlags2 srcStages = state.writeStages | state.readStages;
+	VkImageLayout oldLayout = access.discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+	bool layoutChange = isImage && access.layout != VK_IMAGE_LAYOUT_UNDEFINED && (access.discard || oldLayout != access.layout);
+
+	if (layoutChange)
+	{
+		// a transition is a write of its own, later reads have to wait for it.
+		imageBarriers.push_back(imageBarrier(resource.image, resource.aspect, srcStages, state.writeAccess, access, oldLayout, access.layout));
+		state.layout = access.layout;
+		state.writeStages = access.stages;
+		state.writeAccess = write ? access.access & kWriteAccess : VK_ACCESS_2_NONE;
+		state.readStages = VK_PIPELINE_STAGE_2_NONE;
+		state.visibleStages = access.stages;
+		state.visibleAccess = access.access;
+	}
+	else if (write)
+	{
+		// write after write or read, even without a memory dependency the order has to hold.
+		if (srcStages != VK_PIPELINE_STAGE_2_NONE)
+		{
+			if (!isImage)
+				bufferBarriers.push_back(bufferBarrier(resource.buffer, srcStages, state.writeAccess, access));
+			else if (state.layout != VK_IMAGE_LAYOUT_UNDEFINED && access.layout != VK_IMAGE_LAYOUT_UNDEFINED)
+				imageBarriers.push_back(imageBarrier(resource.image, resource.aspect, srcStages, state.writeAccess, access, state.layout, state.layout));
+			// otherwise a render pass transitions the image and its external dependency orders it.
+		}
+		state.writeStages = access.stages;
+		state.writeAccess = access.access & kWriteAccess;
+		state.readStages = VK_PIPELINE_STAGE_2_NONE;
+		state.visibleStages = access.stages;
+		state.visibleAccess = access.access;
+	}
+	else
+	{
+		// readers of the same write share one barrier, later readers only add what is not yet visible.
+		bool visible = (access.stages & ~state.visibleStages) == 0 && (access.access & ~state.visibleAccess) == 0;
+		if (state.writeStages != VK_PIPELINE_STAGE_2_NONE && !visible)
+		{
+			if (!isImage)
+				bufferBarriers.push_back(bufferBarrier(resource.buffer, state.writeStages, state.writeAccess, access));
+			else if (state.layout != VK_IMAGE_LAYOUT_UNDEFINED)
+				imageBarriers.push_back(imageBarrier(resource.image, resource.aspect, state.writeStages, state.writeAccess, access, state.layout, state.layout));
+			state.visibleStages |= access.stages;
+			state.visibleAccess |= access.access;
+		}
+		state.readStages |= access.stages;
+	}
+
+	if (isImage && access.endLayout != VK_IMAGE_LAYOUT_UNDEFINED)
+	{
+		state.layout = access.endLayout;
+	}
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const std::vector<VkImageMemoryBarrier2> &imageBarriers,
+								 const std::vector<VkBufferMemoryBarrier2> &bufferBarriers)
+{
+	if (imageBarriers.empty() && bufferBarriers.empty())
+		return;
+
+	VkDependencyInfo dependencyInfo{};
+	{
+		dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+		dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers.size());
+		dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
+		dependencyInfo.bufferMemoryBarrierCount = static_cast<uint32_t>(bufferBarriers.size());
+		dependencyInfo.pBufferMemoryBarriers = bufferBarriers.data();
+	}
+
+	vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+	++mStats.barrierBatchCount;
+	mStats.imageBarrierCount += imageBarriers.size();
+	mStats.bufferBarrierCount += bufferBarriers.size();
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "DeletionQueue.h"
+#include "MemoryAllocator.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// How a pass touches a resource, or the state a resource enters or leaves the frame in.
+struct RenderGraphAccess
+{
+	VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE;
+	VkAccessFlags2 access = VK_ACCESS_2_NONE;
+	// images only. UNDEFINED leaves the transition to the pass itself (a VkRenderPass), the graph
+	// then only orders the pass after earlier accesses.
+	VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	// layout the pass leaves the image in, UNDEFINED when it stays in layout.
+	VkImageLayout endLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	// the previous contents are not needed, the image is transitioned from UNDEFINED.
+	bool discard = false;
+};
+
+struct RenderGraphStats
+{
+	uint64_t passCount = 0;
+	uint64_t culledPassCount = 0;
+	uint64_t barrierBatchCount = 0; // vkCmdPipelineBarrier2 calls.
+	uint64_t imageBarrierCount = 0;
+	uint64_t bufferBarrierCount = 0;
+	VkDeviceSize transientBytes = 0; // what the transient images would need without aliasing.
+	VkDeviceSize aliasedBytes = 0;	 // what they occupy.
+};
+
+// Per-frame graph of passes declaring their reads and writes of images and buffers. compile()
+// drops passes whose results nobody reads, places transient images with disjoint lifetimes in
+// the same memory and derives the barriers between passes from the declared accesses; execute()
+// records each pass after one batched vkCmdPipelineBarrier2. Passes run in declaration order on
+// one queue, imported resources are synchronized with earlier frames by the caller (fences,
+// semaphores) and carry their initial and final state explicitly.
+//
+// Usage per frame: reset(), import/create resources, addPass() with read()/write(),
+// compile(frameNumber), execute(commandBuffer).
+class RenderGraph
+{
+public:
+	using RecordFunction = std::function<void(VkCommandBuffer)>;
+
+	RenderGraph(VkDevice device, MemoryAllocator &allocator, DeletionQueue &deletionQueue);
+	~RenderGraph();
+
+	RenderGraph(const RenderGraph &) = delete;
+	RenderGraph &operator=(const RenderGraph &) = delete;
+
+	void reset();
+
+	// a final state with stages or a layout makes the resource an output of the frame, the
+	// passes producing it are never culled.
+	uint32_t importImage(const std::string &name, VkImage image, VkImageAspectFlags aspect, const RenderGraphAccess &initial,
+						 const RenderGraphAccess &final);
+	uint32_t importBuffer(const std::string &name, VkBuffer buffer, const RenderGraphAccess &initial, const RenderGraphAccess &final);
+	// created by the graph, contents live only between the first and last pass using it.
+	uint32_t createImage(const std::string &name, const VkImageCreateInfo &createInfo, VkImageAspectFlags aspect);
+
+	uint32_t addPass(const std::string &name, RecordFunction record);
+	void read(uint32_t pass, uint32_t resource, const RenderGraphAccess &access);
+	void write(uint32_t pass, uint32_t resource, const RenderGraphAccess &access);
+	// kept even when nothing reads its writes, e.g. passes with host visible results.
+	void setSideEffects(uint32_t pass);
+
+	// valid after compile(), transient images are recreated only when their declarations change.
+	VkImage image(uint32_t resource) const;
+	VkImageView imageView(uint32_t resource) const;
+	VkBuffer buffer(uint32_t resource) const;
+
+	// frameNumber is the frame the graph is recorded for, retired transients are destroyed after it.
+	void compile(uint64_t frameNumber);
+	void execute(VkCommandBuffer commandBuffer);
+
+	bool isCulled(uint32_t pass) const { return !mPasses[pass].alive; }
+	const RenderGraphStats &stats() const { return mStats; }
+
+private:
+	enum class ResourceType : uint8_t
+	{
+		ImportedImage,
+		ImportedBuffer,
+		TransientImage
+	};
+
+	struct Resource
+	{
+		std::string name;
+		ResourceType type;
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkImageAspectFlags aspect = 0;
+		RenderGraphAccess initial;
+		RenderGraphAccess final;
+		VkImageCreateInfo createInfo{}; // transient images only.
+		uint32_t transient = 0;			// index into mTransients.
+
+		// lifetime over the alive passes, compile() only.
+		uint32_t firstPass = UINT32_MAX;
+		uint32_t lastPass = 0;
+		bool needed = false;
+	};
+
+	struct ResourceUse
+	{
+		uint32_t resource;
+		RenderGraphAccess access;
+		bool read;
+		bool write;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		RecordFunction record;
+		std::vector<ResourceUse> uses;
+		bool sideEffects = false;
+		bool alive = false;
+		// barriers recorded before the pass, filled by compile().
+		std::vector<VkImageMemoryBarrier2> imageBarriers;
+		std::vector<VkBufferMemoryBarrier2> bufferBarriers;
+	};
+
+	// synchronization state of a resource while walking the passes.
+	struct ResourceState
+	{
+		VkPipelineStageFlags2 writeStages = VK_PIPELINE_STAGE_2_NONE;
+		VkAccessFlags2 writeAccess = VK_ACCESS_2_NONE;
+		VkPipelineStageFlags2 readStages = VK_PIPELINE_STAGE_2_NONE; // reads since the last write.
+		VkPipelineStageFlags2 visibleStages = VK_PIPELINE_STAGE_2_NONE;
+		VkAccessFlags2 visibleAccess = VK_ACCESS_2_NONE; // the last write is visible to these.
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	};
+
+	// a transient image with the memory slot it is placed in, kept across frames.
+	struct Transient
+	{
+		VkImageCreateInfo createInfo{};
+		VkImageAspectFlags aspect = 0;
+		uint32_t firstPass = 0;
+		uint32_t lastPass = 0;
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		uint32_t slot = 0;
+		VkMemoryRequirements requirements{};
+	};
+
+	void addUse(uint32_t pass, uint32_t resource, const RenderGraphAccess &access, bool read, bool write);
+	void cullPasses();
+	void buildTransients(uint64_t frameNumber);
+	void destroyTransients(uint64_t lastUseFrame);
+	void transition(ResourceState &state, const Resource &resource, const RenderGraphAccess &access, bool write,
+					std::vector<VkImageMemoryBarrier2> &imageBarriers, std::vector<VkBufferMemoryBarrier2> &bufferBarriers);
+	void recordBarriers(VkCommandBuffer commandBuffer, const std::vector<VkImageMemoryBarrier2> &imageBarriers,
+						const std::vector<VkBufferMemoryBarrier2> &bufferBarriers);
+
+	VkDevice mDevice;
+	MemoryAllocator &mAllocator;
+	DeletionQueue &mDeletionQueue;
+
+	std::vector<Resource> mResources;
+	std::vector<Pass> mPasses;
+	bool mCompiled = false;
+
+	std::vector<Transient> mTransients;
+	std::vector<Allocation> mSlots; // memory shared by transients with disjoint lifetimes.
+
+	// transitions to the final states, recorded after the last pass.
+	std::vector<VkImageMemoryBarrier2> mFinalImageBarriers;
+	std::vector<VkBufferMemoryBarrier2> mFinalBufferBarriers;
+
+	RenderGraphStats mStats;
+};
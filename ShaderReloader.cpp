@@ -0,0 +1,232 @@
+#include "ShaderReloader.h"
+
+#include <shaderc/shaderc.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#else
+#include <filesystem>
+#endif
+
+namespace
+{
+	const int kPollIntervalMs = 100;
+	// editors write in several steps, wait for the burst to settle before compiling.
+	const int kSettleMs = 50;
+
+	std::string directoryOf(const std::string &path)
+	{
+		size_t slash = path.find_last_of('/');
+		return slash == std::string::npos ? "." : path.substr(0, slash);
+	}
+
+	std::string fileNameOf(const std::string &path)
+	{
+		size_t slash = path.find_last_of('/');
+		return slash == std::string::npos ? path : path.substr(slash + 1);
+	}
+
+#ifndef __linux__
+	int64_t modificationTime(const std::string &path)
+	{
+		std::error_code error;
+		auto time = std::filesystem::last_write_time(path, error);
+		return error ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+	}
+#endif
+}
+
+ShaderReloader::ShaderReloader(VkDevice device, std::string vertexPath, std::string fragmentPath, BuildFunction build)
+	: mDevice(device), mVertexPath(std::move(vertexPath)), mFragmentPath(std::move(fragmentPath)), mBuild(std::move(build))
+{
+#ifdef __linux__
+	// the directory is watched rather than the files, editors often save by renaming a new file over the old one.
+	mInotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (mInotify < 0)
+	{
+		throw std::runtime_error("ShaderReloader: inotify_init1 failed.");
+	}
+
+	for (const auto &directory : {directoryOf(mVertexPath), directoryOf(mFragmentPath)})
+	{
+		if (inotify_add_watch(mInotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+		{
+			close(mInotify);
+			throw std::runtime_error("ShaderReloader: failed to watch " + directory);
+		}
+	}
+#else
+	mVertexTime = modificationTime(mVertexPath);
+	mFragmentTime = modificationTime(mFragmentPath);
+#endif
+
+	mThread = std::thread(&ShaderReloader::watchLoop, this);
+}
+
+ShaderReloader::~ShaderReloader()
+{
+	mStop = true;
+	mThread.join();
+
+#ifdef __linux__
+	close(mInotify);
+#endif
+
+	// a program that was never taken was never used by the GPU either.
+	if (mHasReady)
+	{
+		destroyProgram(mReady);
+	}
+}
+
+bool ShaderReloader::takeReady(Program &program)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (!mHasReady)
+	{
+		return false;
+	}
+
+	program = mReady;
+	mReady = Program{};
+	mHasReady = false;
+	return true;
+}
+
+void ShaderReloader::watchLoop()
+{
+	while (!mStop)
+	{
+		if (!waitForChange())
+		{
+			continue;
+		}
+
+		// drop the rest of the burst, one rebuild covers all of it.
+		std::this_thread::sleep_for(std::chrono::milliseconds(kSettleMs));
+		while (!mStop && waitForChange())
+		{
+		}
+
+		if (!mStop)
+		{
+			reload();
+		}
+	}
+}
+
+bool ShaderReloader::waitForChange()
+{
+#ifdef __linux__
+	pollfd pollFd{};
+	pollFd.fd = mInotify;
+	pollFd.events = POLLIN;
+	if (poll(&pollFd, 1, kPollIntervalMs) <= 0)
+	{
+		return false;
+	}
+
+	std::string vertexName = fileNameOf(mVertexPath);
+	std::string fragmentName = fileNameOf(mFragmentPath);
+	bool changed = false;
+
+	alignas(inotify_event) char buffer[4096];
+	ssize_t length;
+	while ((length = read(mInotify, buffer, sizeof(buffer))) > 0)
+	{
+		for (char *p = buffer; p < buffer + length;)
+		{
+			auto event = reinterpret_cast<const inotify_event *>(p);
+			if (event->len > 0 && (vertexName == event->name || fragmentName == event->name))
+			{
+				changed = true;
+			}
+			p += sizeof(inotify_event) + event->len;
+		}
+	}
+	return changed;
+#else
+	std::this_thread::sleep_for(std::chrono::milliseconds(kPollIntervalMs));
+
+	int64_t vertexTime = modificationTime(mVertexPath);
+	int64_t fragmentTime = modificationTime(mFragmentPath);
+	bool changed = vertexTime != mVertexTime || fragmentTime != mFragmentTime;
+	mVertexTime = vertexTime;
+	mFragmentTime = fragmentTime;
+	return changed;
+#endif
+}
+
+void ShaderReloader::reload()
+{
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<uint32_t> vertexCode;
+	std::vector<uint32_t> fragmentCode;
+	Program program;
+	if (!compile(mVertexPath, true, vertexCode) || !compile(mFragmentPath, false, fragmentCode) ||
+		!mBuild(vertexCode, fragmentCode, program))
+	{
+		// the running pipeline stays in place until the sources are fixed.
+		++mFailedCount;
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (mHasReady)
+		{
+			destroyProgram(mReady);
+		}
+		mReady = program;
+		mHasReady = true;
+	}
+
+	++mReloadCount;
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "shader reload: rebuilt pipeline in " << ms << " ms" << std::endl;
+}
+
+bool ShaderReloader::compile(const std::string &path, bool vertex, std::vector<uint32_t> &spirv)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+	{
+		std::cout << "shader reload: failed to open " << path << std::endl;
+		return false;
+	}
+	std::stringstream source;
+	source << file.rdbuf();
+
+	shaderc::Compiler compiler;
+	shaderc::CompileOptions options;
+	options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3);
+	options.SetOptimizationLevel(shaderc_optimization_level_performance);
+
+	shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(
+		source.str(), vertex ? shaderc_vertex_shader : shaderc_fragment_shader, path.c_str(), options);
+	if (result.GetCompilationStatus() != shaderc_compilation_status_success)
+	{
+		std::cout << "shader reload: " << result.GetErrorMessage() << std::endl;
+		return false;
+	}
+
+	spirv.assign(result.cbegin(), result.cend());
+	return true;
+}
+
+void ShaderReloader::destroyProgram(Program &program)
+{
+	vkDestroyPipeline(mDevice, program.pipeline, nullptr);
+	vkDestroyShaderModule(mDevice, program.vertexModule, nullptr);
+	vkDestroyShaderModule(mDevice, program.fragmentModule, nullptr);
+	program = Program{};
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Watches the GLSL sources of the graphics pipeline and rebuilds it on a background thread.
+// Sources are compiled with shaderc and handed to the build function on the watcher thread, so
+// the render thread only picks up a finished program at a frame boundary.
+// Changes are noticed with inotify on Linux and by polling modification times elsewhere.
+class ShaderReloader
+{
+public:
+	struct Program
+	{
+		VkShaderModule vertexModule = VK_NULL_HANDLE;
+		VkShaderModule fragmentModule = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+	};
+
+	// creates the modules and the default pipeline, runs on the watcher thread. Returns false
+	// when the pipeline could not be built, nothing may be left allocated in that case.
+	using BuildFunction = std::function<bool(const std::vector<uint32_t> &vertexCode, const std::vector<uint32_t> &fragmentCode, Program &program)>;
+
+	ShaderReloader(VkDevice device, std::string vertexPath, std::string fragmentPath, BuildFunction build);
+	~ShaderReloader();
+
+	ShaderReloader(const ShaderReloader &) = delete;
+	ShaderReloader &operator=(const ShaderReloader &) = delete;
+
+	// never blocks. The caller owns the returned program and retires the one it replaces.
+	bool takeReady(Program &program);
+
+	uint32_t reloadCount() const { return mReloadCount; }
+	uint32_t failedCount() const { return mFailedCount; }
+
+private:
+	void watchLoop();
+	// blocks for at most one poll interval, true if a watched file changed.
+	bool waitForChange();
+	void reload();
+	bool compile(const std::string &path, bool vertex, std::vector<uint32_t> &spirv);
+	void destroyProgram(Program &program);
+
+	VkDevice mDevice;
+	std::string mVertexPath;
+	std::string mFragmentPath;
+	BuildFunction mBuild;
+
+#ifdef __linux__
+	int mInotify = -1;
+#else
+	int64_t mVertexTime = 0;
+	int64_t mFragmentTime = 0;
+#endif
+
+	std::mutex mMutex;
+	Program mReady; // built but not taken yet, replaced if a newer build finishes first.
+	bool mHasReady = false;
+
+	std::atomic<bool> mStop{false};
+	std::atomic<uint32_t> mReloadCount{0};
+	std::atomic<uint32_t> mFailedCount{0};
+	std::thread mThread;
+};
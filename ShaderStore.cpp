@@ -0,0 +1,268 @@
+#include "ShaderStore.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+	const uint32_t kSpirvMagic = 0x07230203;
+
+	bool isSpirv(const uint8_t *data, size_t size)
+	{
+		uint32_t magic = 0;
+		if (size < sizeof(magic) || size % 4 != 0)
+			return false;
+		std::memcpy(&magic, data, sizeof(magic));
+		return magic == kSpirvMagic;
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if (mData != nullptr)
+	{
+		munmap(mData, mSize);
+	}
+}
+
+bool MappedFile::open(const std::string &path)
+{
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	// the mapping keeps the file referenced, the descriptor is not needed afterwards.
+	void *data = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return false;
+
+	mData = static_cast<uint8_t *>(data);
+	mSize = static_cast<size_t>(fileStat.st_size);
+	return true;
+}
+
+ShaderStore::ShaderStore(VkDevice device, const std::string &archivePath)
+	: mDevice(device)
+{
+	if (archivePath.empty() || !mArchive.open(archivePath))
+		return;
+
+	ArchiveHeader header{};
+	if (mArchive.size() < sizeof(header))
+		throw std::runtime_error("shader archive: " + archivePath + " is truncated.");
+	std::memcpy(&header, mArchive.data(), sizeof(header));
+	if (header.magic != kMagic || header.version != kVersion)
+		throw std::runtime_error("shader archive: " + archivePath + " has an unknown format.");
+
+	size_t tableEnd = sizeof(header) + static_cast<size_t>(header.entryCount) * sizeof(ArchiveEntry);
+	if (tableEnd > mArchive.size())
+		throw std::runtime_error("shader archive: " + archivePath + " is truncated.");
+
+	struct stat archiveStat;
+	if (stat(archivePath.c_str(), &archiveStat) != 0)
+		throw std::runtime_error("shader archive: cannot stat " + archivePath);
+
+	// entries are 8-byte aligned within the page aligned mapping, they are read in place.
+	auto entries = reinterpret_cast<const ArchiveEntry *>(mArchive.data() + sizeof(header));
+	for (uint32_t i = 0; i < header.entryCount; ++i)
+	{
+		// offset is checked against the size first, the size check would wrap around otherwise.
+		const ArchiveEntry &entry = entries[i];
+		if (entry.offset % 4 != 0 || entry.offset < tableEnd || entry.offset > mArchive.size() ||
+			entry.size > mArchive.size() - entry.offset || !isSpirv(mArchive.data() + entry.offset, entry.size))
+			throw std::runtime_error("shader archive: " + archivePath + " has a corrupt entry.");
+
+		// deduplicated names share a blob, it is hashed once.
+		const uint8_t *code = mArchive.data() + entry.offset;
+		auto known = mBlobs.find(entry.hash);
+		if (known == mBlobs.end() || reinterpret_cast<const uint8_t *>(known->second.code) != code)
+		{
+			if (hash(code, entry.size) != entry.hash)
+				throw std::runtime_error("shader archive: " + archivePath + " has a blob that does not match its hash.");
+			mBlobs.emplace(entry.hash, Blob{reinterpret_cast<const uint32_t *>(code), entry.size});
+		}
+
+		std::string name(entry.name, strnlen(entry.name, kNameSize));
+		struct stat looseStat;
+		if (stat(name.c_str(), &looseStat) == 0 && looseStat.st_mtime > archiveStat.st_mtime)
+		{
+			++mStats.staleEntries;
+			continue;
+		}
+		mNames[name] = entry.hash;
+	}
+
+	mStats.archivedBlobs = static_cast<uint32_t>(mBlobs.size());
+	mStats.mappedBytes = mArchive.size();
+}
+
+ShaderStore::~ShaderStore()
+{
+	for (auto &module : mModules)
+	{
+		vkDestroyShaderModule(mDevice, module.second, nullptr);
+	}
+}
+
+VkShaderModule ShaderStore::getModule(const std::string &name)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	auto named = mNames.find(name);
+	if (named == mNames.end())
+	{
+		auto file = std::make_unique<MappedFile>();
+		if (!file->open(name) || !isSpirv(file->data(), file->size()))
+			throw std::runtime_error("shader store: " + name + " is neither archived nor a readable SPIR-V file.");
+
+		uint64_t codeHash = hash(file->data(), file->size());
+		named = mNames.emplace(name, codeHash).first;
+		if (mBlobs.find(codeHash) == mBlobs.end())
+		{
+			mBlobs[codeHash] = Blob{reinterpret_cast<const uint32_t *>(file->data()), file->size()};
+			mStats.mappedBytes += file->size();
+			mLooseFiles.push_back(std::move(file));
+		}
+	}
+
+	uint64_t codeHash = named->second;
+	auto cached = mModules.find(codeHash);
+	if (cached != mModules.end())
+	{
+		++mStats.cacheHits;
+		return cached->second;
+	}
+
+	VkShaderModule module = createModule(codeHash, mBlobs.at(codeHash));
+	mModules[codeHash] = module;
+	++mStats.modulesCreated;
+	return module;
+}
+
+bool ShaderStore::owns(VkShaderModule module)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return std::any_of(mModules.begin(), mModules.end(), [module](const auto &entry)
+					   { return entry.second == module; });
+}
+
+ShaderStoreStats ShaderStore::stats()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mStats;
+}
+
+VkShaderModule ShaderStore::createModule(uint64_t hash, const Blob &blob)
+{
+	// pCode points into the mapping, the driver copies what it needs during the call.
+	VkShaderModuleCreateInfo shaderModuleCreateInfo{};
+	{
+		shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		shaderModuleCreateInfo.codeSize = blob.size;
+		shaderModuleCreateInfo.pCode = blob.code;
+	}
+
+	VkShaderModule module = VK_NULL_HANDLE;
+	if (vkCreateShaderModule(mDevice, &shaderModuleCreateInfo, nullptr, &module) != VK_SUCCESS)
+		throw std::runtime_error("shader store: vkCreateShaderModule failed for blob " + std::to_string(hash));
+	return module;
+}
+
+uint64_t ShaderStore::hash(const void *data, size_t size)
+{
+	const uint8_t *bytes = static_cast<const uint8_t *>(data);
+	uint64_t value = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < size; ++i)
+	{
+		value ^= bytes[i];
+		value *= 0x100000001b3ull;
+	}
+	return value;
+}
+
+void ShaderStore::writeArchive(const std::string &path, const std::vector<std::string> &files)
+{
+	std::vector<ArchiveEntry> entries;
+	std::vector<std::vector<uint8_t>> blobs;
+	std::unordered_map<uint64_t, size_t> blobIndices;
+	std::vector<size_t> entryBlobs;
+
+	for (const auto &file : files)
+	{
+		if (file.size() >= kNameSize)
+			throw std::runtime_error("shader archive: name too long: " + file);
+
+		MappedFile mapped;
+		if (!mapped.open(file) || !isSpirv(mapped.data(), mapped.size()))
+			throw std::runtime_error("shader archive: " + file + " is not a readable SPIR-V file.");
+
+		// identical code is stored once, every name referencing it points at the same blob.
+		uint64_t codeHash = hash(mapped.data(), mapped.size());
+		auto known = blobIndices.find(codeHash);
+		if (known == blobIndices.end())
+		{
+			known = blobIndices.emplace(codeHash, blobs.size()).first;
+			blobs.emplace_back(mapped.data(), mapped.data() + mapped.size());
+		}
+
+		ArchiveEntry entry{};
+		entry.hash = codeHash;
+		entry.size = mapped.size();
+		std::memcpy(entry.name, file.c_str(), file.size());
+		entries.push_back(entry);
+		entryBlobs.push_back(known->second);
+	}
+
+	// blob sizes are multiples of 4, so every blob after the table stays 4-byte aligned.
+	std::vector<uint64_t> blobOffsets(blobs.size());
+	uint64_t offset = sizeof(ArchiveHeader) + entries.size() * sizeof(ArchiveEntry);
+	for (size_t i = 0; i < blobs.size(); ++i)
+	{
+		blobOffsets[i] = offset;
+		offset += blobs[i].size();
+	}
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		entries[i].offset = blobOffsets[entryBlobs[i]];
+	}
+
+	ArchiveHeader header{};
+	header.magic = kMagic;
+	header.version = kVersion;
+	header.entryCount = static_cast<uint32_t>(entries.size());
+
+	// written next to the target and renamed over it, a reader never maps a partial archive.
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(ArchiveEntry));
+		for (const auto &blob : blobs)
+		{
+			out.write(reinterpret_cast<const char *>(blob.data()), blob.size());
+		}
+		if (!out.good())
+			throw std::runtime_error("shader archive: failed to write " + tempPath);
+	}
+	if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+	{
+		std::remove(tempPath.c_str());
+		throw std::runtime_error("shader archive: failed to replace " + path);
+	}
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Read-only memory mapping of a whole file, unmapped on destruction.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	// false if the file does not exist or cannot be mapped.
+	bool open(const std::string &path);
+
+	const uint8_t *data() const { return mData; }
+	size_t size() const { return mSize; }
+
+private:
+	uint8_t *mData = nullptr;
+	size_t mSize = 0;
+};
+
+struct ShaderStoreStats
+{
+	uint32_t archivedBlobs = 0;
+	uint32_t staleEntries = 0; // archived names served from a newer loose file instead.
+	uint32_t modulesCreated = 0;
+	uint32_t cacheHits = 0; // requests served by an already created module.
+	size_t mappedBytes = 0;
+};
+
+// SPIR-V modules served from a memory-mapped archive of blobs indexed by content hash.
+// Modules are created straight from the mapping without copying the code and cached by hash,
+// so every pipeline asking for the same code shares one VkShaderModule. Names missing from the
+// archive fall back to a loose file of that name, mapped the same way, and so do archived names
+// whose loose file was modified after the archive, so freshly compiled shaders are not shadowed.
+// The store owns every module it returns, they are destroyed with it.
+class ShaderStore
+{
+public:
+	// a missing archive is not an error, every module then comes from a loose file. Throws if
+	// the archive is malformed or a blob does not match its stored hash.
+	ShaderStore(VkDevice device, const std::string &archivePath);
+	~ShaderStore();
+
+	ShaderStore(const ShaderStore &) = delete;
+	ShaderStore &operator=(const ShaderStore &) = delete;
+
+	// throws if the name is neither archived nor a readable SPIR-V file.
+	VkShaderModule getModule(const std::string &name);
+
+	bool owns(VkShaderModule module);
+
+	ShaderStoreStats stats();
+
+	// FNV-1a over the code bytes.
+	static uint64_t hash(const void *data, size_t size);
+
+	// packs the files into an archive, names are the paths as given. Throws on failure.
+	static void writeArchive(const std::string &path, const std::vector<std::string> &files);
+
+private:
+	static const uint32_t kMagic = 0x41565053; // "SPVA"
+	static const uint32_t kVersion = 1;
+	static const uint32_t kNameSize = 64;
+
+	struct ArchiveHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t reserved;
+	};
+
+	// blobs follow the entry table, each 4-byte aligned as vkCreateShaderModule requires.
+	struct ArchiveEntry
+	{
+		uint64_t hash;
+		uint64_t offset;
+		uint64_t size;
+		char name[kNameSize];
+	};
+
+	struct Blob
+	{
+		const uint32_t *code;
+		size_t size;
+	};
+
+	VkShaderModule createModule(uint64_t hash, const Blob &blob);
+
+	VkDevice mDevice;
+	MappedFile mArchive;
+	std::unordered_map<std::string, uint64_t> mNames;
+	std::unordered_map<uint64_t, Blob> mBlobs;
+	std::vector<std::unique_ptr<MappedFile>> mLooseFiles;
+
+	std::mutex mMutex;
+	std::unordered_map<uint64_t, VkShaderModule> mModules;
+	ShaderStoreStats mStats;
+};
@@ -0,0 +1,324 @@
+#include "StagingUploader.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+StagingUploader::StagingUploader(VkDevice device, MemoryAllocator &allocator, VkQueue transferQueue, uint32_t transferFamily,
+								 uint32_t graphicsFamily, VkDeviceSize stagingSize)
+	: mDevice(device), mAllocator(allocator), mTransferQueue(transferQueue), mTransferFamily(transferFamily),
+	  mGraphicsFamily(graphicsFamily), mRing(stagingSize)
+{
+	VkBufferCreateInfo bufferCreateInfo{};
+	{
+		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferCreateInfo.size = stagingSize;
+		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	}
+
+	VkResult res = vkCreateBuffer(mDevice, &bufferCreateInfo, nullptr, &mStagingBuffer);
+	assert(res == VK_SUCCESS);
+	// written sequentially by the CPU, read once by the GPU.
+	mStagingMemory = mAllocator.allocateForBuffer(mStagingBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	VkCommandPoolCreateInfo commandPoolCreateInfo{};
+	{
+		commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		commandPoolCreateInfo.queueFamilyIndex = mTransferFamily;
+	}
+
+	res = vkCreateCommandPool(mDevice, &commandPoolCreateInfo, nullptr, &mCommandPool);
+	assert(res == VK_SUCCESS);
+}
+
+StagingUploader::~StagingUploader()
+{
+	waitIdle();
+
+	for (auto &batch : mBatches)
+	{
+		mFreeBatches.push_back(batch);
+	}
+	for (auto &batch : mAcquiredBatches)
+	{
+		mFreeBatches.push_back(batch);
+	}
+	for (auto &batch : mFreeBatches)
+	{
+		vkDestroyFence(mDevice, batch.fence, nullptr);
+		if (batch.semaphore != VK_NULL_HANDLE)
+		{
+			vkDestroySemaphore(mDevice, batch.semaphore, nullptr);
+		}
+	}
+
+	// frees the command buffers as well.
+	vkDestroyCommandPool(mDevice, mCommandPool, nullptr);
+	vkDestroyBuffer(mDevice, mStagingBuffer, nullptr);
+	mAllocator.free(mStagingMemory);
+}
+
+StagingUploader::Batch &StagingUploader::currentBatch()
+{
+	if (!mBatches.empty() && !mBatches.back().submitted)
+		return mBatches.back();
+
+	Batch batch;
+	if (!mFreeBatches.empty())
+	{
+		batch = mFreeBatches.back();
+		mFreeBatches.pop_back();
+	}
+	else
+	{
+		VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
+		{
+			commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			commandBufferAllocateInfo.commandPool = mCommandPool;
+			commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			commandBufferAllocateInfo.commandBufferCount = 1;
+		}
+		VkResult res = vkAllocateCommandBuffers(mDevice, &commandBufferAllocateInfo, &batch.commandBuffer);
+		assert(res == VK_SUCCESS);
+
+		VkFenceCreateInfo fenceCreateInfo{};
+		fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		res = vkCreateFence(mDevice, &fenceCreateInfo, nullptr, &batch.fence);
+		assert(res == VK_SUCCESS);
+
+		if (ownershipTransfer())
+		{
+			VkSemaphoreCreateInfo semaphoreCreateInfo{};
+			semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			res = vkCreateSemaphore(mDevice, &semaphoreCreateInfo, nullptr, &batch.semaphore);
+			assert(res == VK_SUCCESS);
+		}
+	}
+
+	VkCommandBufferBeginInfo commandBufferBeginInfo{};
+	{
+		commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	}
+	VkResult res = vkBeginCommandBuffer(batch.commandBuffer, &commandBufferBeginInfo);
+	assert(res == VK_SUCCESS);
+
+	batch.id = mNextBatch++;
+	mBatches.push_back(batch);
+	return mBatches.back();
+}
+
+uint64_t StagingUploader::upload(VkBuffer dst, VkDeviceSize dstOffset, const void *data, VkDeviceSize size,
+								 VkPipelineStageFlags dstStage, VkAccessFlags dstAccess, bool concurrent)
+{
+	// large uploads are split so a single chunk always fits into an empty ring.
+	const VkDeviceSize maxChunk = std::max<VkDeviceSize>(mRing.capacity() / 4, 1);
+	const char *src = static_cast<const char *>(data);
+	VkDeviceSize done = 0;
+	uint64_t batchId = 0;
+	bool transferOwnership = ownershipTransfer() && !concurrent;
+
+	while (done < size)
+	{
+		VkDeviceSize chunk = std::min(size - done, maxChunk);
+		VkDeviceSize stagingOffset = 0;
+		while (!mRing.allocate(chunk, 16, currentBatch().id, stagingOffset))
+		{
+			// staging is full, push out what we have and wait for the oldest batch to free space.
+			submit();
+			if (!waitOldest())
+				throw std::runtime_error("staging ring too small for upload.");
+		}
+
+		Batch &batch = currentBatch();
+		std::memcpy(static_cast<char *>(mStagingMemory.mapped) + stagingOffset, src + done, chunk);
+
+		VkBufferCopy region{};
+		{
+			region.srcOffset = stagingOffset;
+			region.dstOffset = dstOffset + done;
+			region.size = chunk;
+		}
+		vkCmdCopyBuffer(batch.commandBuffer, mStagingBuffer, dst, 1, &region);
+
+		// kept with the graphics side access, the release barrier clears it at submit.
+		VkBufferMemoryBarrier barrier{};
+		{
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = dstAccess;
+			barrier.srcQueueFamilyIndex = transferOwnership ? mTransferFamily : VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = transferOwnership ? mGraphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+			barrier.buffer = dst;
+			barrier.offset = dstOffset + done;
+			barrier.size = chunk;
+		}
+		batch.barriers.push_back(barrier);
+		batch.dstStages |= dstStage;
+		batch.byteCount += chunk;
+		batchId = batch.id;
+
+		done += chunk;
+	}
+
+	return batchId;
+}
+
+void StagingUploader::submit()
+{
+	if (mBatches.empty() || mBatches.back().submitted)
+		return;
+
+	Batch &batch = mBatches.back();
+	if (batch.barriers.empty())
+		return;
+
+	if (ownershipTransfer())
+	{
+		// release half of the queue family ownership transfer, dst access is meaningless here.
+		std::vector<VkBufferMemoryBarrier> releases = batch.barriers;
+		for (auto &release : releases)
+		{
+			release.dstAccessMask = 0;
+		}
+		vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+							 0, nullptr, static_cast<uint32_t>(releases.size()), releases.data(), 0, nullptr);
+	}
+	else
+	{
+		// same queue, later graphics submissions are ordered behind this barrier.
+		vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, batch.dstStages, 0,
+							 0, nullptr, static_cast<uint32_t>(batch.barriers.size()), batch.barriers.data(), 0, nullptr);
+	}
+
+	VkResult res = vkEndCommandBuffer(batch.commandBuffer);
+	assert(res == VK_SUCCESS);
+
+	// coherent memory makes this a no-op.
+	mAllocator.flush(mStagingMemory);
+
+	VkSubmitInfo submitInfo{};
+	{
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.commandBuffer;
+		submitInfo.signalSemaphoreCount = ownershipTransfer() ? 1 : 0;
+		submitInfo.pSignalSemaphores = ownershipTransfer() ? &batch.semaphore : nullptr;
+	}
+
+	res = vkQueueSubmit(mTransferQueue, 1, &submitInfo, batch.fence);
+	assert(res == VK_SUCCESS);
+
+	batch.submitted = true;
+	batch.submitTime = std::chrono::steady_clock::now();
+	++mStats.batchCount;
+	mStats.byteCount += batch.byteCount;
+}
+
+void StagingUploader::poll()
+{
+	auto now = std::chrono::steady_clock::now();
+	for (auto &batch : mBatches)
+	{
+		if (!batch.submitted)
+			break;
+		if (batch.finished)
+			continue;
+		// batches complete in submission order on a single queue.
+		if (vkGetFenceStatus(mDevice, batch.fence) != VK_SUCCESS)
+			break;
+
+		batch.finished = true;
+		mCompletedBatch = batch.id;
+		mStats.transferMs += std::chrono::duration<double, std::milli>(now - batch.submitTime).count();
+	}
+	mRing.release(mCompletedBatch);
+
+	// without an ownership transfer there is nothing to acquire, finished batches are usable.
+	while (!ownershipTransfer() && !mBatches.empty() && mBatches.front().finished)
+	{
+		mAcquiredBatch = mBatches.front().id;
+		recycle(mBatches.front());
+		mBatches.pop_front();
+	}
+}
+
+void StagingUploader::acquire(VkCommandBuffer commandBuffer, uint64_t frameNumber, std::vector<VkSemaphore> &waitSemaphores,
+							  std::vector<VkPipelineStageFlags> &waitStages)
+{
+	if (!ownershipTransfer())
+		return;
+
+	// only finished batches, so the semaphore waits below never stall the graphics queue.
+	std::vector<VkBufferMemoryBarrier> acquires;
+	VkPipelineStageFlags dstStages = 0;
+	while (!mBatches.empty() && mBatches.front().finished)
+	{
+		Batch &batch = mBatches.front();
+		for (auto acquireBarrier : batch.barriers)
+		{
+			acquireBarrier.srcAccessMask = 0;
+			acquires.push_back(acquireBarrier);
+		}
+		dstStages |= batch.dstStages;
+		waitSemaphores.push_back(batch.semaphore);
+		waitStages.push_back(batch.dstStages);
+
+		mAcquiredBatch = batch.id;
+		batch.acquireFrame = frameNumber;
+		mAcquiredBatches.push_back(batch);
+		mBatches.pop_front();
+	}
+
+	if (!acquires.empty())
+	{
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStages, 0,
+							 0, nullptr, static_cast<uint32_t>(acquires.size()), acquires.data(), 0, nullptr);
+	}
+}
+
+void StagingUploader::retire(uint64_t completedFrame)
+{
+	while (!mAcquiredBatches.empty() && mAcquiredBatches.front().acquireFrame <= completedFrame)
+	{
+		recycle(mAcquiredBatches.front());
+		mAcquiredBatches.pop_front();
+	}
+}
+
+void StagingUploader::waitIdle()
+{
+	submit();
+	while (waitOldest())
+	{
+	}
+}
+
+bool StagingUploader::waitOldest()
+{
+	for (auto &batch : mBatches)
+	{
+		if (batch.submitted && !batch.finished)
+		{
+			vkWaitForFences(mDevice, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+			poll();
+			return true;
+		}
+	}
+	return false;
+}
+
+void StagingUploader::recycle(const Batch &batch)
+{
+	vkResetFences(mDevice, 1, &batch.fence);
+	vkResetCommandBuffer(batch.commandBuffer, 0);
+
+	Batch recycled;
+	recycled.commandBuffer = batch.commandBuffer;
+	recycled.fence = batch.fence;
+	recycled.semaphore = batch.semaphore;
+	mFreeBatches.push_back(recycled);
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "MemoryAllocator.h"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+struct UploadStats
+{
+	uint64_t byteCount = 0;
+	uint32_t batchCount = 0;
+	double transferMs = 0.0; // submit to observed completion, summed over batches.
+
+	double megabytesPerSecond() const { return transferMs > 0.0 ? byteCount / (transferMs * 1000.0) : 0.0; }
+};
+
+// Copies host data into device-local buffers through a persistently mapped staging ring.
+// Copies are batched into command buffers submitted on the transfer queue; when that queue
+// belongs to another family than graphics, buffers are released to the graphics family and
+// acquire() records the matching acquire barriers on the graphics side.
+class StagingUploader
+{
+public:
+	StagingUploader(VkDevice device, MemoryAllocator &allocator, VkQueue transferQueue, uint32_t transferFamily,
+					uint32_t graphicsFamily, VkDeviceSize stagingSize);
+	~StagingUploader();
+
+	StagingUploader(const StagingUploader &) = delete;
+	StagingUploader &operator=(const StagingUploader &) = delete;
+
+	// queues a copy into dst and returns the batch carrying it. dstStage/dstAccess describe the
+	// first graphics use. Blocks only when the staging ring is full of unfinished batches.
+	// concurrent buffers are shared with the transfer family, only the batch semaphore orders them.
+	uint64_t upload(VkBuffer dst, VkDeviceSize dstOffset, const void *data, VkDeviceSize size,
+					VkPipelineStageFlags dstStage, VkAccessFlags dstAccess, bool concurrent = false);
+
+	// submits the batch being recorded, a no-op when it is empty.
+	void submit();
+
+	// reclaims staging space of finished batches, never blocks.
+	void poll();
+
+	// records acquire barriers for finished batches into a graphics command buffer and adds the
+	// semaphores the submit of that command buffer has to wait on. frameNumber is the frame of
+	// that submit, the batches keep their semaphores until retire() reports it complete.
+	void acquire(VkCommandBuffer commandBuffer, uint64_t frameNumber, std::vector<VkSemaphore> &waitSemaphores,
+				 std::vector<VkPipelineStageFlags> &waitStages);
+
+	// recycles batches acquired by frames up to completedFrame, whose semaphore waits are done.
+	void retire(uint64_t completedFrame);
+
+	// true once the batch is visible to command buffers recorded after the acquire() call.
+	bool isAcquired(uint64_t batch) const { return batch <= mAcquiredBatch; }
+
+	// blocks until everything submitted so far finished, used by benchmarks and shutdown.
+	void waitIdle();
+
+	bool ownershipTransfer() const { return mTransferFamily != mGraphicsFamily; }
+	const UploadStats &stats() const { return mStats; }
+
+private:
+	struct Batch
+	{
+		uint64_t id = 0;
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+		VkSemaphore semaphore = VK_NULL_HANDLE; // only signaled with an ownership transfer.
+		std::vector<VkBufferMemoryBarrier> barriers;
+		VkPipelineStageFlags dstStages = 0;
+		VkDeviceSize byteCount = 0;
+		bool submitted = false;
+		bool finished = false;
+		std::chrono::steady_clock::time_point submitTime;
+		uint64_t acquireFrame = 0;
+	};
+
+	Batch &currentBatch();
+	void recycle(const Batch &batch);
+	bool waitOldest();
+
+	VkDevice mDevice;
+	MemoryAllocator &mAllocator;
+	VkQueue mTransferQueue;
+	uint32_t mTransferFamily;
+	uint32_t mGraphicsFamily;
+
+	VkBuffer mStagingBuffer = VK_NULL_HANDLE;
+	Allocation mStagingMemory;
+	RingAllocator mRing;
+	VkCommandPool mCommandPool = VK_NULL_HANDLE;
+
+	std::deque<Batch> mBatches;	  // submitted but not yet acquired, plus the one being recorded.
+	std::deque<Batch> mAcquiredBatches; // their semaphores may still be waited on by a graphics submit.
+	std::vector<Batch> mFreeBatches; // recycled command buffers, fences and semaphores.
+	uint64_t mNextBatch = 1;
+	uint64_t mCompletedBatch = 0;
+	uint64_t mAcquiredBatch = 0;
+	UploadStats mStats;
+};
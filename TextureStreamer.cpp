@@ -0,0 +1,556 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+namespace
+{
+	const uint8_t kKtx2Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+	struct Ktx2Header
+	{
+		uint8_t identifier[12];
+		uint32_t vkFormat;
+		uint32_t typeSize;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t layerCount;
+		uint32_t faceCount;
+		uint32_t levelCount;
+		uint32_t supercompressionScheme;
+		uint32_t dfdByteOffset;
+		uint32_t dfdByteLength;
+		uint32_t kvdByteOffset;
+		uint32_t kvdByteLength;
+		uint64_t sgdByteOffset;
+		uint64_t sgdByteLength;
+	};
+	static_assert(sizeof(Ktx2Header) == 80, "KTX2 header layout");
+
+	struct Ktx2Level
+	{
+		uint64_t byteOffset;
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+	};
+
+	// the coarsest levels up to this size are loaded with the texture and never evicted.
+	const VkDeviceSize kMipTailBytes = 64 * 1024;
+
+	uint32_t blockBytes(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+		case VK_FORMAT_BC4_SNORM_BLOCK:
+			return 8;
+		default:
+			return 16;
+		}
+	}
+
+	VkExtent3D levelExtent(uint32_t width, uint32_t height, uint32_t level)
+	{
+		return {std::max(width >> level, 1u), std::max(height >> level, 1u), 1};
+	}
+
+	VkImageMemoryBarrier2 imageBarrier(VkImage image, uint32_t levelCount, VkPipelineStageFlags2 srcStages, VkAccessFlags2 srcAccess,
+									   VkPipelineStageFlags2 dstStages, VkAccessFlags2 dstAccess, VkImageLayout oldLayout, VkImageLayout newLayout)
+	{
+		VkImageMemoryBarrier2 barrier{};
+		{
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+			barrier.srcStageMask = srcStages;
+			barrier.srcAccessMask = srcAccess;
+			barrier.dstStageMask = dstStages;
+			barrier.dstAccessMask = dstAccess;
+			barrier.oldLayout = oldLayout;
+			barrier.newLayout = newLayout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = image;
+			barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			barrier.subresourceRange.baseMipLevel = 0;
+			barrier.subresourceRange.levelCount = levelCount;
+			barrier.subresourceRange.baseArrayLayer = 0;
+			barrier.subresourceRange.layerCount = 1;
+		}
+		return barrier;
+	}
+
+	void pipelineBarrier(VkCommandBuffer commandBuffer, const std::vector<VkImageMemoryBarrier2> &barriers)
+	{
+		VkDependencyInfo dependencyInfo{};
+		{
+			dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+			dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size());
+			dependencyInfo.pImageMemoryBarriers = barriers.data();
+		}
+		vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+	}
+}
+
+TextureStreamer::TextureStreamer(VkPhysicalDevice physicalDevice, VkDevice device, MemoryAllocator &allocator, DescriptorHeap &descriptorHeap,
+								 DeletionQueue &deletionQueue, VkDeviceSize budget, VkDeviceSize stagingSize, uint32_t threadCount)
+	: mPhysicalDevice(physicalDevice), mDevice(device), mAllocator(allocator), mDescriptorHeap(descriptorHeap), mDeletionQueue(deletionQueue), mBudget(budget),
+	  mWorkers(threadCount)
+{
+	createStaging(stagingSize);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	// queued decodes return right away, the workers are joined after this body.
+	mStopping = true;
+
+	// the owner waits for the device before destroying the streamer.
+	for (auto &texture : mTextures)
+	{
+		if (texture->image != VK_NULL_HANDLE)
+		{
+			vkDestroyImageView(mDevice, texture->view, nullptr);
+			vkDestroyImage(mDevice, texture->image, nullptr);
+			mAllocator.free(texture->allocation);
+		}
+	}
+	vkDestroyBuffer(mDevice, mStaging.buffer, nullptr);
+	mAllocator.free(mStaging.allocation);
+}
+
+uint32_t TextureStreamer::load(const std::string &path)
+{
+	auto texture = std::make_unique<Texture>();
+	texture->path = path;
+	if (!texture->file.open(path))
+		throw std::runtime_error("TextureStreamer: cannot open " + path + ".");
+
+	const uint8_t *data = texture->file.data();
+	size_t size = texture->file.size();
+	Ktx2Header header{};
+	if (size < sizeof(header) || std::memcmp(data, kKtx2Identifier, sizeof(kKtx2Identifier)) != 0)
+		throw std::runtime_error("TextureStreamer: " + path + " is not a KTX2 file.");
+	std::memcpy(&header, data, sizeof(header));
+
+	if (header.vkFormat < VK_FORMAT_BC1_RGB_UNORM_BLOCK || header.vkFormat > VK_FORMAT_BC7_SRGB_BLOCK)
+		throw std::runtime_error("TextureStreamer: " + path + " is not block-compressed (BC1-BC7).");
+	if (header.supercompressionScheme != 0)
+		throw std::runtime_error("TextureStreamer: " + path + " is supercompressed, only plain BCn levels are streamed.");
+	if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1 || header.levelCount == 0 ||
+		header.levelCount > TextureStreamerStats::kMaxLevels)
+		throw std::runtime_error("TextureStreamer: " + path + " is not a single 2D texture with stored mip levels.");
+	uint32_t maxLevelCount = 1;
+	while ((std::max(header.pixelWidth, header.pixelHeight) >> maxLevelCount) > 0)
+	{
+		++maxLevelCount;
+	}
+	if (header.levelCount > maxLevelCount)
+		throw std::runtime_error("TextureStreamer: " + path + " has more mip levels than its extent allows.");
+	if (size < sizeof(header) + header.levelCount * sizeof(Ktx2Level))
+		throw std::runtime_error("TextureStreamer: " + path + " is truncated.");
+
+	// BCn support is optional, many non-desktop devices have none. Levels are uploaded to, copied
+	// between and sampled from optimally tiled images.
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(mPhysicalDevice, static_cast<VkFormat>(header.vkFormat), &formatProperties);
+	VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+	if ((formatProperties.optimalTilingFeatures & requiredFeatures) != requiredFeatures)
+		throw std::runtime_error("TextureStreamer: the device cannot sample the block-compressed format of " + path + ".");
+
+	texture->format = static_cast<VkFormat>(header.vkFormat);
+	texture->width = header.pixelWidth;
+	texture->height = header.pixelHeight;
+	texture->levelCount = header.levelCount;
+
+	// the level index follows the header, level 0 is the full resolution.
+	uint32_t bytesPerBlock = blockBytes(texture->format);
+	for (uint32_t level = 0; level < texture->levelCount; ++level)
+	{
+		Ktx2Level index;
+		std::memcpy(&index, data + sizeof(header) + level * sizeof(Ktx2Level), sizeof(index));
+
+		VkExtent3D extent = levelExtent(texture->width, texture->height, level);
+		uint64_t expected = static_cast<uint64_t>((extent.width + 3) / 4) * ((extent.height + 3) / 4) * bytesPerBlock;
+		if (index.byteLength != expected || index.byteOffset + index.byteLength > size)
+			throw std::runtime_error("TextureStreamer: level " + std::to_string(level) + " of " + path + " is malformed.");
+
+		texture->levelOffsets.push_back(index.byteOffset);
+		texture->levelSizes.push_back(index.byteLength);
+	}
+
+	// level 0 is the largest. A level is staged whole, the ring grows to hold it while nothing
+	// staged is still in flight.
+	if (texture->levelSizes[0] > mRing.capacity())
+	{
+		if (mRing.used() > 0)
+			throw std::runtime_error("TextureStreamer: level 0 of " + path + " does not fit the staging ring while uploads are in flight.");
+		vkDestroyBuffer(mDevice, mStaging.buffer, nullptr);
+		mAllocator.free(mStaging.allocation);
+		createStaging(texture->levelSizes[0]);
+	}
+
+	texture->tailLevel = texture->levelCount - 1;
+	VkDeviceSize tailBytes = texture->levelSizes[texture->tailLevel];
+	while (texture->tailLevel > 0 && tailBytes + texture->levelSizes[texture->tailLevel - 1] <= kMipTailBytes)
+	{
+		tailBytes += texture->levelSizes[--texture->tailLevel];
+	}
+
+	texture->residentLevel = texture->levelCount;
+	texture->requestedLevel = texture->tailLevel;
+	texture->previousRequestedLevel = texture->tailLevel;
+	texture->targetLevel = texture->tailLevel;
+	texture->queuedLevel = texture->levelCount;
+
+	uint32_t index = static_cast<uint32_t>(mTextures.size());
+	mTextures.push_back(std::move(texture));
+
+	// the tail is decoded coarsest first, like every later level.
+	Texture &loaded = *mTextures.back();
+	while (loaded.queuedLevel > loaded.targetLevel)
+	{
+		queueDecode(index, --loaded.queuedLevel);
+	}
+	return index;
+}
+
+void TextureStreamer::request(uint32_t texture, float screenTexels, uint64_t frameNumber)
+{
+	Texture &requested = *mTextures[texture];
+	requested.requestedLevel = std::min(requested.requestedLevel, levelForTexels(requested, screenTexels));
+	requested.lastRequestFrame = frameNumber;
+}
+
+void TextureStreamer::retire(uint64_t completedFrame)
+{
+	mRing.release(completedFrame);
+
+	auto now = clock::now();
+	auto completed = std::partition(mPendingUploads.begin(), mPendingUploads.end(), [completedFrame](const PendingUpload &upload)
+									{ return upload.frameNumber > completedFrame; });
+	for (auto it = completed; it != mPendingUploads.end(); ++it)
+	{
+		double latencyMs = std::chrono::duration<double, std::milli>(now - it->queueTime).count();
+		mStats.levelLatencyMs[it->level] += latencyMs;
+		mStats.levelMaxLatencyMs[it->level] = std::max(mStats.levelMaxLatencyMs[it->level], latencyMs);
+	}
+	mPendingUploads.erase(completed, mPendingUploads.end());
+}
+
+void TextureStreamer::update(uint64_t frameNumber)
+{
+	VkDeviceSize requestedBytes = 0;
+	for (auto &texture : mTextures)
+	{
+		// a level stays wanted until a whole window passed without requesting it.
+		if (frameNumber >= texture->windowStart + kRequestFrames)
+		{
+			texture->previousRequestedLevel = texture->requestedLevel;
+			texture->requestedLevel = texture->tailLevel;
+			texture->windowStart = frameNumber;
+		}
+		texture->targetLevel = std::min(texture->requestedLevel, texture->previousRequestedLevel);
+		requestedBytes += levelBytes(*texture, texture->targetLevel);
+	}
+	mStats.requestedBytes = requestedBytes;
+
+	// over budget, the least recently requested textures give up their finest levels first.
+	if (requestedBytes > mBudget)
+	{
+		std::vector<uint32_t> order(mTextures.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b)
+						 { return mTextures[a]->lastRequestFrame < mTextures[b]->lastRequestFrame; });
+		for (uint32_t index : order)
+		{
+			Texture &texture = *mTextures[index];
+			while (requestedBytes > mBudget && texture.targetLevel < texture.tailLevel)
+			{
+				requestedBytes -= texture.levelSizes[texture.targetLevel++];
+			}
+		}
+	}
+
+	for (uint32_t index = 0; index < mTextures.size(); ++index)
+	{
+		Texture &texture = *mTextures[index];
+		// levels finer than the target still decoding are dropped when they arrive.
+		texture.queuedLevel = std::max(texture.queuedLevel, std::min(texture.targetLevel, texture.residentLevel));
+		while (texture.queuedLevel > texture.targetLevel)
+		{
+			queueDecode(index, --texture.queuedLevel);
+		}
+	}
+}
+
+void TextureStreamer::record(VkCommandBuffer commandBuffer, uint64_t frameNumber)
+{
+	// one image replacement with the staging offsets of the levels it uploads.
+	struct Replacement
+	{
+		Texture *texture;
+		uint32_t oldLevel;
+		std::vector<std::pair<uint32_t, VkDeviceSize>> uploads;
+		std::vector<clock::time_point> queueTimes;
+	};
+	std::vector<Replacement> replacements;
+
+	bool stagingFull = false;
+	for (auto &texturePtr : mTextures)
+	{
+		Texture &texture = *texturePtr;
+		Replacement replacement{&texture, texture.residentLevel, {}, {}};
+		uint32_t newLevel = texture.residentLevel;
+
+		std::lock_guard<std::mutex> lock(mDecodedMutex);
+		// stale levels: evicted before they arrived, or decoded twice.
+		for (auto it = texture.decoded.begin(); it != texture.decoded.end();)
+		{
+			it = it->first < texture.targetLevel || it->first >= texture.residentLevel ? texture.decoded.erase(it) : std::next(it);
+		}
+
+		if (texture.targetLevel > texture.residentLevel)
+		{
+			newLevel = texture.targetLevel;
+		}
+		else
+		{
+			// only levels continuing the resident range, coarsest first, as long as staging has room.
+			while (!stagingFull && newLevel > texture.targetLevel)
+			{
+				auto decoded = texture.decoded.find(newLevel - 1);
+				if (decoded == texture.decoded.end())
+					break;
+
+				VkDeviceSize offset = 0;
+				if (!mRing.allocate(decoded->second.data.size(), 16, frameNumber, offset))
+				{
+					stagingFull = true;
+					break;
+				}
+				std::memcpy(static_cast<uint8_t *>(mStaging.allocation.mapped) + offset, decoded->second.data.data(), decoded->second.data.size());
+				replacement.uploads.emplace_back(--newLevel, offset);
+				replacement.queueTimes.push_back(decoded->second.queueTime);
+				texture.decoded.erase(decoded);
+			}
+		}
+
+		if (newLevel != texture.residentLevel)
+		{
+			texture.residentLevel = newLevel;
+			replacements.push_back(std::move(replacement));
+		}
+	}
+
+	if (replacements.empty())
+		return;
+
+	// coherent memory makes this a no-op.
+	mAllocator.flush(mStaging.allocation);
+
+	std::vector<VkImageMemoryBarrier2> beforeCopies;
+	std::vector<VkImageMemoryBarrier2> afterCopies;
+	std::vector<std::pair<VkImage, VkImage>> images; // old and new image per replacement.
+	for (auto &replacement : replacements)
+	{
+		Texture &texture = *replacement.texture;
+		uint32_t levelCount = texture.levelCount - texture.residentLevel;
+
+		VkImageCreateInfo imageCreateInfo{};
+		{
+			imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageCreateInfo.format = texture.format;
+			imageCreateInfo.extent = levelExtent(texture.width, texture.height, texture.residentLevel);
+			imageCreateInfo.mipLevels = levelCount;
+			imageCreateInfo.arrayLayers = 1;
+			imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		}
+
+		VkImage image = VK_NULL_HANDLE;
+		VkResult res = vkCreateImage(mDevice, &imageCreateInfo, nullptr, &image);
+		assert(res == VK_SUCCESS);
+		Allocation allocation = mAllocator.allocateForImage(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		VkImageViewCreateInfo imageViewCreateInfo{};
+		{
+			imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			imageViewCreateInfo.image = image;
+			imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			imageViewCreateInfo.format = texture.format;
+			imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+			imageViewCreateInfo.subresourceRange.levelCount = levelCount;
+			imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+			imageViewCreateInfo.subresourceRange.layerCount = 1;
+		}
+
+		VkImageView view = VK_NULL_HANDLE;
+		res = vkCreateImageView(mDevice, &imageViewCreateInfo, nullptr, &view);
+		assert(res == VK_SUCCESS);
+
+		beforeCopies.push_back(imageBarrier(image, levelCount, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_PIPELINE_STAGE_2_COPY_BIT,
+											VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL));
+		afterCopies.push_back(imageBarrier(image, levelCount, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+										   VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+										   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+
+		VkImage oldImage = texture.image;
+		if (oldImage != VK_NULL_HANDLE)
+		{
+			// earlier frames sampled it, only an execution dependency is needed before reading it.
+			beforeCopies.push_back(imageBarrier(oldImage, texture.levelCount - replacement.oldLevel, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+												VK_ACCESS_2_NONE, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_READ_BIT,
+												VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL));
+
+			VkImageView oldView = texture.view;
+			Allocation oldAllocation = texture.allocation;
+			VkDevice device = mDevice;
+			MemoryAllocator *allocator = &mAllocator;
+			mDeletionQueue.push(frameNumber, [device, allocator, oldImage, oldView, oldAllocation]() mutable
+								{
+				vkDestroyImageView(device, oldView, nullptr);
+				vkDestroyImage(device, oldImage, nullptr);
+				allocator->free(oldAllocation); });
+			mDescriptorHeap.free(DescriptorType::SampledImage, texture.slot, frameNumber);
+
+			mStats.residentBytes -= texture.allocation.size;
+			++mStats.reallocationCount;
+			if (texture.residentLevel > replacement.oldLevel)
+			{
+				mStats.evictedLevels += texture.residentLevel - replacement.oldLevel;
+			}
+		}
+		images.emplace_back(oldImage, image);
+
+		texture.image = image;
+		texture.view = view;
+		texture.allocation = allocation;
+		texture.slot = mDescriptorHeap.addSampledImage(view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		mStats.residentBytes += allocation.size;
+		mStats.peakResidentBytes = std::max(mStats.peakResidentBytes, mStats.residentBytes);
+	}
+
+	pipelineBarrier(commandBuffer, beforeCopies);
+
+	for (size_t i = 0; i < replacements.size(); ++i)
+	{
+		const Replacement &replacement = replacements[i];
+		const Texture &texture = *replacement.texture;
+		VkImage oldImage = images[i].first;
+		VkImage newImage = images[i].second;
+
+		// levels both images hold move over on the GPU.
+		std::vector<VkImageCopy> regions;
+		for (uint32_t level = std::max(texture.residentLevel, replacement.oldLevel); oldImage != VK_NULL_HANDLE && level < texture.levelCount; ++level)
+		{
+			VkImageCopy region{};
+			{
+				region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				region.srcSubresource.mipLevel = level - replacement.oldLevel;
+				region.srcSubresource.baseArrayLayer = 0;
+				region.srcSubresource.layerCount = 1;
+				region.dstSubresource = region.srcSubresource;
+				region.dstSubresource.mipLevel = level - texture.residentLevel;
+				region.extent = levelExtent(texture.width, texture.height, level);
+			}
+			regions.push_back(region);
+		}
+		if (!regions.empty())
+		{
+			vkCmdCopyImage(commandBuffer, oldImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+						   static_cast<uint32_t>(regions.size()), regions.data());
+		}
+
+		for (size_t upload = 0; upload < replacement.uploads.size(); ++upload)
+		{
+			uint32_t level = replacement.uploads[upload].first;
+			VkBufferImageCopy region{};
+			{
+				region.bufferOffset = replacement.uploads[upload].second;
+				region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				region.imageSubresource.mipLevel = level - texture.residentLevel;
+				region.imageSubresource.baseArrayLayer = 0;
+				region.imageSubresource.layerCount = 1;
+				region.imageExtent = levelExtent(texture.width, texture.height, level);
+			}
+			vkCmdCopyBufferToImage(commandBuffer, mStaging.buffer, newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+			++mStats.levelUploads[level];
+			mStats.uploadedBytes += texture.levelSizes[level];
+			mPendingUploads.push_back({frameNumber, level, replacement.queueTimes[upload]});
+		}
+	}
+
+	pipelineBarrier(commandBuffer, afterCopies);
+}
+
+void TextureStreamer::createStaging(VkDeviceSize size)
+{
+	VkBufferCreateInfo bufferCreateInfo{};
+	{
+		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferCreateInfo.size = size;
+		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	}
+
+	VkResult res = vkCreateBuffer(mDevice, &bufferCreateInfo, nullptr, &mStaging.buffer);
+	assert(res == VK_SUCCESS);
+	mStaging.allocation = mAllocator.allocateForBuffer(mStaging.buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	mRing = RingAllocator(size);
+}
+
+void TextureStreamer::queueDecode(uint32_t index, uint32_t level)
+{
+	Texture *texture = mTextures[index].get();
+	clock::time_point queueTime = clock::now();
+	mWorkers.submit([this, texture, level, queueTime]()
+					{
+		if (mStopping)
+			return;
+
+		// BCn blocks are sampled as they are, decoding is reading the level out of the mapping.
+		// Supercompressed levels would be inflated here.
+		DecodedLevel decoded;
+		decoded.queueTime = queueTime;
+		const uint8_t *src = texture->file.data() + texture->levelOffsets[level];
+		decoded.data.assign(src, src + texture->levelSizes[level]);
+
+		std::lock_guard<std::mutex> lock(mDecodedMutex);
+		texture->decoded[level] = std::move(decoded); });
+}
+
+VkDeviceSize TextureStreamer::levelBytes(const Texture &texture, uint32_t firstLevel) const
+{
+	VkDeviceSize bytes = 0;
+	for (uint32_t level = firstLevel; level < texture.levelCount; ++level)
+	{
+		bytes += texture.levelSizes[level];
+	}
+	return bytes;
+}
+
+uint32_t TextureStreamer::levelForTexels(const Texture &texture, float screenTexels) const
+{
+	// the finest level with no more texels than pixels covered, a texel per pixel.
+	float largest = static_cast<float>(std::max(texture.width, texture.height));
+	if (screenTexels >= largest)
+		return 0;
+	if (screenTexels <= 1.0f)
+		return texture.tailLevel;
+	uint32_t level = static_cast<uint32_t>(std::floor(std::log2(largest / screenTexels)));
+	return std::min(level, texture.tailLevel);
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "DeletionQueue.h"
+#include "DescriptorHeap.h"
+#include "MemoryAllocator.h"
+#include "ShaderStore.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct TextureStreamerStats
+{
+	static const uint32_t kMaxLevels = 16;
+
+	VkDeviceSize residentBytes = 0;	 // image memory of all textures.
+	VkDeviceSize requestedBytes = 0; // image memory the requested levels would need without a budget.
+	VkDeviceSize peakResidentBytes = 0;
+	uint64_t reallocationCount = 0; // images replaced to grow or shrink their resident levels.
+	uint64_t evictedLevels = 0;
+	uint64_t uploadedBytes = 0;
+
+	// per mip level, 0 is the full resolution: uploads and the time from queueing the decode
+	// to the frame carrying the copy completing on the GPU.
+	uint64_t levelUploads[kMaxLevels] = {};
+	double levelLatencyMs[kMaxLevels] = {};
+	double levelMaxLatencyMs[kMaxLevels] = {};
+};
+
+// Streams block-compressed (BC1-BC7) KTX2 textures. Worker threads read mip levels out of the
+// memory-mapped files, the graphics queue copies them through a staging ring coarsest first.
+// Each texture keeps a contiguous range of levels resident, from the finest one requested by
+// feedback down to the mip tail that never leaves memory. Growing or shrinking the range
+// replaces the image and copies the levels it keeps, the new image gets its own heap slot.
+// Past the budget the least recently requested textures give up their finest levels first.
+//
+// Levels are staged whole: load() grows the staging ring to the texture's level 0 while no
+// upload is in flight, an 8k BC7 texture needs 64 MiB. Load textures before the first record().
+//
+// Per frame, on the thread recording: retire() once the frame's fence signaled, request() for
+// the textures drawn, update(), then record() outside a render pass before the draws read slot().
+class TextureStreamer
+{
+public:
+	TextureStreamer(VkPhysicalDevice physicalDevice, VkDevice device, MemoryAllocator &allocator, DescriptorHeap &descriptorHeap, DeletionQueue &deletionQueue,
+					VkDeviceSize budget, VkDeviceSize stagingSize, uint32_t threadCount);
+	~TextureStreamer();
+
+	TextureStreamer(const TextureStreamer &) = delete;
+	TextureStreamer &operator=(const TextureStreamer &) = delete;
+
+	// reads the KTX2 header and queues the mip tail, throws for files that cannot be streamed
+	// (not BCn, supercompressed, arrays, cube maps or 3D, more levels than the extent has), for
+	// formats the device cannot sample and copy with optimal tiling and for levels larger than
+	// the staging ring while it cannot grow.
+	uint32_t load(const std::string &path);
+
+	// screenTexels is the largest extent in pixels the texture covers on screen this frame.
+	void request(uint32_t texture, float screenTexels, uint64_t frameNumber);
+
+	// completedFrame and everything before it finished on the GPU.
+	void retire(uint64_t completedFrame);
+
+	// applies the budget to the requested levels, queues decodes and marks evictions.
+	void update(uint64_t frameNumber);
+
+	// uploads decoded levels, copies kept ones into replaced images and transitions them for
+	// sampling in fragment shaders.
+	void record(VkCommandBuffer commandBuffer, uint64_t frameNumber);
+
+	// sampled image slot, DescriptorHeap::kInvalidSlot until the mip tail is resident.
+	uint32_t slot(uint32_t texture) const { return mTextures[texture]->slot; }
+	uint32_t textureCount() const { return static_cast<uint32_t>(mTextures.size()); }
+	const TextureStreamerStats &stats() const { return mStats; }
+
+	// requests older than this many frames are forgotten, the texture shrinks back.
+	static const uint64_t kRequestFrames = 120;
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	struct DecodedLevel
+	{
+		std::vector<uint8_t> data;
+		clock::time_point queueTime;
+	};
+
+	struct Texture
+	{
+		std::string path;
+		MappedFile file;
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t levelCount = 0;
+		std::vector<VkDeviceSize> levelOffsets; // into the file.
+		std::vector<VkDeviceSize> levelSizes;
+		uint32_t tailLevel = 0; // first level of the mip tail.
+
+		// the image holds levels [residentLevel, levelCount), levelCount while nothing is resident.
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		Allocation allocation;
+		uint32_t slot = DescriptorHeap::kInvalidSlot;
+		uint32_t residentLevel = 0;
+
+		// finest level requested in the current and the previous window of kRequestFrames.
+		uint32_t requestedLevel = 0;
+		uint32_t previousRequestedLevel = 0;
+		uint64_t windowStart = 0;
+		uint64_t lastRequestFrame = 0; // orders the textures for eviction.
+
+		uint32_t targetLevel = 0;  // finest level to keep resident, after the budget.
+		uint32_t queuedLevel = 0;  // finest level decoded or being decoded.
+		std::map<uint32_t, DecodedLevel> decoded; // levels ready to upload, guarded by mDecodedMutex.
+	};
+
+	// an upload waiting for its frame to complete, for the latency.
+	struct PendingUpload
+	{
+		uint64_t frameNumber;
+		uint32_t level;
+		clock::time_point queueTime;
+	};
+
+	// replaces mRing, the previous staging buffer must be destroyed.
+	void createStaging(VkDeviceSize size);
+	void queueDecode(uint32_t texture, uint32_t level);
+	VkDeviceSize levelBytes(const Texture &texture, uint32_t firstLevel) const;
+	uint32_t levelForTexels(const Texture &texture, float screenTexels) const;
+
+	VkPhysicalDevice mPhysicalDevice;
+	VkDevice mDevice;
+	MemoryAllocator &mAllocator;
+	DescriptorHeap &mDescriptorHeap;
+	DeletionQueue &mDeletionQueue;
+	VkDeviceSize mBudget;
+
+	GpuBuffer mStaging; // persistently mapped.
+	RingAllocator mRing;
+
+	std::vector<std::unique_ptr<Texture>> mTextures;
+	std::mutex mDecodedMutex;
+	std::vector<PendingUpload> mPendingUploads;
+	TextureStreamerStats mStats;
+
+	// declared last, its workers stop before the textures they read go away.
+	std::atomic<bool> mStopping{false};
+	ThreadPool mWorkers;
+};
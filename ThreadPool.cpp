@@ -0,0 +1,91 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+	if (threadCount == 0)
+	{
+		threadCount = 1;
+	}
+
+	for (uint32_t i = 0; i < threadCount; ++i)
+	{
+		mThreads.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+	}
+	mJobAvailable.notify_all();
+
+	for (auto &thread : mThreads)
+	{
+		thread.join();
+	}
+}
+
+void ThreadPool::submit(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mJobs.push_back(std::move(job));
+	}
+	mJobAvailable.notify_one();
+}
+
+void ThreadPool::waitIdle()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mIdle.wait(lock, [this]()
+			   { return mJobs.empty() && mActiveJobs == 0; });
+}
+
+bool ThreadPool::idle()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mJobs.empty() && mActiveJobs == 0;
+}
+
+void ThreadPool::cancelPending()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mJobs.clear();
+	}
+	mIdle.notify_all();
+}
+
+void ThreadPool::workerLoop()
+{
+	for (;;)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mJobAvailable.wait(lock, [this]()
+							   { return mStopping || !mJobs.empty(); });
+
+			// pending jobs are still drained when stopping.
+			if (mJobs.empty())
+				return;
+
+			job = std::move(mJobs.front());
+			mJobs.pop_front();
+			++mActiveJobs;
+		}
+
+		job();
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			--mActiveJobs;
+			if (mJobs.empty() && mActiveJobs == 0)
+			{
+				mIdle.notify_all();
+			}
+		}
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads executing queued jobs in FIFO order.
+class ThreadPool
+{
+public:
+	explicit ThreadPool(uint32_t threadCount);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	void submit(std::function<void()> job);
+
+	// blocks until the queue is empty and no job is running.
+	void waitIdle();
+	bool idle();
+
+	// drops the queued jobs that have not started, running ones still finish.
+	void cancelPending();
+
+	uint32_t threadCount() const { return static_cast<uint32_t>(mThreads.size()); }
+
+private:
+	void workerLoop();
+
+private:
+	std::vector<std::thread> mThreads;
+	std::deque<std::function<void()>> mJobs;
+	std::mutex mMutex;
+	std::condition_variable mJobAvailable;
+	std::condition_variable mIdle;
+	uint32_t mActiveJobs = 0;
+	bool mStopping = false;
+};
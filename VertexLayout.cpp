@@ -0,0 +1,396 @@
+#include "VertexLayout.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+	bool fitsSemantic(VertexSemantic semantic, VertexFormat format)
+	{
+		switch (semantic)
+		{
+		case VertexSemantic::Position:
+			return format == VertexFormat::Float3 || format == VertexFormat::Half4;
+		case VertexSemantic::Normal:
+			return format == VertexFormat::Float3 || format == VertexFormat::Octahedral16;
+		case VertexSemantic::Uv:
+			return format == VertexFormat::Float2 || format == VertexFormat::Unorm16x2;
+		default:
+			return false;
+		}
+	}
+
+	const char *kPresetNames[] = {"float", "quantized", "split", "packed"};
+}
+
+VertexLayout::VertexLayout(std::string name, std::vector<VertexElement> elements)
+	: mName(std::move(name))
+{
+	bool seen[static_cast<uint32_t>(VertexSemantic::Count)] = {};
+	for (const VertexElement &element : elements)
+	{
+		uint32_t semantic = static_cast<uint32_t>(element.semantic);
+		if (element.semantic >= VertexSemantic::Count || seen[semantic] || !fitsSemantic(element.semantic, element.format))
+			throw std::runtime_error("vertex layout: " + mName + " has an invalid element.");
+		seen[semantic] = true;
+
+		// every format is a multiple of 4 bytes, so packing in order keeps all attributes aligned.
+		if (element.stream >= mStrides.size())
+		{
+			mStrides.resize(element.stream + 1, 0);
+		}
+		mAttributes.push_back({element, mStrides[element.stream]});
+		mStrides[element.stream] += formatSize(element.format);
+	}
+
+	if (std::find(mStrides.begin(), mStrides.end(), 0u) != mStrides.end() || !has(VertexSemantic::Position))
+		throw std::runtime_error("vertex layout: " + mName + " has an empty stream or no position.");
+}
+
+const VertexLayout &VertexLayout::preset(VertexLayoutPreset preset)
+{
+	static const VertexLayout presets[] = {
+		VertexLayout(kPresetNames[0], {{VertexSemantic::Position, VertexFormat::Float3},
+									   {VertexSemantic::Normal, VertexFormat::Float3},
+									   {VertexSemantic::Uv, VertexFormat::Float2}}),
+		VertexLayout(kPresetNames[1], {{VertexSemantic::Position, VertexFormat::Half4},
+									   {VertexSemantic::Normal, VertexFormat::Octahedral16},
+									   {VertexSemantic::Uv, VertexFormat::Unorm16x2}}),
+		VertexLayout(kPresetNames[2], {{VertexSemantic::Position, VertexFormat::Half4, 0},
+									   {VertexSemantic::Normal, VertexFormat::Octahedral16, 1},
+									   {VertexSemantic::Uv, VertexFormat::Unorm16x2, 1}}),
+		VertexLayout(kPresetNames[3], {{VertexSemantic::Position, VertexFormat::Float3, 0},
+									   {VertexSemantic::Normal, VertexFormat::Octahedral16, 1},
+									   {VertexSemantic::Uv, VertexFormat::Unorm16x2, 2}})};
+	static_assert(sizeof(presets) / sizeof(presets[0]) == static_cast<size_t>(VertexLayoutPreset::Count), "one layout per preset");
+	return presets[static_cast<uint32_t>(preset)];
+}
+
+VertexLayoutPreset VertexLayout::findPreset(const std::string &name)
+{
+	for (uint32_t i = 0; i < static_cast<uint32_t>(VertexLayoutPreset::Count); ++i)
+	{
+		if (name == kPresetNames[i])
+			return static_cast<VertexLayoutPreset>(i);
+	}
+	return VertexLayoutPreset::Count;
+}
+
+uint32_t VertexLayout::location(VertexSemantic semantic)
+{
+	// location 2 is the per-instance stream.
+	const uint32_t locations[] = {0, 1, 3};
+	return locations[static_cast<uint32_t>(semantic)];
+}
+
+uint32_t VertexLayout::vertexBytes() const
+{
+	uint32_t bytes = 0;
+	for (uint32_t stride : mStrides)
+	{
+		bytes += stride;
+	}
+	return bytes;
+}
+
+bool VertexLayout::has(VertexSemantic semantic) const
+{
+	return std::any_of(mAttributes.begin(), mAttributes.end(), [semantic](const Attribute &attribute)
+					   { return attribute.element.semantic == semantic; });
+}
+
+VertexFormat VertexLayout::format(VertexSemantic semantic) const
+{
+	for (const Attribute &attribute : mAttributes)
+	{
+		if (attribute.element.semantic == semantic)
+			return attribute.element.format;
+	}
+	throw std::runtime_error("vertex layout: " + mName + " has no such element.");
+}
+
+uint32_t VertexLayout::positionStream() const
+{
+	for (const Attribute &attribute : mAttributes)
+	{
+		if (attribute.element.semantic == VertexSemantic::Position)
+			return attribute.element.stream;
+	}
+	return 0;
+}
+
+uint32_t VertexLayout::positionBytes() const
+{
+	return mStrides[positionStream()];
+}
+
+void VertexLayout::describe(uint32_t firstBinding, bool positionOnly, std::vector<VkVertexInputBindingDescription> &bindings,
+							std::vector<VkVertexInputAttributeDescription> &attributes) const
+{
+	// a position-only pass binds the position's stream at firstBinding, whatever its index.
+	uint32_t positionStream = this->positionStream();
+	for (uint32_t stream = 0; stream < streamCount(); ++stream)
+	{
+		if (positionOnly && stream != positionStream)
+			continue;
+
+		VkVertexInputBindingDescription binding{};
+		{
+			binding.binding = firstBinding + (positionOnly ? 0 : stream);
+			binding.stride = mStrides[stream];
+			binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		}
+		bindings.push_back(binding);
+	}
+
+	for (const Attribute &attribute : mAttributes)
+	{
+		if (positionOnly && attribute.element.semantic != VertexSemantic::Position)
+			continue;
+
+		VkVertexInputAttributeDescription description{};
+		{
+			description.binding = firstBinding + (positionOnly ? 0 : attribute.element.stream);
+			description.location = location(attribute.element.semantic);
+			description.format = vkFormat(attribute.element.format);
+			description.offset = attribute.offset;
+		}
+		attributes.push_back(description);
+	}
+}
+
+EncodedVertices VertexLayout::encode(const MeshData &mesh) const
+{
+	size_t vertexCount = mesh.positions.size() / 3;
+	if (mesh.positions.size() % 3 != 0 || (!mesh.normals.empty() && mesh.normals.size() != mesh.positions.size()) ||
+		(!mesh.uvs.empty() && mesh.uvs.size() != vertexCount * 2) || vertexCount > UINT32_MAX)
+		throw std::runtime_error("vertex layout: attribute counts do not match.");
+
+	EncodedVertices encoded;
+	encoded.vertexCount = static_cast<uint32_t>(vertexCount);
+	encoded.streams.resize(streamCount());
+	for (uint32_t stream = 0; stream < streamCount(); ++stream)
+	{
+		encoded.streams[stream].resize(vertexCount * mStrides[stream]);
+	}
+
+	// unorm uvs cover the mesh's uv bounds, the shader maps them back with the offset and scale.
+	if (has(VertexSemantic::Uv) && format(VertexSemantic::Uv) == VertexFormat::Unorm16x2 && !mesh.uvs.empty())
+	{
+		float lower[2] = {INFINITY, INFINITY};
+		float upper[2] = {-INFINITY, -INFINITY};
+		for (size_t i = 0; i < mesh.uvs.size(); ++i)
+		{
+			lower[i % 2] = std::min(lower[i % 2], mesh.uvs[i]);
+			upper[i % 2] = std::max(upper[i % 2], mesh.uvs[i]);
+		}
+		for (int axis = 0; axis < 2; ++axis)
+		{
+			encoded.uvOffset[axis] = lower[axis];
+			encoded.uvScale[axis] = upper[axis] > lower[axis] ? upper[axis] - lower[axis] : 1.0f;
+		}
+	}
+
+	const float defaultNormal[3] = {0.0f, 0.0f, 1.0f};
+	const float defaultUv[2] = {0.0f, 0.0f};
+	for (const Attribute &attribute : mAttributes)
+	{
+		uint32_t stride = mStrides[attribute.element.stream];
+		uint8_t *out = encoded.streams[attribute.element.stream].data() + attribute.offset;
+		for (size_t i = 0; i < vertexCount; ++i, out += stride)
+		{
+			const float *source = nullptr;
+			switch (attribute.element.semantic)
+			{
+			case VertexSemantic::Position:
+				source = &mesh.positions[i * 3];
+				break;
+			case VertexSemantic::Normal:
+				source = mesh.normals.empty() ? defaultNormal : &mesh.normals[i * 3];
+				break;
+			default:
+				source = mesh.uvs.empty() ? defaultUv : &mesh.uvs[i * 2];
+				break;
+			}
+
+			switch (attribute.element.format)
+			{
+			case VertexFormat::Float2:
+				std::memcpy(out, source, 8);
+				break;
+			case VertexFormat::Float3:
+				std::memcpy(out, source, 12);
+				break;
+			case VertexFormat::Half4:
+			{
+				uint16_t half[4] = {encodeHalf(source[0]), encodeHalf(source[1]), encodeHalf(source[2]), encodeHalf(1.0f)};
+				std::memcpy(out, half, sizeof(half));
+				break;
+			}
+			case VertexFormat::Octahedral16:
+			{
+				int16_t octahedral[2];
+				encodeOctahedral(source, octahedral);
+				std::memcpy(out, octahedral, sizeof(octahedral));
+				break;
+			}
+			case VertexFormat::Unorm16x2:
+			{
+				uint16_t unorm[2];
+				for (int axis = 0; axis < 2; ++axis)
+				{
+					float value = (source[axis] - encoded.uvOffset[axis]) / encoded.uvScale[axis];
+					unorm[axis] = static_cast<uint16_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+				}
+				std::memcpy(out, unorm, sizeof(unorm));
+				break;
+			}
+			}
+		}
+	}
+	return encoded;
+}
+
+const MeshFile::Stream *VertexLayout::fileStream(const MeshFile &file, uint32_t stream) const
+{
+	const Attribute *element = nullptr;
+	for (const Attribute &attribute : mAttributes)
+	{
+		if (attribute.element.stream != stream)
+			continue;
+		if (element)
+			return nullptr;
+		element = &attribute;
+	}
+	if (!element)
+		return nullptr;
+
+	const MeshStream sources[] = {MeshStream::Position, MeshStream::Normal, MeshStream::Uv};
+	const MeshFile::Stream &source = file.stream(sources[static_cast<uint32_t>(element->element.semantic)]);
+	if (!source.data || source.format != vkFormat(element->element.format) || source.stride != mStrides[stream])
+		return nullptr;
+	return &source;
+}
+
+VkFormat VertexLayout::vkFormat(VertexFormat format)
+{
+	switch (format)
+	{
+	case VertexFormat::Float2:
+		return VK_FORMAT_R32G32_SFLOAT;
+	case VertexFormat::Float3:
+		return VK_FORMAT_R32G32B32_SFLOAT;
+	case VertexFormat::Half4:
+		return VK_FORMAT_R16G16B16A16_SFLOAT;
+	case VertexFormat::Octahedral16:
+		return VK_FORMAT_R16G16_SNORM;
+	case VertexFormat::Unorm16x2:
+		return VK_FORMAT_R16G16_UNORM;
+	}
+	return VK_FORMAT_UNDEFINED;
+}
+
+uint32_t VertexLayout::formatSize(VertexFormat format)
+{
+	switch (format)
+	{
+	case VertexFormat::Float2:
+	case VertexFormat::Half4:
+		return 8;
+	case VertexFormat::Float3:
+		return 12;
+	case VertexFormat::Octahedral16:
+	case VertexFormat::Unorm16x2:
+		return 4;
+	}
+	return 0;
+}
+
+uint16_t VertexLayout::encodeHalf(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000;
+	uint32_t magnitude = bits & 0x7fffffff;
+
+	// NaN stays NaN, anything from halfway past 65504 up becomes infinity.
+	if (magnitude > 0x7f800000)
+		return static_cast<uint16_t>(sign | 0x7e00);
+	if (magnitude >= 0x477ff000)
+		return static_cast<uint16_t>(sign | 0x7c00);
+
+	// below 2^-14 the result is subnormal, a multiple of 2^-24; rint rounds to nearest even.
+	if (magnitude < 0x38800000)
+	{
+		float absolute;
+		std::memcpy(&absolute, &magnitude, sizeof(absolute));
+		return static_cast<uint16_t>(sign | static_cast<uint32_t>(std::rint(absolute * 16777216.0f)));
+	}
+
+	// rebias the exponent and drop 13 mantissa bits, a carry moves into the exponent.
+	uint32_t half = (magnitude >> 13) - ((127 - 15) << 10);
+	uint32_t remainder = magnitude & 0x1fff;
+	if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+	{
+		++half;
+	}
+	return static_cast<uint16_t>(sign | half);
+}
+
+float VertexLayout::decodeHalf(uint16_t value)
+{
+	int exponent = (value >> 10) & 0x1f;
+	int mantissa = value & 0x3ff;
+	float magnitude;
+	if (exponent == 0)
+	{
+		magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+	}
+	else if (exponent == 31)
+	{
+		magnitude = mantissa != 0 ? NAN : INFINITY;
+	}
+	else
+	{
+		magnitude = std::ldexp(static_cast<float>(mantissa + 1024), exponent - 25);
+	}
+	return (value & 0x8000) ? -magnitude : magnitude;
+}
+
+void VertexLayout::encodeOctahedral(const float normal[3], int16_t encoded[2])
+{
+	// unit vector folded onto the octahedron and unfolded into a square, 4 bytes per normal.
+	float length = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+	float x = length > 0.0f ? normal[0] / length : 0.0f;
+	float y = length > 0.0f ? normal[1] / length : 0.0f;
+	if (length > 0.0f && normal[2] < 0.0f)
+	{
+		float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+	encoded[0] = static_cast<int16_t>(std::lround(std::clamp(x, -1.0f, 1.0f) * 32767.0f));
+	encoded[1] = static_cast<int16_t>(std::lround(std::clamp(y, -1.0f, 1.0f) * 32767.0f));
+}
+
+void VertexLayout::decodeOctahedral(const int16_t encoded[2], float normal[3])
+{
+	// the same as decodeOctahedral() in shader.vert, after the SNORM conversion.
+	float x = std::max(encoded[0] / 32767.0f, -1.0f);
+	float y = std::max(encoded[1] / 32767.0f, -1.0f);
+	float z = 1.0f - std::fabs(x) - std::fabs(y);
+	if (z < 0.0f)
+	{
+		float unfoldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float unfoldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = unfoldedX;
+		y = unfoldedY;
+	}
+	float length = std::sqrt(x * x + y * y + z * z);
+	normal[0] = x / length;
+	normal[1] = y / length;
+	normal[2] = z / length;
+}
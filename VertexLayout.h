@@ -0,0 +1,110 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "MeshFile.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// vertex attributes of shader.vert, each at a fixed shader location, see VertexLayout::location().
+enum class VertexSemantic : uint32_t
+{
+	Position,
+	Normal,
+	Uv,
+	Count
+};
+
+enum class VertexFormat : uint32_t
+{
+	Float2,		  // R32G32_SFLOAT, 8 bytes.
+	Float3,		  // R32G32B32_SFLOAT, 12 bytes.
+	Half4,		  // R16G16B16A16_SFLOAT, 8 bytes, w is padding: 3-component 16-bit formats are rarely fetchable.
+	Octahedral16, // unit vector folded onto the octahedron, R16G16_SNORM, 4 bytes.
+	Unorm16x2,	  // R16G16_UNORM over the bounds of the encoded mesh, 4 bytes.
+};
+
+struct VertexElement
+{
+	VertexSemantic semantic;
+	VertexFormat format;
+	uint32_t stream = 0; // elements of a stream are interleaved in declaration order.
+};
+
+// the presets the pipeline variants are built for.
+enum class VertexLayoutPreset : uint8_t
+{
+	Float,		   // float3 position, float3 normal, float2 uv interleaved, 32 bytes.
+	Quantized,	   // half4 position, octahedral normal, unorm16 uv interleaved, 16 bytes.
+	SplitPosition, // quantized with the position in a stream of its own for depth-only passes.
+	Packed,		   // float3 position, octahedral normal, unorm16 uv in a stream each: a MeshFile's streams.
+	Count
+};
+
+// a mesh encoded for one layout, one buffer per stream.
+struct EncodedVertices
+{
+	std::vector<std::vector<uint8_t>> streams;
+	uint32_t vertexCount = 0;
+	float uvOffset[2] = {0.0f, 0.0f}; // uv = stored * uvScale + uvOffset.
+	float uvScale[2] = {1.0f, 1.0f};
+};
+
+// Declarative vertex format: every stream becomes one vertex binding, every element an attribute
+// at the shader location of its semantic. A layout without an element leaves that input to the
+// caller. Half positions are meant for meshes normalized to [-1, 1], where they stay within 2^-12.
+class VertexLayout
+{
+public:
+	// throws if an element's format does not fit its semantic, a semantic repeats or a stream is empty.
+	VertexLayout(std::string name, std::vector<VertexElement> elements);
+
+	static const VertexLayout &preset(VertexLayoutPreset preset);
+	// the preset with this name, Count if there is none.
+	static VertexLayoutPreset findPreset(const std::string &name);
+	static uint32_t location(VertexSemantic semantic);
+
+	const std::string &name() const { return mName; }
+	uint32_t streamCount() const { return static_cast<uint32_t>(mStrides.size()); }
+	uint32_t stride(uint32_t stream) const { return mStrides[stream]; }
+	uint32_t vertexBytes() const;
+	bool has(VertexSemantic semantic) const;
+	VertexFormat format(VertexSemantic semantic) const;
+	uint32_t positionStream() const;
+	// bytes a depth-only pass fetches per vertex, the whole vertex unless the position is split off.
+	uint32_t positionBytes() const;
+
+	// appends one binding per stream starting at firstBinding and the attributes. positionOnly
+	// describes just the position's stream, for passes that bind nothing else.
+	void describe(uint32_t firstBinding, bool positionOnly, std::vector<VkVertexInputBindingDescription> &bindings,
+				  std::vector<VkVertexInputAttributeDescription> &attributes) const;
+
+	// quantizes the mesh into the layout's streams. Missing normals are written as +z, missing
+	// uvs as zero.
+	EncodedVertices encode(const MeshData &mesh) const;
+	// the file stream that can be uploaded unchanged as this layout's stream, null if the stream
+	// interleaves several elements or the file stores its element in another format.
+	const MeshFile::Stream *fileStream(const MeshFile &file, uint32_t stream) const;
+
+	static VkFormat vkFormat(VertexFormat format);
+	static uint32_t formatSize(VertexFormat format);
+
+	// round to nearest even, out of range values become infinity.
+	static uint16_t encodeHalf(float value);
+	static float decodeHalf(uint16_t value);
+	static void encodeOctahedral(const float normal[3], int16_t encoded[2]);
+	static void decodeOctahedral(const int16_t encoded[2], float normal[3]);
+
+private:
+	struct Attribute
+	{
+		VertexElement element;
+		uint32_t offset;
+	};
+
+	std::string mName;
+	std::vector<Attribute> mAttributes;
+	std::vector<uint32_t> mStrides;
+};
@@ -0,0 +1,44 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// depth/shadow-style pass: only the position stream is bound, see VertexLayout::describe().
+layout(location = 0) in vec3 inPosition;
+// per instance: xyz center, w radius, written by the culling pass.
+layout(location = 2) in vec4 inInstance;
+
+layout(std430, set = 0, binding = 1) readonly buffer Matrices { mat4 matrices[]; } buffers[];
+layout(std430, set = 0, binding = 1) readonly buffer Objects { vec4 spheres[]; } objectBuffers[];
+layout(std430, set = 0, binding = 1) readonly buffer Instances { uint objects[]; } instanceBuffers[];
+
+// the same block as shader.vert.
+layout(push_constant) uniform Push {
+  uint frameData;
+  uint camera;
+  uint objectBuffer;
+  uint texture;
+  uint samplerIndex;
+  uint transforms;
+  vec2 uvOffset;
+  vec2 uvScale;
+  uint instances;
+  float positionScale;
+  float positionOffset[3];
+} pc;
+
+void main() {
+  uint object = gl_InstanceIndex;
+  vec4 sphere = inInstance;
+  if (pc.instances != 0xffffffffu) {
+    object = instanceBuffers[pc.frameData].objects[pc.instances + gl_InstanceIndex];
+    sphere = objectBuffers[pc.objectBuffer].spheres[object];
+  }
+
+  vec3 position = inPosition * pc.positionScale + vec3(pc.positionOffset[0], pc.positionOffset[1], pc.positionOffset[2]);
+  vec3 worldPosition;
+  if (pc.transforms != 0xffffffffu) {
+    worldPosition = (buffers[pc.frameData].matrices[pc.transforms + object] * vec4(position, 1.0)).xyz;
+  } else {
+    worldPosition = sphere.xyz + position * sphere.w * 2.0;
+  }
+  gl_Position = buffers[pc.frameData].matrices[pc.camera] * vec4(worldPosition, 1.0);
+}
@@ -15,6 +15,28 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/vec4.hpp>
 #include <glm/mat4x4.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "AsyncCompute.h"
+#include "DeletionQueue.h"
+#include "DescriptorHeap.h"
+#include "DrawQueue.h"
+#include "FrameArena.h"
+#include "FramePacer.h"
+#include "GpuCuller.h"
+#include "GpuProfiler.h"
+#include "InstanceStore.h"
+#include "MeshFile.h"
+#include "MemoryAllocator.h"
+#include "ParallelRecorder.h"
+#include "PipelineCompiler.h"
+#include "RenderGraph.h"
+#include "ShaderReloader.h"
+#include "ShaderStore.h"
+#include "StagingUploader.h"
+#include "TextureStreamer.h"
+#include "VertexLayout.h"
 
 #include <iostream>
 #include <fstream> // loading a file
@@ -27,17 +49,293 @@
 #include <stdexcept>
 #include <cstdlib>
 #include <optional>
+#include <cassert>
+#include <cstring>
+#include <chrono>
+#include <functional>
+#include <cstdio> // std::rename, std::remove
+#include <memory>
+#include <mutex>
+#include <map>
+#include <thread>
+#include <random>
+#include <array>
+#include <cstddef> // offsetof
+#include <cmath>
 
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
 
+// default depth of the frames-in-flight ring, can be changed with --frames.
+const uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+
+// runtime options, filled from the command line in main().
+struct AppConfig
+{
+	uint32_t framesInFlight = MAX_FRAMES_IN_FLIGHT;
+	uint64_t maxFrames = 0; // 0 means run until the window is closed.
+
+	// headless mode renders into offscreen images, no window, surface or swapchain.
+	bool headless = false;
+	uint32_t width = WIDTH;
+	uint32_t height = HEIGHT;
+	bool enableValidation = true;
+
+	// copy every rendered frame back to host memory (headless only).
+	bool readback = false;
+
+	// compiled pipelines are persisted here between runs, empty disables the cache.
+	std::string pipelineCachePath = "pipeline_cache.bin";
+
+	// worker threads compiling pipeline variants in the background.
+	uint32_t compileThreads = std::max(2u, std::thread::hardware_concurrency()) - 1;
+	bool prewarmVariants = false;
+
+	// core 1.3 vkCmdBeginRendering instead of VkRenderPass/VkFramebuffer objects.
+	bool dynamicRendering = false;
+	// rebuild the attachment objects this many times at startup and report the cost.
+	uint32_t benchAttachmentRebuilds = 0;
+
+	// random allocate/free operations run against the memory allocator at startup.
+	uint32_t benchAllocatorOperations = 0;
+	// megabytes pushed through the staging uploader at startup to measure bandwidth.
+	uint32_t benchUploadMegabytes = 0;
+	// per-frame constants budget of each frame in flight.
+	uint32_t frameArenaKilobytes = 4096;
+	// object transforms written through the frame arena per frame at startup to measure its cost.
+	uint32_t benchArenaTransforms = 0;
+
+	// objects in the scene, culled on the GPU and drawn indirectly.
+	uint32_t objectCount = 1;
+	// render a fixed number of frames at 1k to 1M objects instead of the normal loop.
+	bool benchCulling = false;
+	// cull on the compute queue, overlapping the graphics work of the previous frame.
+	bool asyncCompute = false;
+	// render a fixed number of frames culling on the graphics queue, then on the compute queue.
+	bool benchAsyncCompute = false;
+
+	// one vkCmdDrawIndexed per object recorded on the CPU instead of the culled indirect draw.
+	bool cpuDraws = false;
+	// merge CPU draws sharing pipeline, mesh and material into instanced draws, see DrawQueue.
+	bool batchInstances = true;
+	// render a fixed number of frames of 100k CPU draws without and with batching.
+	bool benchBatching = false;
+	// sort CPU draws by pass, pipeline, material and depth before recording them.
+	bool sortDraws = true;
+	// workers sorting the CPU draws, 0 sorts on the render thread.
+	uint32_t sortThreads = 2;
+	// objects use this many pipeline variants in turn, 1 to 3, differing in cull mode.
+	uint32_t drawPipelines = 1;
+	// render a fixed number of frames of 100k unbatched CPU draws over 3 pipelines, unsorted and sorted.
+	bool benchDrawSort = false;
+	// per-frame model matrices and frustum culling on the CPU through the SIMD instance store,
+	// matrices are written to the frame arena. Implies cpuDraws.
+	bool cpuTransforms = false;
+	// compare the instance store kernels with per-object glm at 10k to 1M instances and exit.
+	bool benchTransforms = false;
+	// compare loading this OBJ file as text with loading it converted to a packed mesh and exit.
+	std::string benchMeshLoad;
+	// packed mesh (see mesh_convert) drawn for every object instead of the quad.
+	std::string meshPath;
+	// vertex format of the drawn mesh: float, quantized, split or packed, see VertexLayoutPreset.
+	// Defaults to packed with --mesh, whose streams are then uploaded as they are.
+	VertexLayoutPreset vertexLayout = VertexLayoutPreset::Quantized;
+	// render a fixed number of frames with every vertex layout and a position-only pass, drawing
+	// the mesh or, without one, a 64k triangle sphere per object.
+	bool benchVertexLayouts = false;
+	// workers recording secondary command buffers, 0 records inline into the primary.
+	uint32_t recordThreads = 0;
+	// render a fixed number of frames with 1, 2, 4 and 8 recording threads.
+	bool benchRecording = false;
+
+	// BCn KTX2 textures streamed by mip level, objects use them in turn.
+	std::vector<std::string> texturePaths;
+	// image memory the streamed textures may keep resident.
+	uint32_t textureBudgetMegabytes = 256;
+	// worker threads reading mip levels out of the texture files.
+	uint32_t textureThreads = 2;
+
+	// GPU timestamp/pipeline-statistics scopes per pass and CPU timings per frame phase.
+	bool profile = false;
+	// Chrome trace of the profiled scopes written at exit, empty writes none.
+	std::string traceFile;
+
+	// preferred present mode, FIFO when the surface does not support it. Keys 1-4 switch at runtime.
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+	// frame rate limiter, 0 runs unlimited.
+	double targetFps = 0.0;
+
+	// rebuild the graphics pipeline whenever shader.vert/shader.frag change on disk.
+	bool hotReload = false;
+
+	// packed SPIR-V archive, shaders missing from it or older than their loose .spv file are
+	// loaded from that file.
+	std::string shaderArchive = "shaders.spva";
+	// pack these .spv files into shaderArchive and exit instead of running.
+	std::vector<std::string> packShaderFiles;
+};
+
+const char *presentModeName(VkPresentModeKHR presentMode)
+{
+	switch (presentMode)
+	{
+	case VK_PRESENT_MODE_IMMEDIATE_KHR:
+		return "immediate";
+	case VK_PRESENT_MODE_MAILBOX_KHR:
+		return "mailbox";
+	case VK_PRESENT_MODE_FIFO_KHR:
+		return "fifo";
+	case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+		return "fifo-relaxed";
+	default:
+		return "unknown";
+	}
+}
+
+// camera matrices written to the frame arena once per frame.
+struct FrameConstants
+{
+	glm::mat4 viewProj;
+	glm::mat4 view;
+	glm::mat4 proj;
+	glm::mat4 viewInverse; // camera to world, also pads the block to a power of two size.
+};
+
+// push constant block of shader.vert/shader.frag, resources are slots in the descriptor heap.
+struct DrawPushConstants
+{
+	uint32_t frameData;	   // storage buffer slot of the current frame's arena.
+	uint32_t camera;	   // FrameConstants position in the arena, in mat4 elements.
+	uint32_t objectBuffer; // storage buffer slot of the object spheres.
+	uint32_t texture;	   // sampled image slot, DescriptorHeap::kInvalidSlot for untextured draws.
+	uint32_t sampler;
+	uint32_t transforms; // first model matrix in the arena, kInvalidSlot draws the object spheres.
+	float uvOffset[2];	 // uv = stored uv * uvScale + uvOffset, see EncodedVertices.
+	float uvScale[2];
+	uint32_t instances; // first object index of the batched draws in the arena, kInvalidSlot draws one object each.
+	float positionScale; // position = stored position * positionScale + positionOffset.
+	float positionOffset[3];
+};
+
+// drawn for every object unless --mesh is given: a unit quad facing +z, uv (0, 0) at (-0.5, -0.5).
+const MeshData quadMesh = {
+	{-0.5f, -0.5f, 0.0f, 0.5f, -0.5f, 0.0f, 0.5f, 0.5f, 0.0f, -0.5f, 0.5f, 0.0f},
+	{0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f},
+	{0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f},
+	{0, 1, 2, 2, 3, 0}};
+
+// radius 0.5 around the origin, rings from +y to -y, uv spanning [0, 1].
+MeshData createSphereMesh(uint32_t rings, uint32_t segments)
+{
+	MeshData mesh;
+	for (uint32_t ring = 0; ring <= rings; ++ring)
+	{
+		float polar = glm::radians(180.0f) * ring / rings;
+		for (uint32_t segment = 0; segment <= segments; ++segment)
+		{
+			float azimuth = glm::radians(360.0f) * segment / segments;
+			float normal[3] = {std::sin(polar) * std::cos(azimuth), std::cos(polar), std::sin(polar) * std::sin(azimuth)};
+			for (float component : normal)
+			{
+				mesh.positions.push_back(component * 0.5f);
+				mesh.normals.push_back(component);
+			}
+			mesh.uvs.push_back(static_cast<float>(segment) / segments);
+			mesh.uvs.push_back(static_cast<float>(ring) / rings);
+		}
+	}
+
+	for (uint32_t ring = 0; ring < rings; ++ring)
+	{
+		for (uint32_t segment = 0; segment < segments; ++segment)
+		{
+			uint32_t a = ring * (segments + 1) + segment;
+			uint32_t b = a + segments + 1;
+			mesh.indices.insert(mesh.indices.end(), {a, a + 1, b, b, a + 1, b + 1});
+		}
+	}
+	return mesh;
+}
+
+// resources owned by one slot of the frames-in-flight ring.
+struct FrameData
+{
+	VkCommandPool commandPool = VK_NULL_HANDLE; // reset as a whole once the slot's fence signaled.
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	VkSemaphore imageAvailableSemaphore = VK_NULL_HANDLE;
+	VkFence inFlightFence = VK_NULL_HANDLE;
+};
+
+// a program replaced by a shader reload, destroyed once its last frame completed and its
+// compiler finished the job it was running.
+struct RetiredProgram
+{
+	std::unique_ptr<PipelineCompiler> compiler; // owns the old default pipeline and its variants.
+	VkShaderModule vertexModule = VK_NULL_HANDLE;
+	VkShaderModule fragmentModule = VK_NULL_HANDLE;
+	uint64_t lastUseFrame = 0;
+};
+
+// host-visible, persistently mapped buffer receiving one frame of pixels.
+struct ReadbackBuffer
+{
+	VkBuffer buffer = VK_NULL_HANDLE;
+	Allocation allocation; // persistently mapped by the allocator.
+	bool pending = false;	  // copy submitted but not yet handed to the consumer.
+	uint64_t frameNumber = 0; // frame whose pixels the copy holds.
+};
+
+// completed readback handed to the consumer, data is only valid during the callback.
+struct ReadbackFrame
+{
+	const void *data;
+	VkDeviceSize size;
+	uint32_t width;
+	uint32_t height;
+	VkFormat format;
+	uint64_t frameNumber;
+};
+
+struct ReadbackStats
+{
+	uint64_t frameCount = 0;
+	uint64_t byteCount = 0;
+	uint64_t latencyFrames = 0; // summed over all delivered frames.
+	std::chrono::steady_clock::time_point firstSubmit;
+	std::chrono::steady_clock::time_point lastDelivery;
+};
+
+// accumulated timings, used to compare CPU time against frame time.
+struct FrameStats
+{
+	uint64_t frameCount = 0;
+	double cpuTimeMs = 0.0;	  // time spent recording/submitting/presenting.
+	double waitTimeMs = 0.0;  // time blocked on fences.
+	double frameTimeMs = 0.0; // time between two consecutive frame starts.
+	double recordTimeMs = 0.0; // part of the cpu time spent recording the command buffer.
+	std::chrono::steady_clock::time_point lastFrameStart;
+
+	// swapchain recreation stalls, measured on the render thread.
+	uint32_t recreateCount = 0;
+	double recreateTotalMs = 0.0;
+	double recreateMaxMs = 0.0;
+
+	// frame times are taken between frame starts, one fewer than there are frames.
+	double averageFrameMs() const { return frameCount > 1 ? frameTimeMs / static_cast<double>(frameCount - 1) : 0.0; }
+};
+
 struct QueueFamilyIndices
 {
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> presentFamily;
-	bool isComplete()
+	// transfer-only family (no graphics/compute) backed by a DMA engine, if the device has one.
+	std::optional<uint32_t> transferFamily;
+	// compute family without graphics, or a second queue of the graphics family.
+	std::optional<uint32_t> computeFamily;
+	uint32_t computeQueueIndex = 0;
+	bool isComplete(bool requirePresent = true)
 	{
-		return graphicsFamily.has_value() && presentFamily.has_value();
+		return graphicsFamily.has_value() && (presentFamily.has_value() || !requirePresent);
 	}
 };
 
@@ -51,9 +349,27 @@ struct SwapChainSupportDetails
 class ApplicationFw
 {
 public:
+	explicit ApplicationFw(const AppConfig &config) : mConfig(config), mPacer(config.targetFps)
+	{
+		enableValidationLayer = config.enableValidation;
+		if (!config.headless)
+		{
+			deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+		}
+	}
+
+	// called for every frame copied back to the host, once its fence signaled.
+	void setReadbackConsumer(std::function<void(const ReadbackFrame &)> consumer)
+	{
+		mReadbackConsumer = std::move(consumer);
+	}
+
 	void run()
 	{
-		initWindow();
+		if (!mConfig.headless)
+		{
+			initWindow();
+		}
 		initVulkan();
 		mainLoop();
 		cleanup();
@@ -87,12 +403,64 @@ private:
 	VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR> &availableFormats);
 	VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR> &availablePresentModes);
 	VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities);
-	void createSwapChain();
+	void createSwapChain(VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE);
 	void createImageViews();
+	void recreateSwapChain();
+	static void framebufferResizeCallback(GLFWwindow *window, int width, int height);
+	static void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods);
+
+	// headless rendering
+	void createOffscreenImages();
+
+	// device memory
+	void benchmarkAllocator();
+	void reportMemoryStats();
+	GpuBuffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+	void destroyBuffer(GpuBuffer &buffer);
+
+	// geometry uploads
+	void createUploader();
+	void loadMesh();
+	void createGeometryBuffers();
+	void createMeshFileBuffers(const std::vector<const MeshFile::Stream *> &fileStreams);
+	void destroyGeometryBuffers();
+	void runVertexLayoutBenchmark();
+	void benchmarkUpload();
+	void createFrameArena();
+	void benchmarkFrameArena();
+
+	// GPU-driven scene
+	void createScene(uint32_t objectCount);
+	double runBenchmarkFrames(uint32_t frameCount);
+	void updateViewProjection();
+	void updateInstances();
+	void runCullingBenchmark();
+
+	// culling on the compute queue
+	void createAsyncCompute();
+	uint64_t submitAsyncCull();
+	void runAsyncComputeBenchmark();
+
+	// streamed textures
+	void createTextureStreamer();
+	void updateTextureFeedback();
 
 	// graphics pipeline
+	void createPipelineCache();
+	void savePipelineCache();
+	bool isPipelineCacheCompatible(const std::vector<char> &data);
 	void createGraphicsPipeline();
-	VkShaderModule createShaderModule(const std::vector<char> &code);
+	VkPipeline buildGraphicsPipeline(const PipelineVariant &variant, VkShaderModule vertexModule, VkShaderModule fragmentModule);
+	void createPipelineCompiler();
+	void createShaderReloader();
+	void applyShaderReload();
+	void releaseRetiredPrograms(uint64_t completedFrame);
+	VkRenderPass getRenderPassForSamples(VkSampleCountFlagBits samples);
+	VkPipeline getPipeline(const PipelineVariant &variant);
+	void prewarmPipelineVariants();
+	VkShaderModule createShaderModule(const std::vector<uint32_t> &code);
+	void createShaderStore();
+	void createDescriptorHeap();
 	void createRenderPass();
 
 	// Drawing.
@@ -100,27 +468,31 @@ private:
 	void createCommandPool();
 	void createCommandBuffer();
 	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	void recordRenderPassContents(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	void recordDrawCommands(VkCommandBuffer commandBuffer, uint32_t first, uint32_t count);
+	uint32_t drawListSize();
+	void buildDrawPackets();
+	PipelineVariant drawPacketVariant(uint32_t pipeline) const;
+	void runRecordingBenchmark();
+	void runBatchingBenchmark();
+	void runDrawSortBenchmark();
+	void recordMainPass(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	// reset and cull of this slot's indirect draw buffers, profiled only on the graphics queue.
+	uint32_t addCullPasses(RenderGraph &graph, uint32_t drawCommands, uint32_t drawInstances, uint32_t drawCount, bool profiled);
+	void benchmarkAttachmentRebuild();
 
 	// Rendering and presentation
 	void drawFrame();
 	void createSyncObjects();
+	void createRenderFinishedSemaphores();
+	void reportFrameStats();
+	void createProfiler();
 
-	static std::vector<char> readFile(const std::string &fileName)
-	{
-		std::ifstream file(fileName, std::ios::ate | std::ios::binary);
-		if (!file.is_open())
-		{
-			assert("Failed to open file.");
-		}
-
-		size_t fileSize = (size_t)file.tellg();
-		std::vector<char> buffer(fileSize);
-		file.seekg(0);
-		file.read(buffer.data(), fileSize);
-		file.close();
-
-		return buffer;
-	}
+	// readback of rendered frames
+	void createReadbackBuffers();
+	void recordReadback(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	void collectReadbacks();
+	void reportReadbackStats();
 
 	static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT *pCallbackData, void *pUserData)
 	{
@@ -130,43 +502,166 @@ private:
 	}
 
 private:
-	GLFWwindow *window;
+	AppConfig mConfig;
+	GLFWwindow *window = nullptr;
 	VkInstance mInstance;							   // The vulkan API.
 	VkPhysicalDevice mPhysicalDevice = VK_NULL_HANDLE; // Actual graphics card, that will be used.
 	VkDevice mDevice = VK_NULL_HANDLE;
 	// The Logical device, interface with selected physical device.
 	VkQueue mGraphicsQueue;
 	VkQueue mPresentQueue;
+	VkQueue mTransferQueue; // mGraphicsQueue when there is no transfer-only family.
+	VkQueue mComputeQueue = VK_NULL_HANDLE; // null when the device has neither a compute family nor a second graphics queue.
 
-	VkSurfaceKHR mSurface;
-	VkSwapchainKHR mSwapChain;
+	// every buffer and image allocation goes through here instead of vkAllocateMemory.
+	std::unique_ptr<MemoryAllocator> mAllocator;
+
+	VkSurfaceKHR mSurface = VK_NULL_HANDLE;
+	VkSwapchainKHR mSwapChain = VK_NULL_HANDLE;
+	// in headless mode these are the offscreen render targets instead of swapchain images.
 	std::vector<VkImage> mSwapChainImages;
+	std::vector<Allocation> mOffscreenImageMemory;
 	std::vector<VkImageView> mSwapChainImageViews;
 	VkFormat mSwapChainImageFormat;
 	VkExtent2D mSwapChainExtent;
-	VkRenderPass mRenderPass;
+	VkRenderPass mRenderPass = VK_NULL_HANDLE;
 	VkPipelineLayout mPipelineLayout;
 	VkPipeline mGraphicsPipeline;
+	VkPipelineCache mPipelineCache = VK_NULL_HANDLE;
+	bool mPipelineCacheWarm = false; // cache was seeded from disk.
+
+	// pipeline variants, compiled in the background; mGraphicsPipeline is the fallback.
+	std::unique_ptr<PipelineCompiler> mPipelineCompiler;
+	VkShaderModule mVertexShaderModule = VK_NULL_HANDLE;
+	VkShaderModule mFragmentShaderModule = VK_NULL_HANDLE;
+	VkShaderModule mDepthShaderModule = VK_NULL_HANDLE; // position-only variants, not reloaded.
+	// variant of the draws, its vertex layout is the one of the geometry buffers. mGraphicsPipeline
+	// is built for mDefaultVariant, the startup value, and so is every reloaded pipeline; the
+	// layout benchmark waits for each variant it switches to.
+	PipelineVariant mDrawVariant;
+	PipelineVariant mDefaultVariant;
+	std::mutex mVariantRenderPassMutex;
+	std::map<VkSampleCountFlagBits, VkRenderPass> mVariantRenderPasses;
+	bool mFillModeNonSolidSupported = false;
+	bool mSynchronization2Supported = false;
+	bool mTimelineSemaphoreSupported = false;
+	bool mPipelineStatisticsSupported = false;
 	std::vector<VkFramebuffer> mSwapChainFramebuffers;
 
 	VkCommandPool mCommandPool;
-	VkCommandBuffer mCommandBuffer;
 
-	// synchronization.
-	VkSemaphore mImageAvailableSemaphore;
-	VkSemaphore mRenderFinishedSemaphore;
-	VkFence mInFlightFence;
+	// frames-in-flight ring, each slot owns its command buffer and synchronization.
+	std::vector<FrameData> mFrames;
+	uint32_t mCurrentFrame = 0;
+	// fence of the frame currently using each swapchain image, VK_NULL_HANDLE if unused.
+	std::vector<VkFence> mImagesInFlight;
+	// signaled by the submit rendering each swapchain image and waited on by its present. Indexed
+	// by image, not by slot: an image is only acquired again once its previous present is done
+	// with the semaphore, a slot can come around while that present still waits.
+	std::vector<VkSemaphore> mRenderFinishedSemaphores;
+	uint64_t mFrameNumber = 0;
+	FrameStats mFrameStats;
+
+	// staged uploads and the geometry they fill.
+	std::unique_ptr<StagingUploader> mUploader;
+	std::vector<VkSemaphore> mUploadWaitSemaphores; // collected while recording, waited on by the frame submit.
+	std::vector<VkPipelineStageFlags> mUploadWaitStages;
+	MeshFile mMeshFile; // --mesh, mapped for as long as layouts may upload its streams.
+	MeshData mMesh;		// host copy, normalized to the object sphere and encoded per layout.
+	std::vector<GpuBuffer> mVertexStreams; // one per stream of the draw variant's layout.
+	GpuBuffer mIndexBuffer;
+	uint32_t mVertexCount = 0;
+	uint32_t mIndexCount = 0;
+	VkIndexType mIndexType = VK_INDEX_TYPE_UINT16;
+	float mUvOffset[2] = {0.0f, 0.0f};
+	float mUvScale[2] = {1.0f, 1.0f};
+	float mPositionScale = 1.0f;
+	float mPositionOffset[3] = {0.0f, 0.0f, 0.0f};
+	uint64_t mGeometryBatch = 0;
+
+	// object bounds culled by a compute pass, visible objects are drawn indirectly.
+	std::unique_ptr<GpuCuller> mCuller;
+	uint64_t mSceneBatch = 0;
+	uint64_t mSceneAcquiredFrame = UINT64_MAX; // frame whose submit acquired the scene batch.
+
+	// the same objects as model transforms, only filled with --cpu-transforms.
+	InstanceStore mInstances;
+	std::vector<uint32_t> mVisibleObjects; // drawn by the CPU draw list, in object order.
+	uint32_t mTransformElement = DescriptorHeap::kInvalidSlot;
+	// this frame's CPU draws, sorted and, when batching, merged with their object indices in the arena.
+	std::unique_ptr<DrawQueue> mDrawQueue;
+	uint32_t mInstanceElement = DescriptorHeap::kInvalidSlot;
+	// pipeline, mesh and material binds of the CPU draws, summed over every command buffer.
+	std::mutex mBindStatsMutex;
+	DrawBindStats mBindStats;
+
+	// secondary command buffer recording on worker threads, null when recording inline.
+	std::unique_ptr<ParallelRecorder> mRecorder;
+
+	// null unless profiling was requested and the graphics queue supports timestamps.
+	std::unique_ptr<GpuProfiler> mProfiler;
+	float mSceneExtent = 0.0f;
+	glm::mat4 mViewProj = glm::mat4(1.0f);
+
+	// bindless sampled images, storage buffers and samplers, bound once per command buffer.
+	std::unique_ptr<DescriptorHeap> mDescriptorHeap;
+	VkSampler mDefaultSampler = VK_NULL_HANDLE;
+	uint32_t mDefaultSamplerSlot = DescriptorHeap::kInvalidSlot;
+	uint32_t mObjectBufferSlot = DescriptorHeap::kInvalidSlot;
+
+	// per-frame constants, reset whenever the frame's fence signaled.
+	std::unique_ptr<FrameArena> mFrameArena;
+	std::vector<uint32_t> mFrameArenaSlots; // storage buffer slot per frame in flight.
+	uint32_t mCameraElement = 0;
+
+	// every SPIR-V module comes from here, shared by content hash.
+	std::unique_ptr<ShaderStore> mShaderStore;
+
+	// rebuilds the default pipeline in the background, null unless hot reload is enabled.
+	std::unique_ptr<ShaderReloader> mShaderReloader;
+	std::vector<RetiredProgram> mRetiredPrograms;
+
+	// passes of the frame, rebuilt every recording; derives the barriers between them.
+	std::unique_ptr<RenderGraph> mRenderGraph;
+
+	// null unless async compute was requested and the device has a compute queue. Graphics
+	// submits signal mGraphicsTimeline with their frame number + 1.
+	std::unique_ptr<AsyncCompute> mAsyncCompute;
+	std::unique_ptr<RenderGraph> mComputeGraph;
+	VkSemaphore mGraphicsTimeline = VK_NULL_HANDLE;
+	bool mAsyncCull = false;		// cull on the compute queue, switched by the benchmark.
+	uint64_t mAsyncCullValue = 0; // compute timeline value this frame's draw waits on, 0 when culled inline.
+
+	// null unless textures were given. Object i uses texture i % count with CPU draws, the
+	// indirect draws all use the first one.
+	std::unique_ptr<TextureStreamer> mTextureStreamer;
+	std::vector<glm::vec4> mSceneSpheres; // object bounds for the texture feedback and draw depths.
+	uint32_t mFeedbackCursor = 0;		  // first object of the next feedback window.
+
+	// frame pacing histograms and the optional frame rate limiter.
+	FramePacer mPacer;
+	VkPresentModeKHR mPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+	bool mPresentModeChanged = false;
+
+	// objects retired while frames in flight may still use them.
+	DeletionQueue mDeletionQueue;
+	bool mFramebufferResized = false;
+
+	// one staging buffer per slot of the frames-in-flight ring.
+	std::vector<ReadbackBuffer> mReadbackBuffers;
+	std::function<void(const ReadbackFrame &)> mReadbackConsumer;
+	ReadbackStats mReadbackStats;
 
 	VkDebugUtilsMessengerEXT mDebugMessenger;
 
-	const bool enableValidationLayer = true;
+	bool enableValidationLayer = true;
 
 private:
 	const std::vector<const char *> validationLayers = {
 		"VK_LAYER_KHRONOS_validation"};
 
-	const std::vector<const char *> deviceExtensions = {
-		VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+	// swapchain extension is added in the constructor unless running headless.
+	std::vector<const char *> deviceExtensions;
 };
 
 /******************************************/
@@ -184,219 +679,2191 @@ void ApplicationFw::createSyncObjects()
 		fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 	}
 
-	VkResult res = VK_SUCCESS;
-	assert(vkCreateSemaphore(mDevice, &smephoreCreateInfo, nullptr, &mImageAvailableSemaphore) == VK_SUCCESS);
-	assert(vkCreateSemaphore(mDevice, &smephoreCreateInfo, nullptr, &mRenderFinishedSemaphore) == VK_SUCCESS);
-	assert(vkCreateFence(mDevice, &fenceCreateInfo, nullptr, &mInFlightFence) == VK_SUCCESS);
+	for (auto &frame : mFrames)
+	{
+		VkResult res = vkCreateSemaphore(mDevice, &smephoreCreateInfo, nullptr, &frame.imageAvailableSemaphore);
+		assert(res == VK_SUCCESS);
+		res = vkCreateFence(mDevice, &fenceCreateInfo, nullptr, &frame.inFlightFence);
+		assert(res == VK_SUCCESS);
+	}
+
+	// no swapchain image is in use by any frame yet.
+	mImagesInFlight.assign(mSwapChainImages.size(), VK_NULL_HANDLE);
+	createRenderFinishedSemaphores();
+}
+
+void ApplicationFw::createRenderFinishedSemaphores()
+{
+	VkSemaphoreCreateInfo smephoreCreateInfo{};
+	{
+		smephoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	}
+
+	mRenderFinishedSemaphores.resize(mSwapChainImages.size());
+	for (auto &semaphore : mRenderFinishedSemaphores)
+	{
+		VkResult res = vkCreateSemaphore(mDevice, &smephoreCreateInfo, nullptr, &semaphore);
+		assert(res == VK_SUCCESS);
+	}
 }
 
 void ApplicationFw::drawFrame()
 {
+	using clock = std::chrono::steady_clock;
+	auto frameStart = clock::now();
+
 	VkResult res = VK_SUCCESS;
-	vkWaitForFences(mDevice, 1, &mInFlightFence, VK_TRUE, UINT64_MAX);
-	vkResetFences(mDevice, 1, &mInFlightFence);
+	FrameData &frame = mFrames[mCurrentFrame];
+
+	// wait until the GPU has finished the frame that last used this slot.
+	vkWaitForFences(mDevice, 1, &frame.inFlightFence, VK_TRUE, UINT64_MAX);
+	auto waitEnd = clock::now();
+
+	// this slot was last used N frames ago, so everything up to that frame is done.
+	uint64_t framesInFlight = mFrames.size();
+	if (mFrameNumber >= framesInFlight)
+	{
+		mDeletionQueue.flush(mFrameNumber - framesInFlight);
+		mDescriptorHeap->recycle(mFrameNumber - framesInFlight);
+		releaseRetiredPrograms(mFrameNumber - framesInFlight);
+		mUploader->retire(mFrameNumber - framesInFlight);
+		if (mTextureStreamer)
+		{
+			mTextureStreamer->retire(mFrameNumber - framesInFlight);
+		}
+	}
+	mFrameArena->beginFrame(mCurrentFrame);
+
+	mUploader->poll();
+
+	// a rebuilt pipeline only replaces the current one between frames.
+	if (mShaderReloader)
+	{
+		applyShaderReload();
+	}
+
+	// hand over every finished readback, including the one of this slot before it is reused.
+	if (mConfig.readback)
+	{
+		collectReadbacks();
+	}
 
 	uint32_t swapChainImageIndex;
-	res = vkAcquireNextImageKHR(mDevice, mSwapChain, UINT64_MAX, mImageAvailableSemaphore, VK_NULL_HANDLE, &swapChainImageIndex);
-	assert(res == VK_SUCCESS);
+	auto acquireStart = clock::now();
+	if (mConfig.headless)
+	{
+		// offscreen images form a ring of the same depth as the frames in flight.
+		swapChainImageIndex = mCurrentFrame % static_cast<uint32_t>(mSwapChainImages.size());
+	}
+	else
+	{
+		res = vkAcquireNextImageKHR(mDevice, mSwapChain, UINT64_MAX, frame.imageAvailableSemaphore, VK_NULL_HANDLE, &swapChainImageIndex);
+		if (res == VK_ERROR_OUT_OF_DATE_KHR)
+		{
+			// nothing was acquired and the fence is still signaled, retry with the new swapchain next frame.
+			recreateSwapChain();
+			return;
+		}
+		// a suboptimal swapchain can still be presented to, it is recreated after present.
+		assert(res == VK_SUCCESS || res == VK_SUBOPTIMAL_KHR);
+	}
+	auto acquireEnd = clock::now();
 
-	// reset the command buffer to make sure it is able to be recorded.
-	vkResetCommandBuffer(mCommandBuffer, 0);
+	// the acquired image may still be used by an older frame from another slot.
+	auto imageWaitStart = clock::now();
+	if (mImagesInFlight[swapChainImageIndex] != VK_NULL_HANDLE)
+	{
+		vkWaitForFences(mDevice, 1, &mImagesInFlight[swapChainImageIndex], VK_TRUE, UINT64_MAX);
+	}
+	mImagesInFlight[swapChainImageIndex] = frame.inFlightFence;
+	auto imageWaitEnd = clock::now();
 
-	// record the command buffer to draw.
-	recordCommandBuffer(mCommandBuffer, swapChainImageIndex);
+	vkResetFences(mDevice, 1, &frame.inFlightFence);
 
-	// submitting the command buffer
-	VkSemaphore waitSemaphore[] = {mImageAvailableSemaphore};
-	VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-	VkSemaphore signalSemaphores[] = {mRenderFinishedSemaphore};
-	VkSubmitInfo submitInfo{};
+	// the slot's pools are reset as a whole, which recycles every buffer allocated from them.
+	vkResetCommandPool(mDevice, frame.commandPool, 0);
+	if (mRecorder)
 	{
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.waitSemaphoreCount = 1;
-		submitInfo.pWaitSemaphores = waitSemaphore;
-		submitInfo.pWaitDstStageMask = waitStages;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &mCommandBuffer;
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = signalSemaphores;
+		mRecorder->beginFrame(mCurrentFrame);
 	}
 
-	// submit to the queue.
-	res = vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, mInFlightFence);
+	// record the command buffer to draw, this collects the semaphores of finished uploads.
+	mUploadWaitSemaphores.clear();
+	mUploadWaitStages.clear();
+	updateViewProjection();
+	if (mConfig.cpuTransforms)
+	{
+		updateInstances();
+	}
+	if (mTextureStreamer)
+	{
+		updateTextureFeedback();
+		mTextureStreamer->update(mFrameNumber);
+	}
+	// only once a finished graphics submit acquired the objects, the cull waits on that submit.
+	mAsyncCullValue = 0;
+	if (mAsyncCull && !mConfig.cpuDraws && mSceneAcquiredFrame < mFrameNumber)
+	{
+		mAsyncCullValue = submitAsyncCull();
+	}
+	auto recordStart = clock::now();
+	if (mConfig.cpuDraws)
+	{
+		buildDrawPackets();
+	}
+	recordCommandBuffer(frame.commandBuffer, swapChainImageIndex);
+	auto recordEnd = clock::now();
 
-	// presentation
-	VkSwapchainKHR swapchainKHR[] = {mSwapChain};
-	VkPresentInfoKHR presentInfoKHR{};
+	// submitting the command buffer
+	mFrameArena->flush();
+	std::vector<VkSemaphore> waitSemaphores = mUploadWaitSemaphores;
+	std::vector<VkPipelineStageFlags> waitStages = mUploadWaitStages;
+	VkSemaphore signalSemaphores[] = {mRenderFinishedSemaphores[swapChainImageIndex]};
+	// in headless mode there is no acquire to wait on and nothing to present.
+	if (!mConfig.headless)
 	{
-		presentInfoKHR.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-		presentInfoKHR.waitSemaphoreCount = 1;
-		presentInfoKHR.pWaitSemaphores = signalSemaphores;
-		presentInfoKHR.swapchainCount = 1;
-		presentInfoKHR.pSwapchains = swapchainKHR;
-		presentInfoKHR.pImageIndices = &swapChainImageIndex;
-		presentInfoKHR.pResults = nullptr;
+		waitSemaphores.push_back(frame.imageAvailableSemaphore);
+		waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
 	}
+	uint32_t signalSemaphoreCount = mConfig.headless ? 0 : 1;
 
-	// submit the request to present the image to the swapchain.
-	res = vkQueuePresentKHR(mPresentQueue, &presentInfoKHR);
-}
+	// timeline values, ignored for the binary semaphores.
+	std::vector<uint64_t> waitValues(waitSemaphores.size(), 0);
+	std::vector<VkSemaphore> signalSemaphoreList(signalSemaphores, signalSemaphores + signalSemaphoreCount);
+	std::vector<uint64_t> signalValues(signalSemaphoreCount, 0);
+	if (mAsyncCullValue != 0)
+	{
+		waitSemaphores.push_back(mAsyncCompute->timeline());
+		waitStages.push_back(VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+		waitValues.push_back(mAsyncCullValue);
+	}
+	if (mGraphicsTimeline != VK_NULL_HANDLE)
+	{
+		signalSemaphoreList.push_back(mGraphicsTimeline);
+		signalValues.push_back(mFrameNumber + 1);
+	}
 
-void ApplicationFw::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
-{
-	VkCommandBufferBeginInfo commandBufferBeginInfo{};
+	VkTimelineSemaphoreSubmitInfo timelineSubmitInfo{};
 	{
-		commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		commandBufferBeginInfo.flags = 0;
-		commandBufferBeginInfo.pInheritanceInfo = nullptr;
+		timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineSubmitInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+		timelineSubmitInfo.pWaitSemaphoreValues = waitValues.data();
+		timelineSubmitInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+		timelineSubmitInfo.pSignalSemaphoreValues = signalValues.data();
 	}
 
-	VkResult res = vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+	VkSubmitInfo submitInfo{};
+	{
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = mAsyncCompute ? &timelineSubmitInfo : nullptr;
+		submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+		submitInfo.pWaitSemaphores = waitSemaphores.data();
+		submitInfo.pWaitDstStageMask = waitStages.data();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &frame.commandBuffer;
+		submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphoreList.size());
+		submitInfo.pSignalSemaphores = signalSemaphoreList.data();
+	}
+
+	// submit to the queue.
+	auto submitStart = clock::now();
+	res = vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, frame.inFlightFence);
 	assert(res == VK_SUCCESS);
+	auto submitEnd = clock::now();
 
-	VkClearValue clearColor = {{{1.0f, 1.0f, 0.0f, 1.0f}}};
-	VkRenderPassBeginInfo renderPassBeginInfo{};
+	mPacer.markAcquire(acquireStart, acquireEnd);
+	mPacer.markSubmit(submitStart, submitEnd);
+	if (mConfig.headless)
 	{
-		renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassBeginInfo.renderPass = mRenderPass;
-		renderPassBeginInfo.framebuffer = mSwapChainFramebuffers[imageIndex];
-		renderPassBeginInfo.renderArea.offset = {0, 0};
-		renderPassBeginInfo.renderArea.extent = mSwapChainExtent;
-		renderPassBeginInfo.clearValueCount = 1;
-		renderPassBeginInfo.pClearValues = &clearColor;
+		// nothing is presented, the frame ends with its submit.
+		mPacer.endFrame(submitEnd);
 	}
 
-	vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mGraphicsPipeline);
-	VkViewport viewport{};
+	if (mProfiler)
 	{
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = static_cast<float>(mSwapChainExtent.width);
-		viewport.height = static_cast<float>(mSwapChainExtent.height);
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
+		mProfiler->markSubmit(mCurrentFrame, submitStart);
+		mProfiler->addCpuSample("acquire", acquireStart, acquireEnd);
+		mProfiler->addCpuSample("record", recordStart, recordEnd);
+		mProfiler->addCpuSample("submit", submitStart, submitEnd);
 	}
-	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-	VkRect2D scissor{};
+
+	bool recreate = false;
+	if (!mConfig.headless)
 	{
-		scissor.offset = {0, 0};
-		scissor.extent = mSwapChainExtent;
+		// presentation
+		VkSwapchainKHR swapchainKHR[] = {mSwapChain};
+		VkPresentInfoKHR presentInfoKHR{};
+		{
+			presentInfoKHR.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+			presentInfoKHR.waitSemaphoreCount = 1;
+			presentInfoKHR.pWaitSemaphores = signalSemaphores;
+			presentInfoKHR.swapchainCount = 1;
+			presentInfoKHR.pSwapchains = swapchainKHR;
+			presentInfoKHR.pImageIndices = &swapChainImageIndex;
+			presentInfoKHR.pResults = nullptr;
+		}
+
+		// submit the request to present the image to the swapchain.
+		auto presentStart = clock::now();
+		res = vkQueuePresentKHR(mPresentQueue, &presentInfoKHR);
+		auto presentEnd = clock::now();
+		mPacer.markPresent(presentStart, presentEnd);
+		mPacer.endFrame(presentEnd);
+		if (mProfiler)
+		{
+			mProfiler->addCpuSample("present", presentStart, presentEnd);
+		}
+		recreate = res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR || mFramebufferResized || mPresentModeChanged;
+		assert(recreate || res == VK_SUCCESS);
 	}
-	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-	vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+	// advance to the next slot of the ring.
+	mCurrentFrame = (mCurrentFrame + 1) % static_cast<uint32_t>(mFrames.size());
+	++mFrameNumber;
 
-	vkCmdEndRenderPass(commandBuffer);
+	auto frameEnd = clock::now();
+	auto toMs = [](clock::duration d)
+	{ return std::chrono::duration<double, std::milli>(d).count(); };
 
-	res = vkEndCommandBuffer(commandBuffer);
-	assert(res == VK_SUCCESS);
+	double waitMs = toMs(waitEnd - frameStart) + toMs(imageWaitEnd - imageWaitStart);
+	mFrameStats.waitTimeMs += waitMs;
+	mFrameStats.cpuTimeMs += toMs(frameEnd - frameStart) - waitMs;
+	mFrameStats.recordTimeMs += toMs(recordEnd - recordStart);
+	if (mFrameStats.frameCount > 0)
+	{
+		mFrameStats.frameTimeMs += toMs(frameStart - mFrameStats.lastFrameStart);
+	}
+	mFrameStats.lastFrameStart = frameStart;
+	++mFrameStats.frameCount;
+
+	// the frame was submitted and counted before the old swapchain gets retired, the stall is
+	// measured by recreateSwapChain() itself.
+	if (recreate)
+	{
+		mFramebufferResized = false;
+		recreateSwapChain();
+	}
 }
 
-void ApplicationFw::createCommandBuffer()
+void ApplicationFw::reportFrameStats()
 {
-	VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
+	if (mFrameStats.frameCount < 2)
+		return;
+
+	double frames = static_cast<double>(mFrameStats.frameCount);
+	double avgFrameMs = mFrameStats.averageFrameMs();
+	if (mFrameStats.recreateCount > 0)
 	{
-		commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		commandBufferAllocateInfo.commandPool = mCommandPool;
-		commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		commandBufferAllocateInfo.commandBufferCount = 1;
+		std::cout << "swapchain recreations: " << mFrameStats.recreateCount
+				  << ", avg stall ms: " << mFrameStats.recreateTotalMs / mFrameStats.recreateCount
+				  << ", max stall ms: " << mFrameStats.recreateMaxMs << std::endl;
 	}
 
-	VkResult res = vkAllocateCommandBuffers(mDevice, &commandBufferAllocateInfo, &mCommandBuffer);
-	assert(res == VK_SUCCESS);
+	std::cout << "frames in flight: " << mFrames.size()
+			  << ", frames: " << mFrameStats.frameCount
+			  << ", avg cpu ms: " << mFrameStats.cpuTimeMs / frames
+			  << ", avg record ms: " << mFrameStats.recordTimeMs / frames
+			  << ", avg fence wait ms: " << mFrameStats.waitTimeMs / frames
+			  << ", avg frame ms: " << avgFrameMs
+			  << ", fps: " << (avgFrameMs > 0.0 ? 1000.0 / avgFrameMs : 0.0) << std::endl;
 }
 
-void ApplicationFw::createCommandPool()
+void ApplicationFw::createProfiler()
 {
 	QueueFamilyIndices indices = findQueueFamilies(mPhysicalDevice);
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(mPhysicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(mPhysicalDevice, &queueFamilyCount, queueFamilies.data());
 
-	VkCommandPoolCreateInfo commandPoolCreateInfo{};
+	uint32_t timestampValidBits = queueFamilies[indices.graphicsFamily.value()].timestampValidBits;
+	if (timestampValidBits == 0)
 	{
-		commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-		commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-		commandPoolCreateInfo.queueFamilyIndex = indices.graphicsFamily.value();
+		std::cout << "profiler: graphics queue does not support timestamps, disabled." << std::endl;
+		return;
 	}
 
-	VkResult res = vkCreateCommandPool(mDevice, &commandPoolCreateInfo, nullptr, &mCommandPool);
-	assert(res == VK_SUCCESS);
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(mPhysicalDevice, &properties);
+
+	mProfiler = std::make_unique<GpuProfiler>(mDevice, properties.limits.timestampPeriod, timestampValidBits,
+											  static_cast<uint32_t>(mFrames.size()), mSynchronization2Supported, mPipelineStatisticsSupported);
+	std::cout << "profiler: timestamp period " << properties.limits.timestampPeriod << " ns, "
+			  << (mPipelineStatisticsSupported ? "with" : "without") << " pipeline statistics" << std::endl;
 }
 
-void ApplicationFw::createFramebuffers()
+void ApplicationFw::createReadbackBuffers()
 {
-	mSwapChainFramebuffers.resize(mSwapChainImageViews.size());
+	VkDeviceSize frameSize = static_cast<VkDeviceSize>(mSwapChainExtent.width) * mSwapChainExtent.height * 4;
+	mReadbackBuffers.resize(mFrames.size());
 
-	for (size_t i = 0; i < mSwapChainImageViews.size(); ++i)
+	for (auto &readback : mReadbackBuffers)
 	{
-		VkImageView attachments[] = {mSwapChainImageViews[i]};
-
-		VkFramebufferCreateInfo framebufferCreateInfo{};
+		VkBufferCreateInfo bufferCreateInfo{};
 		{
-			framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-			framebufferCreateInfo.renderPass = mRenderPass;
-			framebufferCreateInfo.attachmentCount = 1;
-			framebufferCreateInfo.pAttachments = attachments;
-			framebufferCreateInfo.width = mSwapChainExtent.width;
-			framebufferCreateInfo.height = mSwapChainExtent.height;
-			framebufferCreateInfo.layers = 1;
-
-			VkResult res = vkCreateFramebuffer(mDevice, &framebufferCreateInfo, nullptr, &mSwapChainFramebuffers[i]);
-			assert(res == VK_SUCCESS);
+			bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferCreateInfo.size = frameSize;
+			bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		}
+
+		VkResult res = vkCreateBuffer(mDevice, &bufferCreateInfo, nullptr, &readback.buffer);
+		assert(res == VK_SUCCESS);
+
+		// cached memory makes CPU reads fast, the allocator falls back to any host visible type.
+		readback.allocation = mAllocator->allocateForBuffer(readback.buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
 	}
 }
 
-VkShaderModule ApplicationFw::createShaderModule(const std::vector<char> &code)
+void ApplicationFw::recordReadback(VkCommandBuffer commandBuffer, uint32_t imageIndex)
 {
-	VkShaderModuleCreateInfo shaderModuleCreateInfo{};
+	ReadbackBuffer &readback = mReadbackBuffers[mCurrentFrame];
+	assert(!readback.pending);
+
+	// the render graph orders the copy after the main pass and makes it visible to host reads.
+	VkBufferImageCopy region{};
 	{
-		shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		shaderModuleCreateInfo.codeSize = code.size();
-		shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+		region.bufferOffset = 0;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = {0, 0, 0};
+		region.imageExtent = {mSwapChainExtent.width, mSwapChainExtent.height, 1};
 	}
-	VkShaderModule shaderModule;
-	VkResult res = vkCreateShaderModule(mDevice, &shaderModuleCreateInfo, nullptr, &shaderModule);
-	assert(res == VK_SUCCESS);
-	return shaderModule;
+	vkCmdCopyImageToBuffer(commandBuffer, mSwapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer, 1, &region);
+
+	if (mReadbackStats.firstSubmit == std::chrono::steady_clock::time_point{})
+	{
+		mReadbackStats.firstSubmit = std::chrono::steady_clock::now();
+	}
+	readback.pending = true;
+	readback.frameNumber = mFrameNumber;
 }
 
-void ApplicationFw::createRenderPass()
+void ApplicationFw::collectReadbacks()
 {
-	VkAttachmentDescription colorAttachment{};
+	// deliver in submission order, only frames whose fence already signaled, never blocking.
+	for (;;)
 	{
-		colorAttachment.format = mSwapChainImageFormat;
-		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR; // clear the framebuffer to black before drawing new frame.
-		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		size_t oldest = mReadbackBuffers.size();
+		for (size_t i = 0; i < mReadbackBuffers.size(); ++i)
+		{
+			if (mReadbackBuffers[i].pending && (oldest == mReadbackBuffers.size() || mReadbackBuffers[i].frameNumber < mReadbackBuffers[oldest].frameNumber))
+			{
+				oldest = i;
+			}
+		}
+
+		if (oldest == mReadbackBuffers.size() || vkGetFenceStatus(mDevice, mFrames[oldest].inFlightFence) != VK_SUCCESS)
+			return;
+
+		ReadbackBuffer &readback = mReadbackBuffers[oldest];
+		VkDeviceSize frameSize = static_cast<VkDeviceSize>(mSwapChainExtent.width) * mSwapChainExtent.height * 4;
+		mAllocator->invalidate(readback.allocation);
+
+		if (mReadbackConsumer)
+		{
+			ReadbackFrame readbackFrame{readback.allocation.mapped, frameSize, mSwapChainExtent.width, mSwapChainExtent.height, mSwapChainImageFormat, readback.frameNumber};
+			mReadbackConsumer(readbackFrame);
+		}
+
+		readback.pending = false;
+		++mReadbackStats.frameCount;
+		mReadbackStats.byteCount += frameSize;
+		mReadbackStats.latencyFrames += mFrameNumber - readback.frameNumber;
+		mReadbackStats.lastDelivery = std::chrono::steady_clock::now();
 	}
+}
 
-	VkAttachmentReference colocAttachmentRef{};
+void ApplicationFw::reportReadbackStats()
+{
+	if (mReadbackStats.frameCount == 0)
+		return;
+
+	double seconds = std::chrono::duration<double>(mReadbackStats.lastDelivery - mReadbackStats.firstSubmit).count();
+	double megabytes = static_cast<double>(mReadbackStats.byteCount) / (1024.0 * 1024.0);
+	std::cout << "readback frames: " << mReadbackStats.frameCount
+			  << ", MB/s: " << (seconds > 0.0 ? megabytes / seconds : 0.0)
+			  << ", avg latency frames: " << static_cast<double>(mReadbackStats.latencyFrames) / mReadbackStats.frameCount << std::endl;
+}
+
+void ApplicationFw::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	VkCommandBufferBeginInfo commandBufferBeginInfo{};
 	{
-		colocAttachmentRef.attachment = 0;
-		colocAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		commandBufferBeginInfo.flags = 0;
+		commandBufferBeginInfo.pInheritanceInfo = nullptr;
 	}
 
-	VkSubpassDescription subpass{};
+	VkResult res = vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+	assert(res == VK_SUCCESS);
+
+	// reads back the slot's previous scopes and resets its queries.
+	uint32_t frameScope = 0;
+	if (mProfiler)
 	{
-		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpass.colorAttachmentCount = 1;
-		subpass.pColorAttachments = &colocAttachmentRef;
+		mProfiler->beginFrame(commandBuffer, mCurrentFrame);
+		frameScope = mProfiler->beginScope(commandBuffer, "frame");
 	}
 
-	VkSubpassDependency dependency{};
+	// buffers finished on the transfer queue change ownership before the first draw uses them.
+	mUploader->acquire(commandBuffer, mFrameNumber, mUploadWaitSemaphores, mUploadWaitStages);
+
+	// the image was released by the presentation engine, or by the copy of an earlier frame when
+	// headless; the acquire semaphore wait and the fence order those accesses.
+	RenderGraphAccess initialAccess{};
+	initialAccess.stages = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+	RenderGraphAccess finalAccess{};
+	finalAccess.stages = mConfig.headless ? VK_PIPELINE_STAGE_2_TRANSFER_BIT : VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT;
+	finalAccess.layout = mConfig.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+	mRenderGraph->reset();
+	uint32_t colorTarget = mRenderGraph->importImage("swapchain image", mSwapChainImages[imageIndex], VK_IMAGE_ASPECT_COLOR_BIT, initialAccess, finalAccess);
+
+	// fills this slot's indirect commands, the draw inside the render pass consumes them. With CPU
+	// draws nothing reads them and the graph drops both passes. Culled on the compute queue the
+	// submit's semaphore wait makes them visible, no pass or barrier is needed here.
+	bool sceneReady = mUploader->isAcquired(mGeometryBatch) && mUploader->isAcquired(mSceneBatch);
+	if (sceneReady && mSceneAcquiredFrame == UINT64_MAX)
 	{
-		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependency.dstSubpass = 0;
+		mSceneAcquiredFrame = mFrameNumber;
+	}
+	uint32_t drawCommands = 0;
+	uint32_t drawInstances = 0;
+	uint32_t drawCount = 0;
+	if (sceneReady)
+	{
+		drawCommands = mRenderGraph->importBuffer("draw commands", mCuller->indirectBuffer(mCurrentFrame), {}, {});
+		drawInstances = mRenderGraph->importBuffer("draw instances", mCuller->instanceBuffer(mCurrentFrame), {}, {});
+		drawCount = mRenderGraph->importBuffer("draw count", mCuller->countBuffer(mCurrentFrame), {}, {});
+	}
+	if (sceneReady && mAsyncCullValue == 0)
+	{
+		addCullPasses(*mRenderGraph, drawCommands, drawInstances, drawCount, true);
+	}
+
+	// replaced texture images get their new slots before the draws push them.
+	if (mTextureStreamer)
+	{
+		uint32_t texturePass = mRenderGraph->addPass("texture streaming", [this](VkCommandBuffer cb)
+													 { mTextureStreamer->record(cb, mFrameNumber); });
+		mRenderGraph->setSideEffects(texturePass);
+	}
+
+	uint32_t mainPass = mRenderGraph->addPass("main pass", [this, imageIndex](VkCommandBuffer cb)
+											  { recordMainPass(cb, imageIndex); });
+	RenderGraphAccess colorWrite{VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT};
+	if (mConfig.dynamicRendering)
+	{
+		// cleared on load, the previous contents are discarded.
+		colorWrite.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorWrite.discard = true;
+	}
+	else
+	{
+		// the render pass does its own transitions and leaves the image in its final layout.
+		colorWrite.endLayout = mConfig.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	}
+	mRenderGraph->write(mainPass, colorTarget, colorWrite);
+	if (sceneReady && !mConfig.cpuDraws)
+	{
+		mRenderGraph->read(mainPass, drawCommands, {VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT});
+		mRenderGraph->read(mainPass, drawCount, {VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT});
+		mRenderGraph->read(mainPass, drawInstances, {VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT});
+	}
+
+	if (mConfig.readback)
+	{
+		RenderGraphAccess hostRead{VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT};
+		uint32_t readbackBuffer = mRenderGraph->importBuffer("readback", mReadbackBuffers[mCurrentFrame].buffer, {}, hostRead);
+		uint32_t readbackPass = mRenderGraph->addPass(
+			"readback", [this, imageIndex](VkCommandBuffer cb)
+			{
+				uint32_t readbackScope = mProfiler ? mProfiler->beginScope(cb, "readback") : 0;
+				recordReadback(cb, imageIndex);
+				if (mProfiler)
+				{
+					mProfiler->endScope(cb, readbackScope);
+				}
+			});
+		mRenderGraph->read(readbackPass, colorTarget, {VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL});
+		mRenderGraph->write(readbackPass, readbackBuffer, {VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT});
+	}
+
+	mRenderGraph->compile(mFrameNumber);
+	mRenderGraph->execute(commandBuffer);
+
+	if (mProfiler)
+	{
+		mProfiler->endScope(commandBuffer, frameScope);
+	}
+
+	res = vkEndCommandBuffer(commandBuffer);
+	assert(res == VK_SUCCESS);
+}
+
+uint32_t ApplicationFw::addCullPasses(RenderGraph &graph, uint32_t drawCommands, uint32_t drawInstances, uint32_t drawCount, bool profiled)
+{
+	uint32_t resetPass = graph.addPass("cull reset", [this](VkCommandBuffer cb)
+									   { mCuller->recordReset(cb, mCurrentFrame); });
+	graph.write(resetPass, drawCount, {VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT});
+
+	uint32_t cullPass = graph.addPass(
+		"cull", [this, profiled](VkCommandBuffer cb)
+		{
+			uint32_t cullScope = profiled && mProfiler ? mProfiler->beginScope(cb, "cull", true) : 0;
+			mCuller->recordCull(cb, mCurrentFrame, mViewProj, mIndexCount);
+			if (profiled && mProfiler)
+			{
+				mProfiler->endScope(cb, cullScope);
+			}
+		});
+	RenderGraphAccess cullWrite{VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT};
+	graph.read(cullPass, drawCount, {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT});
+	graph.write(cullPass, drawCount, cullWrite);
+	graph.write(cullPass, drawCommands, cullWrite);
+	graph.write(cullPass, drawInstances, cullWrite);
+	return cullPass;
+}
+
+void ApplicationFw::recordMainPass(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	// a statistics query active in the primary would need inheritedQueries for the secondaries.
+	uint32_t mainScope = mProfiler ? mProfiler->beginScope(commandBuffer, "main pass", !mRecorder) : 0;
+	VkClearValue clearColor = {{{1.0f, 1.0f, 0.0f, 1.0f}}};
+	if (mConfig.dynamicRendering)
+	{
+		// the render graph transitions the image before and after.
+		VkRenderingAttachmentInfo colorAttachmentInfo{};
+		{
+			colorAttachmentInfo.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+			colorAttachmentInfo.imageView = mSwapChainImageViews[imageIndex];
+			colorAttachmentInfo.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			colorAttachmentInfo.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			colorAttachmentInfo.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			colorAttachmentInfo.clearValue = clearColor;
+		}
+
+		VkRenderingInfo renderingInfo{};
+		{
+			renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+			renderingInfo.renderArea.offset = {0, 0};
+			renderingInfo.renderArea.extent = mSwapChainExtent;
+			renderingInfo.layerCount = 1;
+			renderingInfo.colorAttachmentCount = 1;
+			renderingInfo.pColorAttachments = &colorAttachmentInfo;
+			renderingInfo.flags = mRecorder ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0;
+		}
+
+		vkCmdBeginRendering(commandBuffer, &renderingInfo);
+		recordRenderPassContents(commandBuffer, imageIndex);
+		vkCmdEndRendering(commandBuffer);
+	}
+	else
+	{
+		VkRenderPassBeginInfo renderPassBeginInfo{};
+		{
+			renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			renderPassBeginInfo.renderPass = mRenderPass;
+			renderPassBeginInfo.framebuffer = mSwapChainFramebuffers[imageIndex];
+			renderPassBeginInfo.renderArea.offset = {0, 0};
+			renderPassBeginInfo.renderArea.extent = mSwapChainExtent;
+			renderPassBeginInfo.clearValueCount = 1;
+			renderPassBeginInfo.pClearValues = &clearColor;
+		}
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, mRecorder ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+		recordRenderPassContents(commandBuffer, imageIndex);
+		vkCmdEndRenderPass(commandBuffer);
+	}
+	if (mProfiler)
+	{
+		mProfiler->endScope(commandBuffer, mainScope);
+	}
+}
+
+void ApplicationFw::recordRenderPassContents(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	if (!mRecorder)
+	{
+		recordDrawCommands(commandBuffer, 0, drawListSize());
+		return;
+	}
+
+	// secondaries continue the primary's render pass, they need to know its attachments.
+	VkFormat colorFormat = mSwapChainImageFormat;
+	VkCommandBufferInheritanceRenderingInfo inheritanceRenderingInfo{};
+	{
+		inheritanceRenderingInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+		inheritanceRenderingInfo.colorAttachmentCount = 1;
+		inheritanceRenderingInfo.pColorAttachmentFormats = &colorFormat;
+		inheritanceRenderingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+	}
+
+	VkCommandBufferInheritanceInfo inheritanceInfo{};
+	{
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		if (mConfig.dynamicRendering)
+		{
+			inheritanceInfo.pNext = &inheritanceRenderingInfo;
+		}
+		else
+		{
+			inheritanceInfo.renderPass = mRenderPass;
+			inheritanceInfo.subpass = 0;
+			inheritanceInfo.framebuffer = mSwapChainFramebuffers[imageIndex];
+		}
+	}
+
+	const std::vector<VkCommandBuffer> &secondaries = mRecorder->record(mCurrentFrame, inheritanceInfo, drawListSize(),
+																		[this](VkCommandBuffer secondary, uint32_t first, uint32_t count)
+																		{ recordDrawCommands(secondary, first, count); });
+	vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+}
+
+uint32_t ApplicationFw::drawListSize()
+{
+	// the culled path is a single indirect draw no matter how many objects there are.
+	if (!mConfig.cpuDraws)
+		return 1;
+	return mConfig.batchInstances ? static_cast<uint32_t>(mDrawQueue->batches().size()) : mDrawQueue->size();
+}
+
+void ApplicationFw::buildDrawPackets()
+{
+	// every draw is in the main pass and uses the one mesh, its texture is the material. The depth
+	// is the sphere center's clip w, its view distance under a perspective projection.
+	uint32_t objectCount = mConfig.cpuTransforms ? static_cast<uint32_t>(mVisibleObjects.size()) : mCuller->objectCount();
+	uint32_t textureCount = mTextureStreamer ? mTextureStreamer->textureCount() : 0;
+	mDrawQueue->clear();
+	mDrawQueue->reserve(objectCount);
+	for (uint32_t i = 0; i < objectCount; ++i)
+	{
+		uint32_t object = mConfig.cpuTransforms ? mVisibleObjects[i] : i;
+		const glm::vec4 &sphere = mSceneSpheres[object];
+		float depth = mViewProj[0][3] * sphere.x + mViewProj[1][3] * sphere.y + mViewProj[2][3] * sphere.z + mViewProj[3][3];
+		uint32_t material = textureCount > 1 ? object % textureCount : 0;
+		mDrawQueue->add(DrawQueue::makeKey(0, object % mConfig.drawPipelines, 0, material, depth), object);
+	}
+
+	if (mConfig.sortDraws)
+	{
+		mDrawQueue->sort();
+	}
+	if (mConfig.batchInstances)
+	{
+		mDrawQueue->buildBatches(mFrameArena->allocateArray<uint32_t>(objectCount, mInstanceElement));
+	}
+}
+
+PipelineVariant ApplicationFw::drawPacketVariant(uint32_t pipeline) const
+{
+	// the app has no materials that need pipelines of their own, other cull modes stand in for them.
+	const VkCullModeFlags cullModes[] = {VK_CULL_MODE_NONE, VK_CULL_MODE_FRONT_BIT};
+	PipelineVariant variant = mDrawVariant;
+	if (pipeline > 0)
+	{
+		variant.cullMode = cullModes[pipeline - 1];
+	}
+	return variant;
+}
+
+void ApplicationFw::recordDrawCommands(VkCommandBuffer commandBuffer, uint32_t first, uint32_t count)
+{
+	VkViewport viewport{};
+	{
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = static_cast<float>(mSwapChainExtent.width);
+		viewport.height = static_cast<float>(mSwapChainExtent.height);
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+	}
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	VkRect2D scissor{};
+	{
+		scissor.offset = {0, 0};
+		scissor.extent = mSwapChainExtent;
+	}
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	// the geometry streams in while frames are rendered, draw it once the upload landed.
+	if (!mUploader->isAcquired(mGeometryBatch) || !mUploader->isAcquired(mSceneBatch))
+		return;
+
+	// the heap is bound once per command buffer, draws select resources by slot.
+	mDescriptorHeap->bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelineLayout);
+	DrawPushConstants pushConstants{};
+	{
+		pushConstants.frameData = mFrameArenaSlots[mCurrentFrame];
+		pushConstants.camera = mCameraElement;
+		pushConstants.objectBuffer = mObjectBufferSlot;
+		pushConstants.texture = mTextureStreamer ? mTextureStreamer->slot(0) : DescriptorHeap::kInvalidSlot;
+		pushConstants.sampler = mDefaultSamplerSlot;
+		pushConstants.transforms = mConfig.cpuTransforms ? mTransformElement : DescriptorHeap::kInvalidSlot;
+		std::copy(mUvOffset, mUvOffset + 2, pushConstants.uvOffset);
+		std::copy(mUvScale, mUvScale + 2, pushConstants.uvScale);
+		pushConstants.instances = mConfig.cpuDraws && mConfig.batchInstances ? mInstanceElement : DescriptorHeap::kInvalidSlot;
+		pushConstants.positionScale = mPositionScale;
+		std::copy(mPositionOffset, mPositionOffset + 3, pushConstants.positionOffset);
+	}
+	vkCmdPushConstants(commandBuffer, mPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(pushConstants), &pushConstants);
+
+	// binding 0 is the instance stream, the mesh streams follow; a position-only pass binds one.
+	const VertexLayout &layout = VertexLayout::preset(mDrawVariant.vertexLayout);
+	VkBuffer vertexBuffers[static_cast<uint32_t>(VertexSemantic::Count)];
+	VkDeviceSize offsets[static_cast<uint32_t>(VertexSemantic::Count)] = {};
+	uint32_t vertexBufferCount = 0;
+	for (uint32_t stream = 0; stream < layout.streamCount(); ++stream)
+	{
+		if (!mDrawVariant.positionOnly || stream == layout.positionStream())
+		{
+			vertexBuffers[vertexBufferCount++] = mVertexStreams[stream].buffer;
+		}
+	}
+	auto bindMesh = [&]()
+	{
+		vkCmdBindVertexBuffers(commandBuffer, 1, vertexBufferCount, vertexBuffers, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, mIndexBuffer.buffer, 0, mIndexType);
+	};
+
+	if (mConfig.cpuDraws)
+	{
+		// draws come sorted by state, each bind is recorded only if it differs from the last one
+		// in this command buffer.
+		DrawStateFilter filter;
+		VkBuffer objectBuffer = mCuller->objectBuffer();
+		uint32_t textureCount = mTextureStreamer ? mTextureStreamer->textureCount() : 0;
+		auto bindState = [&](uint32_t pipeline, uint32_t mesh, uint32_t material)
+		{
+			if (filter.changed(DrawState::Pipeline, pipeline))
+			{
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, getPipeline(drawPacketVariant(pipeline)));
+			}
+			if (filter.changed(DrawState::Mesh, mesh))
+			{
+				// every object is drawn, the object buffer itself is the instance stream.
+				bindMesh();
+				vkCmdBindVertexBuffers(commandBuffer, 0, 1, &objectBuffer, offsets);
+			}
+			if (filter.changed(DrawState::Material, material))
+			{
+				uint32_t texture = textureCount > 1 ? mTextureStreamer->slot(material) : pushConstants.texture;
+				vkCmdPushConstants(commandBuffer, mPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+								   offsetof(DrawPushConstants, texture), sizeof(texture), &texture);
+			}
+		};
+
+		if (mConfig.batchInstances)
+		{
+			// the shaders look the objects up by instance, the instance stream is not used for them.
+			for (uint32_t i = first; i < first + count; ++i)
+			{
+				const DrawBatch &batch = mDrawQueue->batches()[i];
+				bindState(batch.pipeline, batch.mesh, batch.material);
+				vkCmdDrawIndexed(commandBuffer, mIndexCount, batch.instanceCount, 0, 0, batch.firstInstance);
+			}
+		}
+		else
+		{
+			for (uint32_t i = first; i < first + count; ++i)
+			{
+				const DrawPacket &packet = mDrawQueue->packets()[i];
+				bindState(DrawQueue::pipeline(packet.key), DrawQueue::mesh(packet.key), DrawQueue::material(packet.key));
+				vkCmdDrawIndexed(commandBuffer, mIndexCount, 1, 0, 0, packet.object);
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(mBindStatsMutex);
+		mBindStats += filter.stats();
+	}
+	else
+	{
+		// one indexed draw per visible object, the count comes from the cull pass.
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, getPipeline(mDrawVariant));
+		bindMesh();
+		mCuller->recordDraw(commandBuffer, mCurrentFrame);
+	}
+}
+
+void ApplicationFw::createCommandBuffer()
+{
+	// one primary command buffer per slot of the frames-in-flight ring, each from its own pool.
+	mFrames.resize(mConfig.framesInFlight);
+	QueueFamilyIndices indices = findQueueFamilies(mPhysicalDevice);
+
+	for (auto &frame : mFrames)
+	{
+		VkCommandPoolCreateInfo commandPoolCreateInfo{};
+		{
+			commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			commandPoolCreateInfo.queueFamilyIndex = indices.graphicsFamily.value();
+		}
+
+		VkResult res = vkCreateCommandPool(mDevice, &commandPoolCreateInfo, nullptr, &frame.commandPool);
+		assert(res == VK_SUCCESS);
+
+		VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
+		{
+			commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			commandBufferAllocateInfo.commandPool = frame.commandPool;
+			commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			commandBufferAllocateInfo.commandBufferCount = 1;
+		}
+
+		res = vkAllocateCommandBuffers(mDevice, &commandBufferAllocateInfo, &frame.commandBuffer);
+		assert(res == VK_SUCCESS);
+	}
+
+	if (mConfig.recordThreads > 0)
+	{
+		mRecorder = std::make_unique<ParallelRecorder>(mDevice, indices.graphicsFamily.value(), static_cast<uint32_t>(mFrames.size()), mConfig.recordThreads);
+	}
+}
+
+void ApplicationFw::createCommandPool()
+{
+	QueueFamilyIndices indices = findQueueFamilies(mPhysicalDevice);
+
+	VkCommandPoolCreateInfo commandPoolCreateInfo{};
+	{
+		commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		commandPoolCreateInfo.queueFamilyIndex = indices.graphicsFamily.value();
+	}
+
+	VkResult res = vkCreateCommandPool(mDevice, &commandPoolCreateInfo, nullptr, &mCommandPool);
+	assert(res == VK_SUCCESS);
+}
+
+void ApplicationFw::createFramebuffers()
+{
+	mSwapChainFramebuffers.resize(mSwapChainImageViews.size());
+
+	for (size_t i = 0; i < mSwapChainImageViews.size(); ++i)
+	{
+		VkImageView attachments[] = {mSwapChainImageViews[i]};
+
+		VkFramebufferCreateInfo framebufferCreateInfo{};
+		{
+			framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			framebufferCreateInfo.renderPass = mRenderPass;
+			framebufferCreateInfo.attachmentCount = 1;
+			framebufferCreateInfo.pAttachments = attachments;
+			framebufferCreateInfo.width = mSwapChainExtent.width;
+			framebufferCreateInfo.height = mSwapChainExtent.height;
+			framebufferCreateInfo.layers = 1;
+
+			VkResult res = vkCreateFramebuffer(mDevice, &framebufferCreateInfo, nullptr, &mSwapChainFramebuffers[i]);
+			assert(res == VK_SUCCESS);
+		}
+	}
+}
+
+void ApplicationFw::benchmarkAttachmentRebuild()
+{
+	// what a resize costs in attachment objects: image views on both paths,
+	// plus the render pass and framebuffers on the legacy path.
+	// prewarmed variants are compiled against mRenderPass, which is recreated below.
+	mPipelineCompiler->waitIdle();
+
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < mConfig.benchAttachmentRebuilds; ++i)
+	{
+		for (auto framebuffer : mSwapChainFramebuffers)
+		{
+			vkDestroyFramebuffer(mDevice, framebuffer, nullptr);
+		}
+		for (auto imageView : mSwapChainImageViews)
+		{
+			vkDestroyImageView(mDevice, imageView, nullptr);
+		}
+
+		createImageViews();
+		if (!mConfig.dynamicRendering)
+		{
+			// a compatible render pass keeps the pipeline valid, only its handle is recreated.
+			vkDestroyRenderPass(mDevice, mRenderPass, nullptr);
+			createRenderPass();
+			createFramebuffers();
+		}
+	}
+	double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << (mConfig.dynamicRendering ? "dynamic rendering" : "render pass") << " path: "
+			  << mConfig.benchAttachmentRebuilds << " attachment rebuilds, avg "
+			  << totalMs * 1000.0 / mConfig.benchAttachmentRebuilds << " us per rebuild" << std::endl;
+}
+
+void ApplicationFw::benchmarkAllocator()
+{
+	// a throwaway buffer gives the memory types a typical vertex/storage buffer may use.
+	VkBufferCreateInfo bufferCreateInfo{};
+	{
+		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferCreateInfo.size = 256;
+		bufferCreateInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	}
+
+	VkBuffer buffer;
+	VkResult res = vkCreateBuffer(mDevice, &bufferCreateInfo, nullptr, &buffer);
+	assert(res == VK_SUCCESS);
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(mDevice, buffer, &requirements);
+	vkDestroyBuffer(mDevice, buffer, nullptr);
+
+	using clock = std::chrono::steady_clock;
+	std::mt19937 rng(1234);
+	const size_t maxLive = 4096;
+	std::vector<Allocation> live;
+	live.reserve(maxLive);
+
+	// sizes spread log-uniformly between 256 bytes and 1 MiB, two allocations for every free.
+	double allocateMs = 0.0, freeMs = 0.0;
+	uint32_t allocateCount = 0, freeCount = 0;
+	for (uint32_t i = 0; i < mConfig.benchAllocatorOperations; ++i)
+	{
+		bool allocate = live.empty() || (live.size() < maxLive && rng() % 3 != 0);
+		if (allocate)
+		{
+			VkMemoryRequirements request = requirements;
+			request.size = (VkDeviceSize(1) << (8 + rng() % 13)) + rng() % 4096;
+			VkMemoryPropertyFlags required = rng() % 4 == 0 ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT : 0;
+
+			auto start = clock::now();
+			live.push_back(mAllocator->allocate(request, required, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, AllocationUsage::Buffer));
+			allocateMs += std::chrono::duration<double, std::milli>(clock::now() - start).count();
+			++allocateCount;
+		}
+		else
+		{
+			size_t index = rng() % live.size();
+			std::swap(live[index], live.back());
+
+			auto start = clock::now();
+			mAllocator->free(live.back());
+			freeMs += std::chrono::duration<double, std::milli>(clock::now() - start).count();
+			live.pop_back();
+			++freeCount;
+		}
+	}
+
+	std::cout << "allocator: " << allocateCount << " allocations, avg " << (allocateCount > 0 ? allocateMs * 1000.0 / allocateCount : 0.0)
+			  << " us; " << freeCount << " frees, avg " << (freeCount > 0 ? freeMs * 1000.0 / freeCount : 0.0) << " us" << std::endl;
+	reportMemoryStats();
+
+	for (auto &allocation : live)
+	{
+		mAllocator->free(allocation);
+	}
+
+	// the same pattern through vkAllocateMemory directly, kept short to stay under maxMemoryAllocationCount.
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(mPhysicalDevice, &memoryProperties);
+	uint32_t memoryTypeIndex = 0;
+	while (!(requirements.memoryTypeBits & (1 << memoryTypeIndex)))
+		++memoryTypeIndex;
+
+	const uint32_t rawCount = std::min(mConfig.benchAllocatorOperations, 256u);
+	std::vector<VkDeviceMemory> rawMemory(rawCount);
+	auto rawStart = clock::now();
+	for (uint32_t i = 0; i < rawCount; ++i)
+	{
+		VkMemoryAllocateInfo memoryAllocateInfo{};
+		{
+			memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			memoryAllocateInfo.allocationSize = (VkDeviceSize(1) << (8 + rng() % 13)) + rng() % 4096;
+			memoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
+		}
+		res = vkAllocateMemory(mDevice, &memoryAllocateInfo, nullptr, &rawMemory[i]);
+		assert(res == VK_SUCCESS);
+	}
+	for (auto memory : rawMemory)
+	{
+		vkFreeMemory(mDevice, memory, nullptr);
+	}
+	double rawMs = std::chrono::duration<double, std::milli>(clock::now() - rawStart).count();
+
+	std::cout << "vkAllocateMemory: " << rawCount << " allocate+free pairs, avg "
+			  << (rawCount > 0 ? rawMs * 1000.0 / rawCount : 0.0) << " us" << std::endl;
+}
+
+GpuBuffer ApplicationFw::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties)
+{
+	GpuBuffer buffer;
+
+	VkBufferCreateInfo bufferCreateInfo{};
+	{
+		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferCreateInfo.size = size;
+		bufferCreateInfo.usage = usage;
+		// ownership moves between queue families with explicit barriers instead of concurrent sharing.
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	}
+
+	VkResult res = vkCreateBuffer(mDevice, &bufferCreateInfo, nullptr, &buffer.buffer);
+	assert(res == VK_SUCCESS);
+	buffer.allocation = mAllocator->allocateForBuffer(buffer.buffer, properties);
+
+	return buffer;
+}
+
+void ApplicationFw::destroyBuffer(GpuBuffer &buffer)
+{
+	if (buffer.buffer == VK_NULL_HANDLE)
+		return;
+
+	vkDestroyBuffer(mDevice, buffer.buffer, nullptr);
+	mAllocator->free(buffer.allocation);
+	buffer.buffer = VK_NULL_HANDLE;
+}
+
+void ApplicationFw::reportMemoryStats()
+{
+	MemoryAllocatorStats stats = mAllocator->stats();
+	std::cout << "device memory objects: " << stats.deviceAllocationCount << " of " << stats.maxDeviceAllocationCount
+			  << ", dedicated: " << stats.dedicatedAllocationCount << " (" << stats.dedicatedBytes / 1024 << " KiB)" << std::endl;
+
+	for (auto &pool : stats.pools)
+	{
+		std::cout << "  type " << pool.memoryTypeIndex << (pool.usage == AllocationUsage::Image ? " images" : " buffers")
+				  << ": " << pool.blockCount << " blocks, " << pool.allocationCount << " allocations, "
+				  << pool.usedBytes / 1024 << "/" << pool.reservedBytes / 1024 << " KiB used ("
+				  << pool.requestedBytes / 1024 << " KiB requested), "
+				  << pool.freeRangeCount << " free ranges, largest " << pool.largestFreeRange / 1024 << " KiB, "
+				  << "fragmentation " << pool.fragmentation() << std::endl;
+	}
+}
+
+void ApplicationFw::createUploader()
+{
+	QueueFamilyIndices indices = findQueueFamilies(mPhysicalDevice);
+	uint32_t graphicsFamily = indices.graphicsFamily.value();
+	uint32_t transferFamily = indices.transferFamily.value_or(graphicsFamily);
+
+	mUploader = std::make_unique<StagingUploader>(mDevice, *mAllocator, mTransferQueue, transferFamily, graphicsFamily, 16ull << 20);
+	std::cout << "uploads on " << (mUploader->ownershipTransfer() ? "transfer-only" : "graphics") << " queue family " << transferFamily << std::endl;
+}
+
+void ApplicationFw::loadMesh()
+{
+	if (mConfig.meshPath.empty())
+	{
+		mMesh = quadMesh;
+		return;
+	}
+
+	// only mapped here, the streams are uploaded from the mapping or unpacked for layouts they do
+	// not match, see createGeometryBuffers().
+	if (!mMeshFile.open(mConfig.meshPath))
+		throw std::runtime_error("cannot open mesh " + mConfig.meshPath + ".");
+	const MeshFileHeader &header = mMeshFile.header();
+	std::cout << "mesh " << mConfig.meshPath << ": " << header.vertexCount << " vertices, " << header.indexCount / 3 << " triangles" << std::endl;
+}
+
+void ApplicationFw::createGeometryBuffers()
+{
+	const VertexLayout &layout = VertexLayout::preset(mDrawVariant.vertexLayout);
+	if (!mConfig.meshPath.empty())
+	{
+		std::vector<const MeshFile::Stream *> fileStreams;
+		for (uint32_t stream = 0; stream < layout.streamCount(); ++stream)
+		{
+			fileStreams.push_back(layout.fileStream(mMeshFile, stream));
+		}
+		if (std::find(fileStreams.begin(), fileStreams.end(), nullptr) == fileStreams.end())
+		{
+			createMeshFileBuffers(fileStreams);
+			return;
+		}
+
+		// otherwise transcoded from the unpacked file, centered and scaled to the object sphere's
+		// diameter like the quad, which also keeps half precision positions accurate.
+		if (mMesh.positions.empty())
+		{
+			mMesh = mMeshFile.unpack();
+			const MeshFileHeader &header = mMeshFile.header();
+			float scale = header.radius > 0.0f ? 0.5f / header.radius : 1.0f;
+			for (size_t i = 0; i < mMesh.positions.size(); ++i)
+			{
+				mMesh.positions[i] = (mMesh.positions[i] - header.center[i % 3]) * scale;
+			}
+		}
+	}
+
+	// encoded for the draw variant's layout, mGraphicsPipeline and every variant expect it.
+	EncodedVertices encoded = layout.encode(mMesh);
+	std::copy(encoded.uvOffset, encoded.uvOffset + 2, mUvOffset);
+	std::copy(encoded.uvScale, encoded.uvScale + 2, mUvScale);
+	mPositionScale = 1.0f;
+	std::fill(mPositionOffset, mPositionOffset + 3, 0.0f);
+	mVertexCount = encoded.vertexCount;
+
+	// submitted right away, frames render without the geometry until the batch is acquired.
+	for (const auto &stream : encoded.streams)
+	{
+		GpuBuffer buffer = createBuffer(stream.size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		mUploader->upload(buffer.buffer, 0, stream.data(), stream.size(), VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+		mVertexStreams.push_back(buffer);
+	}
+
+	// 16-bit indices whenever the vertex count allows them.
+	mIndexCount = static_cast<uint32_t>(mMesh.indices.size());
+	mIndexType = encoded.vertexCount <= 65536 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+	std::vector<uint16_t> shortIndices;
+	const void *indexData = mMesh.indices.data();
+	VkDeviceSize indexBufferSize = static_cast<VkDeviceSize>(mIndexCount) * sizeof(uint32_t);
+	if (mIndexType == VK_INDEX_TYPE_UINT16)
+	{
+		shortIndices.assign(mMesh.indices.begin(), mMesh.indices.end());
+		indexData = shortIndices.data();
+		indexBufferSize = static_cast<VkDeviceSize>(mIndexCount) * sizeof(uint16_t);
+	}
+
+	mIndexBuffer = createBuffer(indexBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	mGeometryBatch = mUploader->upload(mIndexBuffer.buffer, 0, indexData, indexBufferSize,
+									   VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+	mUploader->submit();
+}
+
+void ApplicationFw::createMeshFileBuffers(const std::vector<const MeshFile::Stream *> &fileStreams)
+{
+	// the file already holds the layout's streams: copied from the mapping into staging as they
+	// are, the shader centers and scales the positions instead.
+	const MeshFileHeader &header = mMeshFile.header();
+	std::copy(header.uvOffset, header.uvOffset + 2, mUvOffset);
+	std::copy(header.uvScale, header.uvScale + 2, mUvScale);
+	mPositionScale = header.radius > 0.0f ? 0.5f / header.radius : 1.0f;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		mPositionOffset[axis] = -header.center[axis] * mPositionScale;
+	}
+
+	for (const MeshFile::Stream *stream : fileStreams)
+	{
+		GpuBuffer buffer = createBuffer(stream->size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		mUploader->upload(buffer.buffer, 0, stream->data, stream->size, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+		mVertexStreams.push_back(buffer);
+	}
+
+	const MeshFile::Stream &indices = mMeshFile.stream(MeshStream::Index);
+	mVertexCount = header.vertexCount;
+	mIndexCount = header.indexCount;
+	mIndexType = mMeshFile.indexType();
+	mIndexBuffer = createBuffer(indices.size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	mGeometryBatch = mUploader->upload(mIndexBuffer.buffer, 0, indices.data, indices.size,
+									   VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+	mUploader->submit();
+}
+
+void ApplicationFw::destroyGeometryBuffers()
+{
+	// the device must be idle, nothing in flight may read the streams anymore.
+	for (auto &stream : mVertexStreams)
+	{
+		destroyBuffer(stream);
+	}
+	mVertexStreams.clear();
+	destroyBuffer(mIndexBuffer);
+}
+
+void ApplicationFw::runVertexLayoutBenchmark()
+{
+	// the quad is no load for vertex fetch, without a mesh the objects are dense spheres.
+	if (mConfig.meshPath.empty())
+	{
+		mMesh = createSphereMesh(128, 256);
+	}
+	if (mCuller->objectCount() == 1)
+	{
+		vkDeviceWaitIdle(mDevice);
+		mCuller.reset();
+		createScene(1000);
+	}
+
+	struct Run
+	{
+		VertexLayoutPreset layout;
+		bool positionOnly;
+	};
+	const Run runs[] = {{VertexLayoutPreset::Float, false},
+						{VertexLayoutPreset::Quantized, false},
+						{VertexLayoutPreset::SplitPosition, false},
+						{VertexLayoutPreset::SplitPosition, true},
+						{VertexLayoutPreset::Packed, false}};
+	const uint32_t frameCount = 200;
+
+	// the geometry is re-uploaded for every variant drawn, its layout always matches the pipeline.
+	auto drawVariant = [this](const PipelineVariant &variant)
+	{
+		vkDeviceWaitIdle(mDevice);
+		destroyGeometryBuffers();
+		mDrawVariant = variant;
+		createGeometryBuffers();
+	};
+	PipelineVariant configured = mDrawVariant;
+	configured.vertexLayout = mConfig.vertexLayout;
+	configured.positionOnly = false;
+
+	for (const Run &run : runs)
+	{
+		PipelineVariant variant = configured;
+		variant.vertexLayout = run.layout;
+		variant.positionOnly = run.positionOnly;
+
+		// switched to only once built: the fallback, mGraphicsPipeline, would read the streams with
+		// the startup layout.
+		mPipelineCompiler->request(variant, mGraphicsPipeline);
+		mPipelineCompiler->waitIdle();
+		const VertexLayout &layout = VertexLayout::preset(run.layout);
+		std::string name = layout.name() + (run.positionOnly ? " position only" : "");
+		if (mPipelineCompiler->request(variant, VK_NULL_HANDLE) == VK_NULL_HANDLE)
+		{
+			std::cout << "vertex layout " << name << ": pipeline failed to compile" << std::endl;
+			continue;
+		}
+
+		drawVariant(variant);
+		runBenchmarkFrames(frameCount);
+
+		// a position-only pass fetches just the position stream; the throughput counts every
+		// object, culled ones included, so it compares layouts rather than measuring the GPU peak.
+		uint32_t vertexBytes = run.positionOnly ? layout.positionBytes() : layout.vertexBytes();
+		double frameMs = mFrameStats.averageFrameMs();
+		double indices = static_cast<double>(mIndexCount) * mCuller->objectCount();
+		std::cout << "vertex layout " << name << ": " << vertexBytes << " bytes/vertex, "
+				  << static_cast<double>(layout.vertexBytes()) * mVertexCount / 1024.0 << " KiB of vertex streams, avg frame ms: "
+				  << frameMs << ", " << indices / (frameMs * 1000.0) << " M indices/s" << std::endl;
+		drawVariant(configured);
+	}
+
+	// back to the startup mesh as well.
+	if (mConfig.meshPath.empty())
+	{
+		mMesh = quadMesh;
+		drawVariant(configured);
+	}
+	vkDeviceWaitIdle(mDevice);
+}
+
+void ApplicationFw::createFrameArena()
+{
+	uint32_t frameCount = static_cast<uint32_t>(mFrames.size());
+	VkDeviceSize frameCapacity = static_cast<VkDeviceSize>(mConfig.frameArenaKilobytes) << 10;
+	frameCapacity = std::max<VkDeviceSize>(frameCapacity, static_cast<VkDeviceSize>(mConfig.benchArenaTransforms) * sizeof(glm::mat4) + 4096);
+	if (mConfig.cpuTransforms)
+	{
+		// room for one matrix per object, the recording benchmark brings its own scene of 100k.
+		uint32_t objectCount = mConfig.benchRecording ? std::max(mConfig.objectCount, 100000u) : mConfig.objectCount;
+		frameCapacity = std::max<VkDeviceSize>(frameCapacity, static_cast<VkDeviceSize>(objectCount) * sizeof(glm::mat4) + 4096);
+	}
+	if (mConfig.cpuDraws)
+	{
+		// plus one batched object index per object, the benchmarks draw at least 100k.
+		uint32_t objectCount = mConfig.benchRecording || mConfig.benchBatching || mConfig.benchDrawSort ? std::max(mConfig.objectCount, 100000u) : mConfig.objectCount;
+		frameCapacity += static_cast<VkDeviceSize>(objectCount) * sizeof(uint32_t);
+	}
+	mFrameArena = std::make_unique<FrameArena>(mDevice, *mAllocator, frameCount, frameCapacity);
+
+	for (uint32_t i = 0; i < frameCount; ++i)
+	{
+		mFrameArenaSlots.push_back(mDescriptorHeap->addStorageBuffer(mFrameArena->buffer(i)));
+	}
+}
+
+void ApplicationFw::benchmarkFrameArena()
+{
+	const uint32_t frameCount = 200;
+	uint32_t deviceAllocations = mAllocator->stats().deviceAllocationCount;
+
+	// nothing is submitted, every slot is free to be reset right away.
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t frame = 0; frame < frameCount; ++frame)
+	{
+		mFrameArena->beginFrame(frame % static_cast<uint32_t>(mFrames.size()));
+		uint32_t firstElement;
+		glm::mat4 *transforms = mFrameArena->allocateArray<glm::mat4>(mConfig.benchArenaTransforms, firstElement);
+		glm::mat4 rotation = glm::rotate(glm::mat4(1.0f), frame * 0.01f, glm::vec3(0.0f, 1.0f, 0.0f));
+		for (uint32_t i = 0; i < mConfig.benchArenaTransforms; ++i)
+		{
+			transforms[i] = glm::translate(rotation, glm::vec3(static_cast<float>(i % 100), static_cast<float>(i / 100), 0.0f));
+		}
+		mFrameArena->flush();
+	}
+	double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "frame arena: " << mConfig.benchArenaTransforms << " transforms per frame, avg " << totalMs / frameCount << " ms per frame, "
+			  << (mConfig.benchArenaTransforms > 0 ? totalMs * 1e6 / (static_cast<double>(frameCount) * mConfig.benchArenaTransforms) : 0.0)
+			  << " ns per transform, " << mAllocator->stats().deviceAllocationCount - deviceAllocations << " vkAllocateMemory calls" << std::endl;
+}
+
+void ApplicationFw::benchmarkUpload()
+{
+	VkDeviceSize totalSize = static_cast<VkDeviceSize>(mConfig.benchUploadMegabytes) << 20;
+	GpuBuffer target = createBuffer(totalSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	std::vector<char> data(4ull << 20);
+	std::mt19937 rng(1234);
+	for (auto &byte : data)
+	{
+		byte = static_cast<char>(rng());
+	}
+
+	// wall clock including the memcpy into staging, the uploader stats only cover GPU batches.
+	auto start = std::chrono::steady_clock::now();
+	uint64_t lastBatch = 0;
+	for (VkDeviceSize offset = 0; offset < totalSize; offset += data.size())
+	{
+		VkDeviceSize size = std::min<VkDeviceSize>(data.size(), totalSize - offset);
+		lastBatch = mUploader->upload(target.buffer, offset, data.data(), size, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+	}
+	mUploader->waitIdle();
+	double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "upload: " << mConfig.benchUploadMegabytes << " MB in " << totalMs << " ms, "
+			  << (totalMs > 0.0 ? totalSize / (totalMs * 1000.0) : 0.0) << " MB/s" << std::endl;
+
+	// the batches still hold released ownership, acquire them on the graphics queue before the buffer goes away.
+	VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
+	{
+		commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		commandBufferAllocateInfo.commandPool = mCommandPool;
+		commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		commandBufferAllocateInfo.commandBufferCount = 1;
+	}
+	VkCommandBuffer commandBuffer;
+	VkResult res = vkAllocateCommandBuffers(mDevice, &commandBufferAllocateInfo, &commandBuffer);
+	assert(res == VK_SUCCESS);
+
+	VkCommandBufferBeginInfo commandBufferBeginInfo{};
+	{
+		commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	}
+	vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+	std::vector<VkSemaphore> waitSemaphores;
+	std::vector<VkPipelineStageFlags> waitStages;
+	mUploader->acquire(commandBuffer, mFrameNumber, waitSemaphores, waitStages);
+	vkEndCommandBuffer(commandBuffer);
+	assert(mUploader->isAcquired(lastBatch));
+
+	VkSubmitInfo submitInfo{};
+	{
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+		submitInfo.pWaitSemaphores = waitSemaphores.data();
+		submitInfo.pWaitDstStageMask = waitStages.data();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+	}
+	res = vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	assert(res == VK_SUCCESS);
+	vkQueueWaitIdle(mGraphicsQueue);
+
+	vkFreeCommandBuffers(mDevice, mCommandPool, 1, &commandBuffer);
+	destroyBuffer(target);
+}
+
+void ApplicationFw::createScene(uint32_t objectCount)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(mPhysicalDevice, &properties);
+	if (objectCount > properties.limits.maxDrawIndirectCount)
+	{
+		throw std::runtime_error("object count exceeds maxDrawIndirectCount.");
+	}
+
+	std::vector<glm::vec4> spheres(objectCount);
+	if (objectCount == 1)
+	{
+		// a single object sits in front of the camera.
+		mSceneExtent = 4.0f;
+		spheres[0] = glm::vec4(0.0f, 0.0f, -2.0f, 0.5f);
+	}
+	else
+	{
+		// objects fill a cube around the camera, roughly two units apart.
+		mSceneExtent = 2.0f * std::cbrt(static_cast<float>(objectCount));
+		std::mt19937 rng(1234);
+		std::uniform_real_distribution<float> position(-mSceneExtent * 0.5f, mSceneExtent * 0.5f);
+		for (auto &sphere : spheres)
+		{
+			sphere = glm::vec4(position(rng), position(rng), position(rng), 0.5f);
+		}
+	}
+
+	// the previous scene's slot is reused once no frame in flight can read it anymore.
+	if (mObjectBufferSlot != DescriptorHeap::kInvalidSlot)
+	{
+		mDescriptorHeap->free(DescriptorType::StorageBuffer, mObjectBufferSlot, mFrameNumber > 0 ? mFrameNumber - 1 : 0);
+	}
+
+	// with async compute the cull outputs are shared by the graphics, compute and transfer families.
+	std::vector<uint32_t> queueFamilies;
+	if (mAsyncCompute)
+	{
+		QueueFamilyIndices indices = findQueueFamilies(mPhysicalDevice);
+		std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), mAsyncCompute->queueFamily(),
+												   indices.transferFamily.value_or(indices.graphicsFamily.value())};
+		queueFamilies.assign(uniqueQueueFamilies.begin(), uniqueQueueFamilies.end());
+	}
+
+	mCuller = std::make_unique<GpuCuller>(mDevice, *mAllocator, mPipelineCache, mShaderStore->getModule("cull.comp.spv"),
+										  static_cast<uint32_t>(mFrames.size()), objectCount, queueFamilies);
+	mSceneAcquiredFrame = UINT64_MAX;
+	mObjectBufferSlot = mDescriptorHeap->addStorageBuffer(mCuller->objectBuffer());
+	mSceneBatch = mCuller->setObjects(*mUploader, spheres);
+	mUploader->submit();
+	mSceneSpheres = spheres;
+	mFeedbackCursor = 0;
+
+	if (mConfig.cpuTransforms)
+	{
+		if (objectCount * sizeof(glm::mat4) > mFrameArena->frameCapacity())
+		{
+			throw std::runtime_error("--cpu-transforms: " + std::to_string(objectCount) + " matrices exceed the frame arena, raise --frame-arena-kb.");
+		}
+
+		// the quad spans [-0.5, 0.5] in xy, scaled to the sphere diameter and spun around its normal.
+		std::mt19937 rng(5678);
+		std::uniform_real_distribution<float> angle(0.0f, glm::radians(180.0f));
+		mInstances.clear();
+		mInstances.reserve(objectCount);
+		for (const auto &sphere : spheres)
+		{
+			float halfAngle = angle(rng);
+			InstanceTransform transform;
+			transform.position = glm::vec3(sphere.x, sphere.y, sphere.z);
+			transform.rotation = glm::vec4(0.0f, 0.0f, std::sin(halfAngle), std::cos(halfAngle));
+			transform.scale = glm::vec3(sphere.w * 2.0f);
+			mInstances.add(transform, glm::vec3(0.0f), glm::vec3(0.5f, 0.5f, 0.0f));
+		}
+		mVisibleObjects.resize(objectCount);
+	}
+}
+
+// a scene left at its single default object becomes 100k objects. The frames start once the scene
+// and the geometry have been acquired and the device is idle, with the frame and bind stats reset;
+// returns their wall time in seconds, the device idle again.
+double ApplicationFw::runBenchmarkFrames(uint32_t frameCount)
+{
+	if (mCuller->objectCount() == 1)
+	{
+		vkDeviceWaitIdle(mDevice);
+		mCuller.reset();
+		createScene(100000);
+	}
+
+	// one frame has to acquire the objects before compute can cull them.
+	while (!mUploader->isAcquired(mGeometryBatch) || mSceneAcquiredFrame == UINT64_MAX || mSceneAcquiredFrame >= mFrameNumber)
+	{
+		drawFrame();
+	}
+	vkDeviceWaitIdle(mDevice);
+	mFrameStats = FrameStats{};
+	mBindStats = DrawBindStats{};
+
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < frameCount; ++i)
+	{
+		if (!mConfig.headless)
+		{
+			glfwPollEvents();
+		}
+		drawFrame();
+	}
+	vkDeviceWaitIdle(mDevice);
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void ApplicationFw::updateViewProjection()
+{
+	// the camera turns around the vertical axis when there is a scene to look around in.
+	float yaw = mCuller->objectCount() > 1 ? static_cast<float>(mFrameNumber) * 0.005f : 0.0f;
+	glm::vec3 forward(std::sin(yaw), 0.0f, -std::cos(yaw));
+
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), forward, glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 proj = glm::perspective(glm::radians(60.0f), mSwapChainExtent.width / static_cast<float>(mSwapChainExtent.height), 0.1f, mSceneExtent);
+	// vulkan clip space has y pointing down.
+	proj[1][1] *= -1.0f;
+	mViewProj = proj * view;
+
+	// the shaders read the camera from the arena, the culler still takes it directly.
+	FrameConstants *constants = mFrameArena->allocateArray<FrameConstants>(1, mCameraElement);
+	constants->viewProj = mViewProj;
+	constants->view = view;
+	constants->proj = proj;
+	constants->viewInverse = glm::inverse(view);
+	mCameraElement *= sizeof(FrameConstants) / sizeof(glm::mat4);
+}
+
+void ApplicationFw::updateInstances()
+{
+	// recomputed every frame as a moving scene would need to, straight into this frame's arena.
+	glm::mat4 *matrices = mFrameArena->allocateArray<glm::mat4>(mInstances.size(), mTransformElement);
+	mInstances.computeTransforms(matrices);
+
+	glm::vec4 planes[6];
+	GpuCuller::extractFrustumPlanes(mViewProj, planes);
+	mVisibleObjects.resize(mInstances.size());
+	mVisibleObjects.resize(mInstances.cullSpheres(planes, mVisibleObjects.data()));
+}
+
+void ApplicationFw::runCullingBenchmark()
+{
+	const uint32_t objectCounts[] = {1000, 10000, 100000, 1000000};
+	const uint32_t frameCount = 200;
+
+	for (uint32_t objectCount : objectCounts)
+	{
+		vkDeviceWaitIdle(mDevice);
+		mCuller.reset();
+		createScene(objectCount);
+
+		// the objects stream in first, only frames that cull and draw them are measured.
+		runBenchmarkFrames(frameCount);
+
+		double frames = static_cast<double>(mFrameStats.frameCount);
+		std::cout << "culling " << objectCount << " objects: avg record us: " << mFrameStats.recordTimeMs * 1000.0 / frames
+				  << ", avg cpu ms: " << mFrameStats.cpuTimeMs / frames
+				  << ", avg frame ms: " << mFrameStats.averageFrameMs() << std::endl;
+	}
+
+	vkDeviceWaitIdle(mDevice);
+}
+
+void ApplicationFw::createAsyncCompute()
+{
+	QueueFamilyIndices indices = findQueueFamilies(mPhysicalDevice);
+	if (mComputeQueue == VK_NULL_HANDLE || !mTimelineSemaphoreSupported)
+	{
+		std::cout << "async compute: no compute queue or no timeline semaphores, culling on the graphics queue" << std::endl;
+		return;
+	}
+
+	mAsyncCompute = std::make_unique<AsyncCompute>(mDevice, mComputeQueue, indices.computeFamily.value(), static_cast<uint32_t>(mFrames.size()));
+	mComputeGraph = std::make_unique<RenderGraph>(mDevice, *mAllocator, mDeletionQueue);
+	mGraphicsTimeline = AsyncCompute::createTimeline(mDevice);
+	mAsyncCull = mConfig.asyncCompute;
+	std::cout << "async compute on " << (indices.computeQueueIndex > 0 ? "a second queue of" : "compute-only") << " queue family "
+			  << indices.computeFamily.value() << std::endl;
+}
+
+uint64_t ApplicationFw::submitAsyncCull()
+{
+	// the slot's fence signaled, the graphics frame that last read these buffers is done.
+	VkCommandBuffer commandBuffer = mAsyncCompute->begin(mCurrentFrame);
+
+	mComputeGraph->reset();
+	uint32_t drawCommands = mComputeGraph->importBuffer("draw commands", mCuller->indirectBuffer(mCurrentFrame), {}, {});
+	uint32_t drawInstances = mComputeGraph->importBuffer("draw instances", mCuller->instanceBuffer(mCurrentFrame), {}, {});
+	uint32_t drawCount = mComputeGraph->importBuffer("draw count", mCuller->countBuffer(mCurrentFrame), {}, {});
+	// the profiler's queries belong to the graphics queue.
+	uint32_t cullPass = addCullPasses(*mComputeGraph, drawCommands, drawInstances, drawCount, false);
+	// read by the graphics queue after the timeline wait, nothing in this graph does.
+	mComputeGraph->setSideEffects(cullPass);
+	mComputeGraph->compile(mFrameNumber);
+	mComputeGraph->execute(commandBuffer);
+
+	// the objects were made visible by the graphics submit that acquired them.
+	return mAsyncCompute->submit(mCurrentFrame, mGraphicsTimeline, mSceneAcquiredFrame + 1, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+}
+
+void ApplicationFw::runAsyncComputeBenchmark()
+{
+	if (!mAsyncCompute)
+		return;
+
+	const uint32_t objectCounts[] = {100000, 1000000};
+	const uint32_t frameCount = 300;
+
+	for (uint32_t objectCount : objectCounts)
+	{
+		vkDeviceWaitIdle(mDevice);
+		mCuller.reset();
+		createScene(objectCount);
+
+		for (bool async : {false, true})
+		{
+			mAsyncCull = async;
+
+			// only the graphics queue run waits for the scene, those frames submit no compute work.
+			AsyncComputeStats computeStats = mAsyncCompute->stats();
+			double seconds = runBenchmarkFrames(frameCount);
+
+			double frames = static_cast<double>(mFrameStats.frameCount);
+			std::cout << "culling " << objectCount << " objects on the " << (async ? "compute" : "graphics") << " queue: frames/s: " << frameCount / seconds
+					  << ", avg cpu ms: " << mFrameStats.cpuTimeMs / frames
+					  << ", avg frame ms: " << mFrameStats.averageFrameMs()
+					  << ", compute submits: " << mAsyncCompute->stats().submitCount - computeStats.submitCount << std::endl;
+		}
+	}
+
+	mAsyncCull = mConfig.asyncCompute;
+	vkDeviceWaitIdle(mDevice);
+}
+
+void ApplicationFw::createTextureStreamer()
+{
+	VkDeviceSize budget = static_cast<VkDeviceSize>(mConfig.textureBudgetMegabytes) << 20;
+	// 32 MiB of staging, load() grows it for textures whose level 0 is larger.
+	mTextureStreamer = std::make_unique<TextureStreamer>(mPhysicalDevice, mDevice, *mAllocator, *mDescriptorHeap, mDeletionQueue, budget,
+														 VkDeviceSize(32) << 20, mConfig.textureThreads);
+	for (const auto &path : mConfig.texturePaths)
+	{
+		mTextureStreamer->load(path);
+	}
+}
+
+void ApplicationFw::updateTextureFeedback()
+{
+	// projected size of the visible objects of a window of the scene per frame, largest per
+	// texture. GPU sampler feedback would report through request() the same way.
+	const uint32_t windowSize = 32768;
+	glm::vec4 planes[6];
+	GpuCuller::extractFrustumPlanes(mViewProj, planes);
+	float focal = mSwapChainExtent.height / (2.0f * std::tan(glm::radians(30.0f)));
+
+	uint32_t textureCount = mTextureStreamer->textureCount();
+	std::vector<float> screenTexels(textureCount, 0.0f);
+	uint32_t objectCount = static_cast<uint32_t>(mSceneSpheres.size());
+	uint32_t windowCount = std::min(windowSize, objectCount);
+	for (uint32_t i = 0; i < windowCount; ++i)
+	{
+		uint32_t object = (mFeedbackCursor + i) % objectCount;
+		const glm::vec4 &sphere = mSceneSpheres[object];
+		bool visible = true;
+		for (int plane = 0; plane < 6 && visible; ++plane)
+		{
+			const glm::vec4 &p = planes[plane];
+			visible = p.x * sphere.x + p.y * sphere.y + p.z * sphere.z + p.w >= -sphere.w;
+		}
+		if (!visible)
+			continue;
+
+		// the camera sits at the origin.
+		float distance = std::max(std::sqrt(sphere.x * sphere.x + sphere.y * sphere.y + sphere.z * sphere.z), 0.001f);
+		uint32_t texture = mConfig.cpuDraws ? object % textureCount : 0;
+		screenTexels[texture] = std::max(screenTexels[texture], 2.0f * sphere.w * focal / distance);
+	}
+	mFeedbackCursor = (mFeedbackCursor + windowCount) % objectCount;
+
+	for (uint32_t texture = 0; texture < textureCount; ++texture)
+	{
+		if (screenTexels[texture] > 0.0f)
+		{
+			mTextureStreamer->request(texture, screenTexels[texture], mFrameNumber);
+		}
+	}
+}
+
+void ApplicationFw::runRecordingBenchmark()
+{
+	// measures the per-object draw list, batching would record a handful of draws.
+	mConfig.batchInstances = false;
+
+	const uint32_t threadCounts[] = {1, 2, 4, 8};
+	const uint32_t frameCount = 100;
+	QueueFamilyIndices indices = findQueueFamilies(mPhysicalDevice);
+
+	for (uint32_t threadCount : threadCounts)
+	{
+		vkDeviceWaitIdle(mDevice);
+		mRecorder = std::make_unique<ParallelRecorder>(mDevice, indices.graphicsFamily.value(), static_cast<uint32_t>(mFrames.size()), threadCount);
+		runBenchmarkFrames(frameCount);
+
+		double draws = static_cast<double>(drawListSize()) * mFrameStats.frameCount;
+		std::cout << "recording threads " << threadCount << ": " << draws / mFrameStats.recordTimeMs << " draws per ms, avg record ms: "
+				  << mFrameStats.recordTimeMs / mFrameStats.frameCount << std::endl;
+	}
+
+	vkDeviceWaitIdle(mDevice);
+}
+
+void ApplicationFw::runBatchingBenchmark()
+{
+	const uint32_t frameCount = 100;
+	for (bool batched : {false, true})
+	{
+		vkDeviceWaitIdle(mDevice);
+		mConfig.batchInstances = batched;
+		runBenchmarkFrames(frameCount);
+
+		// the record time includes sorting and merging the draws when batched.
+		double frames = static_cast<double>(mFrameStats.frameCount);
+		std::cout << (batched ? "batched" : "per object") << ": " << drawListSize() << " draws per frame, avg record ms: "
+				  << mFrameStats.recordTimeMs / frames << ", avg frame ms: " << mFrameStats.averageFrameMs() << std::endl;
+	}
+
+	vkDeviceWaitIdle(mDevice);
+}
+
+void ApplicationFw::runDrawSortBenchmark()
+{
+	// one draw per object over every pipeline, so there is state to thrash; with --texture the
+	// objects also cycle through the materials.
+	mConfig.batchInstances = false;
+	mConfig.drawPipelines = 3;
+	for (uint32_t pipeline = 0; pipeline < mConfig.drawPipelines; ++pipeline)
+	{
+		mPipelineCompiler->request(drawPacketVariant(pipeline), mGraphicsPipeline);
+	}
+	mPipelineCompiler->waitIdle();
+
+	const uint32_t frameCount = 100;
+	for (bool sorted : {false, true})
+	{
+		vkDeviceWaitIdle(mDevice);
+		mConfig.sortDraws = sorted;
+		runBenchmarkFrames(frameCount);
+
+		// the record time includes building and sorting the packets.
+		double frames = static_cast<double>(mFrameStats.frameCount);
+		const char *stateNames[] = {"pipeline", "mesh", "material"};
+		std::cout << (sorted ? "sorted" : "submission order") << ": " << drawListSize() << " draws, avg record ms: "
+				  << mFrameStats.recordTimeMs / frames << ", binds per frame issued/skipped: "
+				  << mBindStats.totalIssued() / frames << "/" << mBindStats.totalSkipped() / frames;
+		for (uint32_t state = 0; state < static_cast<uint32_t>(DrawState::Count); ++state)
+		{
+			std::cout << ", " << stateNames[state] << " " << mBindStats.issued[state] / frames << "/" << mBindStats.skipped[state] / frames;
+		}
+		std::cout << std::endl;
+	}
+
+	vkDeviceWaitIdle(mDevice);
+}
+
+void ApplicationFw::createDescriptorHeap()
+{
+	mDescriptorHeap = std::make_unique<DescriptorHeap>(mPhysicalDevice, mDevice);
+
+	VkSamplerCreateInfo samplerCreateInfo{};
+	{
+		samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+	}
+
+	VkResult res = vkCreateSampler(mDevice, &samplerCreateInfo, nullptr, &mDefaultSampler);
+	assert(res == VK_SUCCESS);
+	mDefaultSamplerSlot = mDescriptorHeap->addSampler(mDefaultSampler);
+}
+
+void ApplicationFw::createShaderStore()
+{
+	mShaderStore = std::make_unique<ShaderStore>(mDevice, mConfig.shaderArchive);
+	ShaderStoreStats stats = mShaderStore->stats();
+	if (stats.archivedBlobs > 0)
+	{
+		std::cout << "shader store: " << stats.archivedBlobs << " blobs mapped from " << mConfig.shaderArchive;
+		if (stats.staleEntries > 0)
+		{
+			std::cout << ", " << stats.staleEntries << " entries older than their loose .spv file";
+		}
+		std::cout << std::endl;
+	}
+	else
+	{
+		std::cout << "shader store: no archive, using loose .spv files" << std::endl;
+	}
+}
+
+VkShaderModule ApplicationFw::createShaderModule(const std::vector<uint32_t> &code)
+{
+	VkShaderModuleCreateInfo shaderModuleCreateInfo{};
+	{
+		shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		shaderModuleCreateInfo.codeSize = code.size() * sizeof(uint32_t);
+		shaderModuleCreateInfo.pCode = code.data();
+	}
+	VkShaderModule shaderModule = VK_NULL_HANDLE;
+	if (vkCreateShaderModule(mDevice, &shaderModuleCreateInfo, nullptr, &shaderModule) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+	return shaderModule;
+}
+
+void ApplicationFw::createRenderPass()
+{
+	VkAttachmentDescription colorAttachment{};
+	{
+		colorAttachment.format = mSwapChainImageFormat;
+		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR; // clear the framebuffer to black before drawing new frame.
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		// offscreen images are left ready to be copied out, swapchain images ready to present.
+		colorAttachment.finalLayout = mConfig.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	}
+
+	VkAttachmentReference colocAttachmentRef{};
+	{
+		colocAttachmentRef.attachment = 0;
+		colocAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	}
+
+	VkSubpassDescription subpass{};
+	{
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colocAttachmentRef;
+	}
+
+	VkSubpassDependency dependency{};
+	{
+		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependency.dstSubpass = 0;
 		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 		dependency.srcAccessMask = 0;
 		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 	}
 
+	// offscreen images are copied out after the pass, order that copy after the color writes.
+	VkSubpassDependency readbackDependency{};
+	{
+		readbackDependency.srcSubpass = 0;
+		readbackDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+		readbackDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		readbackDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		readbackDependency.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		readbackDependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	}
+	VkSubpassDependency dependencies[] = {dependency, readbackDependency};
+
+	VkRenderPassCreateInfo renderPassCreateInfo{};
+	{
+		renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassCreateInfo.attachmentCount = 1;
+		renderPassCreateInfo.pAttachments = &colorAttachment;
+		renderPassCreateInfo.subpassCount = 1;
+		renderPassCreateInfo.pSubpasses = &subpass;
+		renderPassCreateInfo.dependencyCount = mConfig.headless ? 2 : 1;
+		renderPassCreateInfo.pDependencies = dependencies;
+	}
+
+	VkResult res = vkCreateRenderPass(mDevice, &renderPassCreateInfo, nullptr, &mRenderPass);
+	assert(res == VK_SUCCESS);
+}
+
+bool ApplicationFw::isPipelineCacheCompatible(const std::vector<char> &data)
+{
+	if (data.size() < sizeof(VkPipelineCacheHeaderVersionOne))
+	{
+		std::cout << "pipeline cache: file too small, discarding." << std::endl;
+		return false;
+	}
+
+	VkPipelineCacheHeaderVersionOne header;
+	memcpy(&header, data.data(), sizeof(header));
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(mPhysicalDevice, &properties);
+
+	if (header.headerSize < sizeof(VkPipelineCacheHeaderVersionOne) || header.headerSize > data.size() ||
+		header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+	{
+		std::cout << "pipeline cache: corrupt header, discarding." << std::endl;
+		return false;
+	}
+
+	// data from another driver or device is useless at best, so it is never passed on.
+	if (header.vendorID != properties.vendorID || header.deviceID != properties.deviceID ||
+		memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+	{
+		std::cout << "pipeline cache: created by a different device or driver, discarding." << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+void ApplicationFw::createPipelineCache()
+{
+	std::vector<char> cacheData;
+	if (!mConfig.pipelineCachePath.empty())
+	{
+		// a missing file is the normal cold start, not an error.
+		std::ifstream file(mConfig.pipelineCachePath, std::ios::ate | std::ios::binary);
+		if (file.is_open())
+		{
+			cacheData.resize(static_cast<size_t>(file.tellg()));
+			file.seekg(0);
+			file.read(cacheData.data(), cacheData.size());
+			if (!file)
+			{
+				cacheData.clear();
+			}
+		}
+	}
+
+	if (!cacheData.empty() && !isPipelineCacheCompatible(cacheData))
+	{
+		cacheData.clear();
+	}
+
+	VkPipelineCacheCreateInfo pipelineCacheCreateInfo{};
+	{
+		pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		pipelineCacheCreateInfo.initialDataSize = cacheData.size();
+		pipelineCacheCreateInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+	}
+
+	VkResult res = vkCreatePipelineCache(mDevice, &pipelineCacheCreateInfo, nullptr, &mPipelineCache);
+	if (res != VK_SUCCESS && !cacheData.empty())
+	{
+		// the driver rejected the blob despite a valid header, start with an empty cache.
+		std::cout << "pipeline cache: rejected by the driver, discarding." << std::endl;
+		cacheData.clear();
+		pipelineCacheCreateInfo.initialDataSize = 0;
+		pipelineCacheCreateInfo.pInitialData = nullptr;
+		res = vkCreatePipelineCache(mDevice, &pipelineCacheCreateInfo, nullptr, &mPipelineCache);
+	}
+	assert(res == VK_SUCCESS);
+
+	mPipelineCacheWarm = !cacheData.empty();
+	std::cout << "pipeline cache: " << (mPipelineCacheWarm ? "loaded " + std::to_string(cacheData.size()) + " bytes" : std::string("empty")) << std::endl;
+}
+
+void ApplicationFw::savePipelineCache()
+{
+	if (mConfig.pipelineCachePath.empty() || mPipelineCache == VK_NULL_HANDLE)
+		return;
+
+	size_t dataSize = 0;
+	VkResult res = vkGetPipelineCacheData(mDevice, mPipelineCache, &dataSize, nullptr);
+	if (res != VK_SUCCESS || dataSize == 0)
+		return;
+
+	std::vector<char> data(dataSize);
+	res = vkGetPipelineCacheData(mDevice, mPipelineCache, &dataSize, data.data());
+	if (res != VK_SUCCESS)
+		return;
+
+	// write to a temporary file and rename it, so a crash never leaves a half written cache.
+	std::string tempPath = mConfig.pipelineCachePath + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		file.write(data.data(), dataSize);
+		file.flush();
+		if (!file)
+		{
+			std::cout << "pipeline cache: failed to write " << tempPath << std::endl;
+			std::remove(tempPath.c_str());
+			return;
+		}
+	}
+
+	if (std::rename(tempPath.c_str(), mConfig.pipelineCachePath.c_str()) != 0)
+	{
+		std::cout << "pipeline cache: failed to replace " << mConfig.pipelineCachePath << std::endl;
+		std::remove(tempPath.c_str());
+	}
+}
+
+void ApplicationFw::createGraphicsPipeline()
+{
+	// owned by the store and shared with every other user of the same code, they stay alive
+	// while the compiler threads build further variants from them.
+	mVertexShaderModule = mShaderStore->getModule("shader.vert.spv");
+	mFragmentShaderModule = mShaderStore->getModule("shader.frag.spv");
+	mDepthShaderModule = mShaderStore->getModule("depth.vert.spv");
+	mDrawVariant.vertexLayout = mConfig.vertexLayout;
+	mDefaultVariant = mDrawVariant;
+
+	// set 0 is the descriptor heap, per-draw inputs are the matrix and heap slots in push constants.
+	VkPushConstantRange pushConstantRange{};
+	{
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(DrawPushConstants);
+	}
+
+	VkDescriptorSetLayout heapSetLayout = mDescriptorHeap->setLayout();
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+	{
+		pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutCreateInfo.setLayoutCount = 1;
+		pipelineLayoutCreateInfo.pSetLayouts = &heapSetLayout;
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+	}
+
+	VkResult res = vkCreatePipelineLayout(mDevice, &pipelineLayoutCreateInfo, nullptr, &mPipelineLayout);
+	assert(res == VK_SUCCESS);
+
+	// the default variant is built synchronously, it is the fallback for every other variant.
+	auto pipelineStart = std::chrono::steady_clock::now();
+	mGraphicsPipeline = buildGraphicsPipeline(mDefaultVariant, mVertexShaderModule, mFragmentShaderModule);
+	assert(mGraphicsPipeline != VK_NULL_HANDLE);
+	double pipelineMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pipelineStart).count();
+	std::cout << "graphics pipeline created in " << pipelineMs << " ms (" << (mPipelineCacheWarm ? "warm" : "cold") << " cache)" << std::endl;
+
+	createPipelineCompiler();
+	if (mConfig.prewarmVariants)
+	{
+		prewarmPipelineVariants();
+	}
+}
+
+void ApplicationFw::createPipelineCompiler()
+{
+	// variants are built from the modules current at creation, a shader reload starts a new compiler.
+	VkShaderModule vertexModule = mVertexShaderModule;
+	VkShaderModule fragmentModule = mFragmentShaderModule;
+	mPipelineCompiler = std::make_unique<PipelineCompiler>(
+		mDevice, [this, vertexModule, fragmentModule](const PipelineVariant &variant)
+		{ return buildGraphicsPipeline(variant, vertexModule, fragmentModule); },
+		mConfig.compileThreads);
+	// registered under the variant it was built for, mDrawVariant may have moved on since.
+	mPipelineCompiler->addReady(mDefaultVariant, mGraphicsPipeline);
+}
+
+void ApplicationFw::createShaderReloader()
+{
+	// the reload thread builds the default variant, its own copy so benchmarks may switch layouts.
+	PipelineVariant variant = mDefaultVariant;
+	mShaderReloader = std::make_unique<ShaderReloader>(
+		mDevice, "shader.vert", "shader.frag",
+		[this, variant](const std::vector<uint32_t> &vertexCode, const std::vector<uint32_t> &fragmentCode, ShaderReloader::Program &program)
+		{
+			program.vertexModule = createShaderModule(vertexCode);
+			program.fragmentModule = createShaderModule(fragmentCode);
+			if (program.vertexModule != VK_NULL_HANDLE && program.fragmentModule != VK_NULL_HANDLE)
+			{
+				program.pipeline = buildGraphicsPipeline(variant, program.vertexModule, program.fragmentModule);
+			}
+			if (program.pipeline == VK_NULL_HANDLE)
+			{
+				vkDestroyShaderModule(mDevice, program.vertexModule, nullptr);
+				vkDestroyShaderModule(mDevice, program.fragmentModule, nullptr);
+				return false;
+			}
+			return true;
+		});
+	std::cout << "shader reload: watching shader.vert and shader.frag" << std::endl;
+}
+
+void ApplicationFw::applyShaderReload()
+{
+	ShaderReloader::Program program;
+	if (!mShaderReloader->takeReady(program))
+		return;
+
+	// the old compiler owns the old default pipeline and all its variants, they are destroyed
+	// together with the old modules once the last frame recorded with them completed. Its queued
+	// variants are dropped, nothing will ask for them again.
+	RetiredProgram retired;
+	retired.compiler = std::move(mPipelineCompiler);
+	retired.compiler->cancelPending();
+	// modules from the shader store are shared and stay with it, only reloaded ones are destroyed.
+	retired.vertexModule = mShaderStore->owns(mVertexShaderModule) ? VK_NULL_HANDLE : mVertexShaderModule;
+	retired.fragmentModule = mShaderStore->owns(mFragmentShaderModule) ? VK_NULL_HANDLE : mFragmentShaderModule;
+	retired.lastUseFrame = mFrameNumber > 0 ? mFrameNumber - 1 : 0;
+	mRetiredPrograms.push_back(std::move(retired));
+
+	mVertexShaderModule = program.vertexModule;
+	mFragmentShaderModule = program.fragmentModule;
+	mGraphicsPipeline = program.pipeline;
+	createPipelineCompiler();
+}
+
+void ApplicationFw::releaseRetiredPrograms(uint64_t completedFrame)
+{
+	// a compile still running on the old compiler finishes in the background, destroying its
+	// pipelines would wait for it on the render thread.
+	for (auto it = mRetiredPrograms.begin(); it != mRetiredPrograms.end();)
+	{
+		if (it->lastUseFrame > completedFrame || !it->compiler->idle())
+		{
+			++it;
+			continue;
+		}
+		it->compiler->destroyPipelines();
+		vkDestroyShaderModule(mDevice, it->fragmentModule, nullptr);
+		vkDestroyShaderModule(mDevice, it->vertexModule, nullptr);
+		it = mRetiredPrograms.erase(it);
+	}
+}
+
+VkPipeline ApplicationFw::getPipeline(const PipelineVariant &variant)
+{
+	return mPipelineCompiler->request(variant, mGraphicsPipeline);
+}
+
+void ApplicationFw::prewarmPipelineVariants()
+{
+	const VkCullModeFlags cullModes[] = {VK_CULL_MODE_NONE, VK_CULL_MODE_FRONT_BIT, VK_CULL_MODE_BACK_BIT};
+	const VkPolygonMode polygonModes[] = {VK_POLYGON_MODE_FILL, VK_POLYGON_MODE_LINE};
+	const BlendMode blendModes[] = {BlendMode::Opaque, BlendMode::Alpha, BlendMode::Additive};
+	const VkPrimitiveTopology topologies[] = {VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, VK_PRIMITIVE_TOPOLOGY_LINE_LIST};
+
+	uint32_t queued = 0;
+	for (auto cullMode : cullModes)
+		for (auto polygonMode : polygonModes)
+			for (auto blendMode : blendModes)
+				for (auto topology : topologies)
+				{
+					PipelineVariant variant = mDrawVariant;
+					variant.cullMode = cullMode;
+					variant.polygonMode = polygonMode;
+					variant.blendMode = blendMode;
+					variant.topology = topology;
+					mPipelineCompiler->request(variant, mGraphicsPipeline);
+					++queued;
+				}
+
+	std::cout << "queued " << queued << " pipeline variants on " << mConfig.compileThreads << " compile threads" << std::endl;
+}
+
+VkRenderPass ApplicationFw::getRenderPassForSamples(VkSampleCountFlagBits samples)
+{
+	if (samples == VK_SAMPLE_COUNT_1_BIT)
+		return mRenderPass;
+
+	// multisampled variants need a compatible render pass, created on first use by any compile thread.
+	std::lock_guard<std::mutex> lock(mVariantRenderPassMutex);
+	auto it = mVariantRenderPasses.find(samples);
+	if (it != mVariantRenderPasses.end())
+		return it->second;
+
+	VkAttachmentDescription colorAttachment{};
+	{
+		colorAttachment.format = mSwapChainImageFormat;
+		colorAttachment.samples = samples;
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	}
+
+	VkAttachmentReference colorAttachmentRef{};
+	{
+		colorAttachmentRef.attachment = 0;
+		colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	}
+
+	VkSubpassDescription subpass{};
+	{
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorAttachmentRef;
+	}
+
 	VkRenderPassCreateInfo renderPassCreateInfo{};
 	{
 		renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -404,57 +2871,109 @@ void ApplicationFw::createRenderPass()
 		renderPassCreateInfo.pAttachments = &colorAttachment;
 		renderPassCreateInfo.subpassCount = 1;
 		renderPassCreateInfo.pSubpasses = &subpass;
-		renderPassCreateInfo.dependencyCount = 1;
-		renderPassCreateInfo.pDependencies = &dependency;
 	}
 
-	VkResult res = vkCreateRenderPass(mDevice, &renderPassCreateInfo, nullptr, &mRenderPass);
-	assert(res == VK_SUCCESS);
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	VkResult res = vkCreateRenderPass(mDevice, &renderPassCreateInfo, nullptr, &renderPass);
+	if (res != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+
+	mVariantRenderPasses[samples] = renderPass;
+	return renderPass;
 }
 
-void ApplicationFw::createGraphicsPipeline()
+VkPipeline ApplicationFw::buildGraphicsPipeline(const PipelineVariant &variant, VkShaderModule vertexModule, VkShaderModule fragmentModule)
 {
-	auto vertexShaderCode = readFile("shader.vert.spv");
-	assert(vertexShaderCode.size() > 0);
-	auto fragmentShaderCode = readFile("shader.frag.spv");
-	assert(fragmentShaderCode.size() > 0);
-	std::cout << "FragmentShader.spv size: " << fragmentShaderCode.size() << std::endl;
+	// called from the compile and reload threads, only reads state that is immutable after initVulkan.
+	if (variant.polygonMode != VK_POLYGON_MODE_FILL && !mFillModeNonSolidSupported)
+		return VK_NULL_HANDLE;
+
+	// with dynamic rendering the pipeline only needs the attachment formats, not a render pass.
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	if (!mConfig.dynamicRendering)
+	{
+		renderPass = getRenderPassForSamples(variant.samples);
+		if (renderPass == VK_NULL_HANDLE)
+			return VK_NULL_HANDLE;
+	}
+
+	VkPipelineRenderingCreateInfo pipelineRenderingCreateInfo{};
+	{
+		pipelineRenderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+		pipelineRenderingCreateInfo.colorAttachmentCount = 1;
+		pipelineRenderingCreateInfo.pColorAttachmentFormats = &mSwapChainImageFormat;
+	}
 
-	VkShaderModule vertexShaderModule = createShaderModule(vertexShaderCode);
-	VkShaderModule fragmentShaderModule = createShaderModule(fragmentShaderCode);
+	// normals are decoded in the shader according to the layout, see shader.vert.
+	const VertexLayout &layout = VertexLayout::preset(variant.vertexLayout);
+	VkBool32 octahedralNormals = layout.has(VertexSemantic::Normal) && layout.format(VertexSemantic::Normal) == VertexFormat::Octahedral16;
+	VkSpecializationMapEntry specializationEntry{};
+	{
+		specializationEntry.constantID = 0;
+		specializationEntry.offset = 0;
+		specializationEntry.size = sizeof(VkBool32);
+	}
+
+	VkSpecializationInfo specializationInfo{};
+	{
+		specializationInfo.mapEntryCount = 1;
+		specializationInfo.pMapEntries = &specializationEntry;
+		specializationInfo.dataSize = sizeof(octahedralNormals);
+		specializationInfo.pData = &octahedralNormals;
+	}
 
+	// position-only variants run depth.vert alone, it reads no other attribute.
 	VkPipelineShaderStageCreateInfo vertexPipelineShaderStageCreateInfo{};
 	{
 		vertexPipelineShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		vertexPipelineShaderStageCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-		vertexPipelineShaderStageCreateInfo.module = vertexShaderModule;
+		vertexPipelineShaderStageCreateInfo.module = variant.positionOnly ? mDepthShaderModule : vertexModule;
 		vertexPipelineShaderStageCreateInfo.pName = "main";
+		vertexPipelineShaderStageCreateInfo.pSpecializationInfo = variant.positionOnly ? nullptr : &specializationInfo;
 	}
 
 	VkPipelineShaderStageCreateInfo fragmentPipelineShaderStageCreateInfo{};
 	{
 		fragmentPipelineShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		fragmentPipelineShaderStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		fragmentPipelineShaderStageCreateInfo.module = fragmentShaderModule;
+		fragmentPipelineShaderStageCreateInfo.module = fragmentModule;
 		fragmentPipelineShaderStageCreateInfo.pName = "main";
 	}
 
 	VkPipelineShaderStageCreateInfo shaderStages[] = {vertexPipelineShaderStageCreateInfo,
 													  fragmentPipelineShaderStageCreateInfo};
 
+	// binding 0 holds the visible instances written by the cull pass, indexed by firstInstance;
+	// the streams of the vertex layout follow from binding 1.
+	std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+	{
+		bindingDescriptions[0].binding = 0;
+		bindingDescriptions[0].stride = sizeof(glm::vec4);
+		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+	}
+
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions(1);
+	{
+		attributeDescriptions[0].binding = 0;
+		attributeDescriptions[0].location = 2;
+		attributeDescriptions[0].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		attributeDescriptions[0].offset = 0;
+	}
+	layout.describe(1, variant.positionOnly, bindingDescriptions, attributeDescriptions);
+
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
 	{
 		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		vertexInputInfo.vertexBindingDescriptionCount = 0;
-		vertexInputInfo.pVertexBindingDescriptions = nullptr;
-		vertexInputInfo.vertexAttributeDescriptionCount = 0;
-		vertexInputInfo.pVertexAttributeDescriptions = nullptr;
+		vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+		vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 	}
 
 	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
 	{
 		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		inputAssembly.topology = variant.topology;
 		inputAssembly.primitiveRestartEnable = VK_FALSE;
 	}
 
@@ -499,9 +3018,9 @@ void ApplicationFw::createGraphicsPipeline()
 		rasterizationStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
 		rasterizationStageCreateInfo.depthClampEnable = VK_FALSE;
 		rasterizationStageCreateInfo.rasterizerDiscardEnable = VK_FALSE;
-		rasterizationStageCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterizationStageCreateInfo.polygonMode = variant.polygonMode;
 		rasterizationStageCreateInfo.lineWidth = 1.0f;
-		rasterizationStageCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;
+		rasterizationStageCreateInfo.cullMode = variant.cullMode;
 		rasterizationStageCreateInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
 		rasterizationStageCreateInfo.depthBiasEnable = VK_FALSE;
 		rasterizationStageCreateInfo.depthBiasConstantFactor = 0.0f;
@@ -513,7 +3032,7 @@ void ApplicationFw::createGraphicsPipeline()
 	{
 		multisamplingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
 		multisamplingCreateInfo.sampleShadingEnable = VK_FALSE;
-		multisamplingCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+		multisamplingCreateInfo.rasterizationSamples = variant.samples;
 		multisamplingCreateInfo.minSampleShading = 1.0f;
 		multisamplingCreateInfo.pSampleMask = nullptr;
 		multisamplingCreateInfo.alphaToCoverageEnable = VK_FALSE;
@@ -521,7 +3040,7 @@ void ApplicationFw::createGraphicsPipeline()
 	}
 	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
 	{
-		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		colorBlendAttachment.colorWriteMask = variant.positionOnly ? 0 : VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
 		colorBlendAttachment.blendEnable = VK_FALSE;
 		colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;	 // Optional
 		colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
@@ -530,6 +3049,22 @@ void ApplicationFw::createGraphicsPipeline()
 		colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
 		colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;			 // Optional
 	}
+	if (variant.blendMode == BlendMode::Alpha)
+	{
+		colorBlendAttachment.blendEnable = VK_TRUE;
+		colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+		colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	}
+	else if (variant.blendMode == BlendMode::Additive)
+	{
+		colorBlendAttachment.blendEnable = VK_TRUE;
+		colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	}
 
 	VkPipelineColorBlendStateCreateInfo colorBlending{};
 	{
@@ -544,22 +3079,11 @@ void ApplicationFw::createGraphicsPipeline()
 		colorBlending.blendConstants[3] = 0.0f; // Optional
 	}
 
-	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
-	{
-		pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutCreateInfo.setLayoutCount = 0;
-		pipelineLayoutCreateInfo.pSetLayouts = nullptr;
-		pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-		pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
-	}
-
-	VkResult res = vkCreatePipelineLayout(mDevice, &pipelineLayoutCreateInfo, nullptr, &mPipelineLayout);
-	assert(res == VK_SUCCESS);
-
 	VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo{};
 	{
 		graphicsPipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		graphicsPipelineCreateInfo.stageCount = 2;
+		graphicsPipelineCreateInfo.pNext = mConfig.dynamicRendering ? &pipelineRenderingCreateInfo : nullptr;
+		graphicsPipelineCreateInfo.stageCount = variant.positionOnly ? 1 : 2;
 		graphicsPipelineCreateInfo.pStages = shaderStages;
 		graphicsPipelineCreateInfo.pVertexInputState = &vertexInputInfo;
 		graphicsPipelineCreateInfo.pInputAssemblyState = &inputAssembly;
@@ -570,17 +3094,53 @@ void ApplicationFw::createGraphicsPipeline()
 		graphicsPipelineCreateInfo.pColorBlendState = &colorBlending;
 		graphicsPipelineCreateInfo.pDynamicState = &dynamicStateInfo;
 		graphicsPipelineCreateInfo.layout = mPipelineLayout;
-		graphicsPipelineCreateInfo.renderPass = mRenderPass;
+		graphicsPipelineCreateInfo.renderPass = renderPass;
 		graphicsPipelineCreateInfo.subpass = 0;
 		graphicsPipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
 		graphicsPipelineCreateInfo.basePipelineIndex = -1;
 	}
 
-	res = vkCreateGraphicsPipelines(mDevice, VK_NULL_HANDLE, 1, &graphicsPipelineCreateInfo, nullptr, &mGraphicsPipeline);
-	assert(res == VK_SUCCESS);
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkResult res = vkCreateGraphicsPipelines(mDevice, mPipelineCache, 1, &graphicsPipelineCreateInfo, nullptr, &pipeline);
+	if (res != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+
+	return pipeline;
+}
+
+void ApplicationFw::createOffscreenImages()
+{
+	// explicit resolution replaces chooseSwapExtent, there is no surface to query.
+	mSwapChainImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+	mSwapChainExtent = {mConfig.width, mConfig.height};
+
+	mSwapChainImages.resize(mConfig.framesInFlight);
+	mOffscreenImageMemory.resize(mConfig.framesInFlight);
+
+	for (size_t i = 0; i < mSwapChainImages.size(); ++i)
+	{
+		VkImageCreateInfo imageCreateInfo{};
+		{
+			imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageCreateInfo.format = mSwapChainImageFormat;
+			imageCreateInfo.extent = {mSwapChainExtent.width, mSwapChainExtent.height, 1};
+			imageCreateInfo.mipLevels = 1;
+			imageCreateInfo.arrayLayers = 1;
+			imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		}
+
+		VkResult res = vkCreateImage(mDevice, &imageCreateInfo, nullptr, &mSwapChainImages[i]);
+		assert(res == VK_SUCCESS);
 
-	vkDestroyShaderModule(mDevice, fragmentShaderModule, nullptr);
-	vkDestroyShaderModule(mDevice, vertexShaderModule, nullptr);
+		mOffscreenImageMemory[i] = mAllocator->allocateForImage(mSwapChainImages[i], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	}
+
+	std::cout << "offscreen images: " << mSwapChainImages.size() << " (" << mSwapChainExtent.width << "x" << mSwapChainExtent.height << ")" << std::endl;
 }
 
 void ApplicationFw::createImageViews()
@@ -610,12 +3170,112 @@ void ApplicationFw::createImageViews()
 	}
 }
 
-void ApplicationFw::createSwapChain()
+void ApplicationFw::framebufferResizeCallback(GLFWwindow *window, int width, int height)
+{
+	auto app = reinterpret_cast<ApplicationFw *>(glfwGetWindowUserPointer(window));
+	app->mFramebufferResized = true;
+}
+
+void ApplicationFw::keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+	static const VkPresentModeKHR keyPresentModes[] = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR,
+													   VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+	if (action != GLFW_PRESS || key < GLFW_KEY_1 || key > GLFW_KEY_4)
+	{
+		return;
+	}
+
+	// the swapchain is recreated with the new mode after the next present.
+	auto app = reinterpret_cast<ApplicationFw *>(glfwGetWindowUserPointer(window));
+	app->mConfig.presentMode = keyPresentModes[key - GLFW_KEY_1];
+	app->mPresentModeChanged = true;
+}
+
+void ApplicationFw::recreateSwapChain()
+{
+	// a minimized window has a zero sized framebuffer, wait until it is visible again.
+	int width = 0, height = 0;
+	glfwGetFramebufferSize(window, &width, &height);
+	while (width == 0 || height == 0)
+	{
+		glfwWaitEvents();
+		glfwGetFramebufferSize(window, &width, &height);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	// retire the old objects instead of waiting for the device to go idle, frames
+	// already submitted keep using them until their fences signal.
+	VkSwapchainKHR oldSwapChain = mSwapChain;
+	std::vector<VkImageView> oldImageViews = std::move(mSwapChainImageViews);
+	std::vector<VkFramebuffer> oldFramebuffers = std::move(mSwapChainFramebuffers);
+	std::vector<VkSemaphore> oldRenderFinished = std::move(mRenderFinishedSemaphores);
+	mSwapChainImageViews.clear();
+	mSwapChainFramebuffers.clear();
+	mRenderFinishedSemaphores.clear();
+
+	VkFormat oldFormat = mSwapChainImageFormat;
+	VkPresentModeKHR oldPresentMode = mPresentMode;
+	createSwapChain(oldSwapChain);
+	mPresentModeChanged = false;
+	if (mPresentMode != oldPresentMode)
+	{
+		// pacing numbers are only meaningful per present mode.
+		mPacer.report(presentModeName(oldPresentMode));
+		mPacer.reset();
+	}
+	if (mSwapChainImageFormat != oldFormat)
+	{
+		// render pass and pipelines are built for the old format, that needs a full rebuild.
+		throw std::runtime_error("swapchain format changed during recreation.");
+	}
+
+	createImageViews();
+	if (!mConfig.dynamicRendering)
+	{
+		createFramebuffers();
+	}
+
+	// the new images are not used by any frame yet.
+	mImagesInFlight.assign(mSwapChainImages.size(), VK_NULL_HANDLE);
+	createRenderFinishedSemaphores();
+
+	// without VK_EXT_swapchain_maintenance1 no fence tells when a present has finished, the last
+	// frame's fence only covers its rendering. The old swapchain and its render-finished semaphores
+	// are therefore kept for one more ring of frames presented to the new swapchain, assuming the
+	// presentation engine has released the old images by the time those frames completed.
+	uint64_t retireFrame = (mFrameNumber > 0 ? mFrameNumber - 1 : 0) + mFrames.size();
+	VkDevice device = mDevice;
+	mDeletionQueue.push(retireFrame, [device, oldSwapChain, oldImageViews, oldFramebuffers, oldRenderFinished]()
+						{
+		for (auto semaphore : oldRenderFinished)
+		{
+			vkDestroySemaphore(device, semaphore, nullptr);
+		}
+		for (auto framebuffer : oldFramebuffers)
+		{
+			vkDestroyFramebuffer(device, framebuffer, nullptr);
+		}
+		for (auto imageView : oldImageViews)
+		{
+			vkDestroyImageView(device, imageView, nullptr);
+		}
+		vkDestroySwapchainKHR(device, oldSwapChain, nullptr); });
+
+	double stallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	++mFrameStats.recreateCount;
+	mFrameStats.recreateTotalMs += stallMs;
+	mFrameStats.recreateMaxMs = std::max(mFrameStats.recreateMaxMs, stallMs);
+	std::cout << "swapchain recreated (" << mSwapChainExtent.width << "x" << mSwapChainExtent.height << ") in " << stallMs << " ms" << std::endl;
+}
+
+void ApplicationFw::createSwapChain(VkSwapchainKHR oldSwapChain)
 {
 	SwapChainSupportDetails swapChainSupport = querySwapChainSupport(mPhysicalDevice);
 
 	VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
 	VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+	mPresentMode = presentMode;
 	VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
 	uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
@@ -653,7 +3313,7 @@ void ApplicationFw::createSwapChain()
 		swapChainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 		swapChainCreateInfo.presentMode = presentMode;
 		swapChainCreateInfo.clipped = VK_TRUE;
-		swapChainCreateInfo.oldSwapchain = VK_NULL_HANDLE;
+		swapChainCreateInfo.oldSwapchain = oldSwapChain;
 	}
 
 	VkResult res = vkCreateSwapchainKHR(mDevice, &swapChainCreateInfo, nullptr, &mSwapChain);
@@ -697,9 +3357,10 @@ VkPresentModeKHR ApplicationFw::chooseSwapPresentMode(const std::vector<VkPresen
 {
 	for (const auto &presentMode : availablePresentModes)
 	{
-		if (presentMode == VK_PRESENT_MODE_MAILBOX_KHR)
+		if (presentMode == mConfig.presentMode)
 			return presentMode;
 	}
+	std::cout << "present mode " << presentModeName(mConfig.presentMode) << " not supported, using fifo." << std::endl;
 	// guaranteed to be present.
 	return VK_PRESENT_MODE_FIFO_KHR;
 }
@@ -751,7 +3412,6 @@ bool ApplicationFw::checkDeviceExtensionSupport(VkPhysicalDevice device)
 {
 	uint32_t extensionCount = 0;
 	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
-	assert(extensionCount > 0);
 	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
 	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
@@ -774,28 +3434,114 @@ void ApplicationFw::createSurface()
 void ApplicationFw::createLogicalDevice()
 {
 	QueueFamilyIndices indices = findQueueFamilies(mPhysicalDevice);
-	const float queuePriority = 1.0f;
+	const float queuePriorities[] = {1.0f, 1.0f};
 
 	std::vector<VkDeviceQueueCreateInfo> deviceQueueCreateInfos;
-	std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+	std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value()};
+	if (!mConfig.headless)
+	{
+		uniqueQueueFamilies.insert(indices.presentFamily.value());
+	}
+	if (indices.transferFamily.has_value())
+	{
+		uniqueQueueFamilies.insert(indices.transferFamily.value());
+	}
+	if (indices.computeFamily.has_value())
+	{
+		uniqueQueueFamilies.insert(indices.computeFamily.value());
+	}
 
 	for (uint32_t queueFamily : uniqueQueueFamilies)
 	{
 		VkDeviceQueueCreateInfo queueCreateInfo{};
 		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
 		queueCreateInfo.queueFamilyIndex = queueFamily;
-		queueCreateInfo.queueCount = 1;
-		queueCreateInfo.pQueuePriorities = &queuePriority;
+		queueCreateInfo.queueCount = indices.computeFamily == queueFamily ? indices.computeQueueIndex + 1 : 1;
+		queueCreateInfo.pQueuePriorities = queuePriorities;
 		deviceQueueCreateInfos.push_back(queueCreateInfo);
 	}
 
+	VkPhysicalDeviceVulkan13Features supportedFeatures13{};
+	supportedFeatures13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+	VkPhysicalDeviceVulkan12Features supportedFeatures12{};
+	supportedFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	supportedFeatures12.pNext = &supportedFeatures13;
+	VkPhysicalDeviceFeatures2 supportedFeatures2{};
+	supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	supportedFeatures2.pNext = &supportedFeatures12;
+	vkGetPhysicalDeviceFeatures2(mPhysicalDevice, &supportedFeatures2);
+
+	const VkPhysicalDeviceFeatures &supportedFeatures = supportedFeatures2.features;
+	mFillModeNonSolidSupported = supportedFeatures.fillModeNonSolid == VK_TRUE;
+	mSynchronization2Supported = supportedFeatures13.synchronization2 == VK_TRUE;
+	mTimelineSemaphoreSupported = supportedFeatures12.timelineSemaphore == VK_TRUE;
+	mPipelineStatisticsSupported = mConfig.profile && supportedFeatures.pipelineStatisticsQuery == VK_TRUE;
+
+	if (mConfig.dynamicRendering && !supportedFeatures13.dynamicRendering)
+	{
+		throw std::runtime_error("device does not support dynamicRendering.");
+	}
+
+	// the render graph records its barriers with vkCmdPipelineBarrier2.
+	if (!mSynchronization2Supported)
+	{
+		throw std::runtime_error("device does not support synchronization2.");
+	}
+
+	// resources are bound through one descriptor set updated while frames are in flight, the
+	// shaders index its texture, sampler and storage buffer arrays with push constant slots.
+	if (!supportedFeatures.shaderSampledImageArrayDynamicIndexing || !supportedFeatures.shaderStorageBufferArrayDynamicIndexing ||
+		!supportedFeatures12.runtimeDescriptorArray || !supportedFeatures12.descriptorBindingPartiallyBound ||
+		!supportedFeatures12.descriptorBindingSampledImageUpdateAfterBind || !supportedFeatures12.descriptorBindingStorageBufferUpdateAfterBind ||
+		!supportedFeatures12.descriptorBindingUpdateUnusedWhilePending)
+	{
+		throw std::runtime_error("device does not support the descriptor indexing features of the descriptor heap.");
+	}
+
+	// the scene is drawn with vkCmdDrawIndexedIndirectCount, one command per visible object.
+	if (!supportedFeatures12.drawIndirectCount || !supportedFeatures.multiDrawIndirect || !supportedFeatures.drawIndirectFirstInstance)
+	{
+		throw std::runtime_error("device does not support drawIndirectCount/multiDrawIndirect/drawIndirectFirstInstance.");
+	}
+
 	VkPhysicalDeviceFeatures physicalDeviceFeatures{};
 	{
+		// wireframe pipeline variants.
+		physicalDeviceFeatures.fillModeNonSolid = supportedFeatures.fillModeNonSolid;
+		physicalDeviceFeatures.multiDrawIndirect = VK_TRUE;
+		physicalDeviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+		physicalDeviceFeatures.pipelineStatisticsQuery = mPipelineStatisticsSupported ? VK_TRUE : VK_FALSE;
+		physicalDeviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+		physicalDeviceFeatures.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+		// streamed textures are BCn, TextureStreamer rejects them where the formats are missing.
+		physicalDeviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+	}
+
+	VkPhysicalDeviceVulkan12Features features12{};
+	{
+		features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		features12.drawIndirectCount = VK_TRUE;
+		features12.timelineSemaphore = supportedFeatures12.timelineSemaphore;
+		features12.descriptorIndexing = supportedFeatures12.descriptorIndexing;
+		features12.runtimeDescriptorArray = VK_TRUE;
+		features12.descriptorBindingPartiallyBound = VK_TRUE;
+		features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		features12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+		features12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+	}
+
+	VkPhysicalDeviceVulkan13Features features13{};
+	{
+		features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+		features13.dynamicRendering = mConfig.dynamicRendering ? VK_TRUE : VK_FALSE;
+		features13.synchronization2 = VK_TRUE;
+		features13.pNext = &features12;
 	}
 
 	VkDeviceCreateInfo deviceCreateInfo{};
 	{
 		deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		deviceCreateInfo.pNext = &features13;
 		deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(deviceQueueCreateInfos.size());
 		deviceCreateInfo.pQueueCreateInfos = deviceQueueCreateInfos.data();
 		deviceCreateInfo.pEnabledFeatures = &physicalDeviceFeatures;
@@ -818,7 +3564,19 @@ void ApplicationFw::createLogicalDevice()
 
 	// Queues are implicitly created along with logical device creation.
 	vkGetDeviceQueue(mDevice, indices.graphicsFamily.value(), 0, &mGraphicsQueue);
-	vkGetDeviceQueue(mDevice, indices.presentFamily.value(), 0, &mPresentQueue);
+	if (!mConfig.headless)
+	{
+		vkGetDeviceQueue(mDevice, indices.presentFamily.value(), 0, &mPresentQueue);
+	}
+	mTransferQueue = mGraphicsQueue;
+	if (indices.transferFamily.has_value())
+	{
+		vkGetDeviceQueue(mDevice, indices.transferFamily.value(), 0, &mTransferQueue);
+	}
+	if (indices.computeFamily.has_value())
+	{
+		vkGetDeviceQueue(mDevice, indices.computeFamily.value(), indices.computeQueueIndex, &mComputeQueue);
+	}
 }
 
 QueueFamilyIndices ApplicationFw::findQueueFamilies(VkPhysicalDevice device)
@@ -836,24 +3594,42 @@ QueueFamilyIndices ApplicationFw::findQueueFamilies(VkPhysicalDevice device)
 	uint32_t i = 0;
 	for (const auto &queueFamily : queueFamilies)
 	{
-		if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+		if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && !indices.graphicsFamily.has_value())
 		{
 			indices.graphicsFamily = i;
 		}
-		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, mSurface, &presentSupport);
-		if (presentSupport)
+		// without a surface (headless) there is no present queue to look for.
+		if (mSurface != VK_NULL_HANDLE && !indices.presentFamily.has_value())
 		{
-			indices.presentFamily = i;
+			VkBool32 presentSupport = false;
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, mSurface, &presentSupport);
+			if (presentSupport)
+			{
+				indices.presentFamily = i;
+			}
 		}
-
-		if (indices.isComplete())
+		// all families are scanned, the transfer-only one usually comes after graphics.
+		const VkQueueFlags graphicsOrCompute = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+		if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & graphicsOrCompute) && !indices.transferFamily.has_value())
 		{
-			break;
+			indices.transferFamily = i;
+		}
+		// async compute engines show up as compute families without graphics.
+		if ((queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && !indices.computeFamily.has_value())
+		{
+			indices.computeFamily = i;
 		}
+
 		++i;
 	}
 
+	// otherwise a second graphics queue still lets the driver overlap the submissions.
+	if (!indices.computeFamily.has_value() && indices.graphicsFamily.has_value() && queueFamilies[indices.graphicsFamily.value()].queueCount > 1)
+	{
+		indices.computeFamily = indices.graphicsFamily;
+		indices.computeQueueIndex = 1;
+	}
+
 	return indices;
 }
 
@@ -862,11 +3638,16 @@ bool ApplicationFw::isDeviceSuitable(VkPhysicalDevice device)
 	bool suitable = false;
 
 	QueueFamilyIndices indices = findQueueFamilies(device);
-	suitable = indices.isComplete();
+	suitable = indices.isComplete(!mConfig.headless);
 
 	bool swapChainAdequate = false;
 	bool extensionsSupported = checkDeviceExtensionSupport(device);
-	if (extensionsSupported)
+	if (mConfig.headless)
+	{
+		// rendering goes to offscreen images, no presentation support needed.
+		swapChainAdequate = true;
+	}
+	else if (extensionsSupported)
 	{
 		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
 		swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
@@ -944,11 +3725,17 @@ void ApplicationFw::setupDebugMessenger()
 
 std::vector<const char *> ApplicationFw::getRequiredExtensions()
 {
-	uint32_t glfwExtensionCount = 0;
-	const char **glfwExtensions;
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	std::vector<const char *> extensions;
 
-	std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	// headless mode has no window, so no surface extensions are needed.
+	if (!mConfig.headless)
+	{
+		uint32_t glfwExtensionCount = 0;
+		const char **glfwExtensions;
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		assert(glfwExtensionCount > 0);
+		extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	}
 
 	if (enableValidationLayer)
 	{
@@ -962,7 +3749,6 @@ bool ApplicationFw::checkValidationSupport()
 {
 	uint32_t layerCount = 0;
 	vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
-	assert(layerCount > 0);
 	std::vector<VkLayerProperties> layerProperties(layerCount);
 	vkEnumerateInstanceLayerProperties(&layerCount, layerProperties.data());
 
@@ -981,75 +3767,319 @@ bool ApplicationFw::checkValidationSupport()
 		if (!layerFound)
 			return false;
 	}
-
-	return true;
-}
-
-void ApplicationFw::initWindow()
-{
-	glfwInit();
-
-	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-
-	// check for vulkan support
-	if (GLFW_FALSE == glfwVulkanSupported())
+
+	return true;
+}
+
+void ApplicationFw::initWindow()
+{
+	glfwInit();
+
+	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+
+	// check for vulkan support
+	if (GLFW_FALSE == glfwVulkanSupported())
+	{
+		// not supported
+		glfwTerminate();
+		return;
+	}
+
+	window = glfwCreateWindow(mConfig.width, mConfig.height, "Vulkan", nullptr, nullptr);
+	glfwSetWindowUserPointer(window, this);
+	glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+	glfwSetKeyCallback(window, keyCallback);
+}
+
+void ApplicationFw::initVulkan()
+{
+	createInstance();
+	setupDebugMessenger();
+	if (!mConfig.headless)
+	{
+		createSurface();
+	}
+	pickPhysicalDevice();
+	createLogicalDevice();
+	mAllocator = std::make_unique<MemoryAllocator>(mPhysicalDevice, mDevice);
+	mRenderGraph = std::make_unique<RenderGraph>(mDevice, *mAllocator, mDeletionQueue);
+	if (mConfig.benchAllocatorOperations > 0)
+	{
+		benchmarkAllocator();
+	}
+	createPipelineCache();
+	createShaderStore();
+	createDescriptorHeap();
+	if (mConfig.headless)
+	{
+		createOffscreenImages();
+	}
+	else
+	{
+		createSwapChain();
+	}
+	createImageViews();
+	if (!mConfig.dynamicRendering)
+	{
+		createRenderPass();
+	}
+	createGraphicsPipeline();
+	if (!mConfig.dynamicRendering)
+	{
+		createFramebuffers();
+	}
+	// before the reloader thread starts, it builds pipelines against mRenderPass too.
+	if (mConfig.benchAttachmentRebuilds > 0)
+	{
+		benchmarkAttachmentRebuild();
+	}
+	if (mConfig.hotReload)
+	{
+		createShaderReloader();
+	}
+	createCommandPool();
+	createCommandBuffer();
+	createSyncObjects();
+	if (mConfig.asyncCompute || mConfig.benchAsyncCompute)
+	{
+		createAsyncCompute();
+	}
+	createFrameArena();
+	if (mConfig.cpuDraws)
+	{
+		mDrawQueue = std::make_unique<DrawQueue>(mConfig.sortThreads);
+	}
+	if (mConfig.benchArenaTransforms > 0)
+	{
+		benchmarkFrameArena();
+	}
+	if (mConfig.profile)
+	{
+		createProfiler();
+	}
+	createUploader();
+	if (mConfig.benchUploadMegabytes > 0)
+	{
+		benchmarkUpload();
+	}
+	loadMesh();
+	createGeometryBuffers();
+	createScene(mConfig.objectCount);
+	if (!mConfig.texturePaths.empty())
+	{
+		createTextureStreamer();
+	}
+	if (mConfig.readback)
+	{
+		createReadbackBuffers();
+	}
+}
+
+void ApplicationFw::mainLoop()
+{
+	if (mConfig.benchCulling)
+	{
+		runCullingBenchmark();
+		return;
+	}
+	if (mConfig.benchAsyncCompute)
+	{
+		runAsyncComputeBenchmark();
+		return;
+	}
+	if (mConfig.benchRecording)
+	{
+		runRecordingBenchmark();
+		return;
+	}
+	if (mConfig.benchVertexLayouts)
+	{
+		runVertexLayoutBenchmark();
+		return;
+	}
+	if (mConfig.benchBatching)
+	{
+		runBatchingBenchmark();
+		return;
+	}
+	if (mConfig.benchDrawSort)
 	{
-		// not supported
-		glfwTerminate();
+		runDrawSortBenchmark();
 		return;
 	}
 
-	window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
-}
-
-void ApplicationFw::initVulkan()
-{
-	createInstance();
-	setupDebugMessenger();
-	createSurface();
-	pickPhysicalDevice();
-	createLogicalDevice();
-	createSwapChain();
-	createImageViews();
-	createRenderPass();
-	createGraphicsPipeline();
-	createFramebuffers();
-	createCommandPool();
-	createCommandBuffer();
-	createSyncObjects();
-}
-
-void ApplicationFw::mainLoop()
-{
-	while (!glfwWindowShouldClose(window))
+	while (mConfig.headless || !glfwWindowShouldClose(window))
 	{
-		glfwPollEvents();
+		mPacer.limit();
+		if (!mConfig.headless)
+		{
+			auto pollStart = std::chrono::steady_clock::now();
+			glfwPollEvents();
+			mPacer.markPoll(pollStart, std::chrono::steady_clock::now());
+		}
 		drawFrame();
+
+		if (mConfig.maxFrames > 0 && mFrameStats.frameCount >= mConfig.maxFrames)
+			break;
 	}
 
 	vkDeviceWaitIdle(mDevice);
+	if (mConfig.readback)
+	{
+		collectReadbacks();
+		reportReadbackStats();
+	}
+	reportFrameStats();
+	mPacer.report(mConfig.headless ? "headless" : presentModeName(mPresentMode));
+
+	if (mProfiler)
+	{
+		mProfiler->collectPending();
+		mProfiler->report();
+		if (!mConfig.traceFile.empty())
+		{
+			bool written = mProfiler->writeChromeTrace(mConfig.traceFile);
+			std::cout << "trace: " << (written ? "wrote " : "failed to write ") << mConfig.traceFile << std::endl;
+		}
+	}
 }
 
 void ApplicationFw::cleanup()
 {
-	vkDestroySemaphore(mDevice, mImageAvailableSemaphore, nullptr);
-	vkDestroySemaphore(mDevice, mRenderFinishedSemaphore, nullptr);
-	vkDestroyFence(mDevice, mInFlightFence, nullptr);
+	// the device is idle here, nothing retired is still in use.
+	mDeletionQueue.flushAll();
+
+	for (auto &readback : mReadbackBuffers)
+	{
+		vkDestroyBuffer(mDevice, readback.buffer, nullptr);
+		mAllocator->free(readback.allocation);
+	}
+
+	for (auto &frame : mFrames)
+	{
+		vkDestroySemaphore(mDevice, frame.imageAvailableSemaphore, nullptr);
+		vkDestroyFence(mDevice, frame.inFlightFence, nullptr);
+		vkDestroyCommandPool(mDevice, frame.commandPool, nullptr);
+	}
+	for (auto semaphore : mRenderFinishedSemaphores)
+	{
+		vkDestroySemaphore(mDevice, semaphore, nullptr);
+	}
+	mRecorder.reset();
+	mProfiler.reset();
 
 	vkDestroyCommandPool(mDevice, mCommandPool, nullptr);
 	for (auto framebuffer : mSwapChainFramebuffers)
 	{
 		vkDestroyFramebuffer(mDevice, framebuffer, nullptr);
 	}
-	vkDestroyPipeline(mDevice, mGraphicsPipeline, nullptr);
+	// stops the watcher thread, a program it built but never handed over is destroyed with it.
+	if (mShaderReloader)
+	{
+		std::cout << "shader reloads: " << mShaderReloader->reloadCount() << ", failed: " << mShaderReloader->failedCount() << std::endl;
+		mShaderReloader.reset();
+	}
+	for (RetiredProgram &retired : mRetiredPrograms)
+	{
+		retired.compiler->destroyPipelines();
+		vkDestroyShaderModule(mDevice, retired.fragmentModule, nullptr);
+		vkDestroyShaderModule(mDevice, retired.vertexModule, nullptr);
+	}
+	mRetiredPrograms.clear();
+	// owns mGraphicsPipeline and every compiled variant.
+	PipelineCompilerStats compilerStats = mPipelineCompiler->stats();
+	std::cout << "pipeline variants compiled: " << compilerStats.compiled << ", failed: " << compilerStats.failed
+			  << ", total compile ms: " << compilerStats.compileMs << std::endl;
+	mPipelineCompiler->destroyPipelines();
+	mPipelineCompiler.reset();
+	if (!mShaderStore->owns(mFragmentShaderModule))
+	{
+		vkDestroyShaderModule(mDevice, mFragmentShaderModule, nullptr);
+	}
+	if (!mShaderStore->owns(mVertexShaderModule))
+	{
+		vkDestroyShaderModule(mDevice, mVertexShaderModule, nullptr);
+	}
+	for (auto &renderPass : mVariantRenderPasses)
+	{
+		vkDestroyRenderPass(mDevice, renderPass.second, nullptr);
+	}
+	savePipelineCache();
+	vkDestroyPipelineCache(mDevice, mPipelineCache, nullptr);
 	vkDestroyPipelineLayout(mDevice, mPipelineLayout, nullptr);
-	vkDestroyRenderPass(mDevice, mRenderPass, nullptr);
+	if (mRenderPass != VK_NULL_HANDLE)
+	{
+		vkDestroyRenderPass(mDevice, mRenderPass, nullptr);
+	}
 	for (auto imageView : mSwapChainImageViews)
 	{
 		vkDestroyImageView(mDevice, imageView, nullptr);
 	}
-	vkDestroySwapchainKHR(mDevice, mSwapChain, nullptr);
+	if (mConfig.headless)
+	{
+		for (size_t i = 0; i < mSwapChainImages.size(); ++i)
+		{
+			vkDestroyImage(mDevice, mSwapChainImages[i], nullptr);
+			mAllocator->free(mOffscreenImageMemory[i]);
+		}
+	}
+	else
+	{
+		vkDestroySwapchainKHR(mDevice, mSwapChain, nullptr);
+	}
+	const UploadStats &uploadStats = mUploader->stats();
+	std::cout << "uploads: " << uploadStats.byteCount / 1024 << " KiB in " << uploadStats.batchCount << " batches, "
+			  << uploadStats.megabytesPerSecond() << " MB/s" << std::endl;
+	mCuller.reset();
+	ShaderStoreStats shaderStats = mShaderStore->stats();
+	std::cout << "shader modules: " << shaderStats.modulesCreated << " created, " << shaderStats.cacheHits << " shared" << std::endl;
+	mShaderStore.reset();
+	DescriptorHeapStats heapStats = mDescriptorHeap->stats();
+	std::cout << "descriptor heap: " << heapStats.writeCount << " writes, slots used: " << heapStats.used[0] << "/" << heapStats.capacity[0] << " images, "
+			  << heapStats.used[1] << "/" << heapStats.capacity[1] << " buffers, " << heapStats.used[2] << "/" << heapStats.capacity[2] << " samplers" << std::endl;
+	FrameArenaStats arenaStats = mFrameArena->stats();
+	std::cout << "frame arena: " << arenaStats.allocationCount << " allocations, " << arenaStats.allocatedBytes / 1024 << " KiB, peak "
+			  << arenaStats.peakFrameBytes / 1024 << " of " << mFrameArena->frameCapacity() / 1024 << " KiB per frame" << std::endl;
+	mFrameArena.reset();
+	const RenderGraphStats &graphStats = mRenderGraph->stats();
+	std::cout << "render graph: " << graphStats.passCount << " passes, " << graphStats.culledPassCount << " culled, "
+			  << graphStats.barrierBatchCount << " barrier batches, " << graphStats.imageBarrierCount << " image and "
+			  << graphStats.bufferBarrierCount << " buffer barriers, transients " << graphStats.aliasedBytes / 1024 << " of "
+			  << graphStats.transientBytes / 1024 << " KiB" << std::endl;
+	mRenderGraph.reset();
+	if (mTextureStreamer)
+	{
+		// the device is idle, every upload landed.
+		mTextureStreamer->retire(mFrameNumber);
+		const TextureStreamerStats &textureStats = mTextureStreamer->stats();
+		std::cout << "texture streaming: " << textureStats.residentBytes / 1024 << " KiB resident (peak " << textureStats.peakResidentBytes / 1024
+				  << ") of " << textureStats.requestedBytes / 1024 << " KiB requested, " << textureStats.uploadedBytes / 1024 << " KiB uploaded, "
+				  << textureStats.reallocationCount << " reallocations, " << textureStats.evictedLevels << " levels evicted" << std::endl;
+		for (uint32_t level = 0; level < TextureStreamerStats::kMaxLevels; ++level)
+		{
+			if (textureStats.levelUploads[level] == 0)
+				continue;
+			std::cout << "  mip " << level << ": " << textureStats.levelUploads[level] << " uploads, latency avg "
+					  << textureStats.levelLatencyMs[level] / textureStats.levelUploads[level] << " ms, max " << textureStats.levelMaxLatencyMs[level] << " ms" << std::endl;
+		}
+		mTextureStreamer.reset();
+	}
+	if (mAsyncCompute)
+	{
+		const AsyncComputeStats &computeStats = mAsyncCompute->stats();
+		std::cout << "async compute: " << computeStats.submitCount << " submits, " << computeStats.waitCount << " waited on graphics, host wait ms: "
+				  << computeStats.hostWaitMs << std::endl;
+		mAsyncCompute.reset();
+		mComputeGraph.reset();
+		vkDestroySemaphore(mDevice, mGraphicsTimeline, nullptr);
+	}
+	mDescriptorHeap.reset();
+	vkDestroySampler(mDevice, mDefaultSampler, nullptr);
+	mUploader.reset();
+	destroyGeometryBuffers();
+	reportMemoryStats();
+	mAllocator.reset();
 	vkDestroyDevice(mDevice, nullptr);
 
 	if (enableValidationLayer)
@@ -1057,11 +4087,17 @@ void ApplicationFw::cleanup()
 		DestroyDebugUtilsMessengerEXT(mInstance, mDebugMessenger, nullptr);
 	}
 
-	vkDestroySurfaceKHR(mInstance, mSurface, nullptr);
+	if (mSurface != VK_NULL_HANDLE)
+	{
+		vkDestroySurfaceKHR(mInstance, mSurface, nullptr);
+	}
 
 	vkDestroyInstance(mInstance, nullptr);
-	glfwDestroyWindow(window);
-	glfwTerminate();
+	if (window != nullptr)
+	{
+		glfwDestroyWindow(window);
+		glfwTerminate();
+	}
 }
 
 void ApplicationFw::createInstance()
@@ -1078,18 +4114,16 @@ void ApplicationFw::createInstance()
 		applicationInfo.apiVersion = VK_API_VERSION_1_3;
 	}
 
-	uint32_t glfwExtensionCount = 0;
-	const char **glfwExtensionsName;
-	glfwExtensionsName = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-	assert(glfwExtensionCount > 0);
-
-	std::vector<const char *> requiredExtensions = getRequiredExtensions();
-	for (uint32_t i = 0; i < glfwExtensionCount; i++)
+	// check for validation layer support.
+	bool isValidationLayerSupported = enableValidationLayer && checkValidationSupport();
+	if (enableValidationLayer && !isValidationLayerSupported)
 	{
-		requiredExtensions.emplace_back(glfwExtensionsName[i]);
+		// plain containers usually ship without the Khronos layers, run without them.
+		std::cout << "validation layer requested but not available, continuing without it." << std::endl;
+		enableValidationLayer = false;
 	}
 
-	requiredExtensions.emplace_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
+	std::vector<const char *> requiredExtensions = getRequiredExtensions();
 
 	// check available instance extension properties.
 	uint32_t instanceExtensionCount = 0;
@@ -1099,22 +4133,30 @@ void ApplicationFw::createInstance()
 	vkEnumerateInstanceExtensionProperties(nullptr, &instanceExtensionCount,
 										   extensions.data());
 
+	bool portabilityEnumerationSupported = false;
 	std::cout << "Available Instance Extensions...." << std::endl;
 	for (const auto &extension : extensions)
 	{
 		std::cout << "\t" << extension.extensionName << std::endl;
+		if (strcmp(extension.extensionName, VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME) == 0)
+			portabilityEnumerationSupported = true;
 	}
 
-	// check for validation layer support.
-	bool isValidationLayerSupported = checkValidationSupport();
-	assert(isValidationLayerSupported);
+	// only needed on portability implementations (MoltenVK), not every loader exposes it.
+	if (portabilityEnumerationSupported)
+	{
+		requiredExtensions.emplace_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
+	}
 
 	VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo{};
 	VkInstanceCreateInfo instanceCreateInfo{};
 	{
 		instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 		instanceCreateInfo.pNext = NULL;
-		instanceCreateInfo.flags |= VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
+		if (portabilityEnumerationSupported)
+		{
+			instanceCreateInfo.flags |= VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
+		}
 		instanceCreateInfo.pApplicationInfo = &applicationInfo;
 		instanceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(requiredExtensions.size());
 		instanceCreateInfo.ppEnabledExtensionNames = requiredExtensions.data();
@@ -1137,12 +4179,474 @@ void ApplicationFw::createInstance()
 	assert(res == VK_SUCCESS);
 }
 
-int main()
+AppConfig parseCommandLine(int argc, char **argv)
+{
+	AppConfig config;
+	bool vertexLayoutSet = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		auto nextValue = [&]() -> std::string
+		{
+			if (i + 1 >= argc)
+				throw std::runtime_error("missing value for " + arg);
+			return argv[++i];
+		};
+
+		if (arg == "--frames")
+		{
+			config.framesInFlight = static_cast<uint32_t>(std::stoul(nextValue()));
+			if (config.framesInFlight == 0)
+				throw std::runtime_error("--frames must be at least 1");
+		}
+		else if (arg == "--max-frames")
+		{
+			config.maxFrames = std::stoull(nextValue());
+		}
+		else if (arg == "--headless")
+		{
+			config.headless = true;
+		}
+		else if (arg == "--width")
+		{
+			config.width = static_cast<uint32_t>(std::stoul(nextValue()));
+			if (config.width == 0)
+				throw std::runtime_error("--width must be at least 1");
+		}
+		else if (arg == "--height")
+		{
+			config.height = static_cast<uint32_t>(std::stoul(nextValue()));
+			if (config.height == 0)
+				throw std::runtime_error("--height must be at least 1");
+		}
+		else if (arg == "--no-validation")
+		{
+			config.enableValidation = false;
+		}
+		else if (arg == "--readback")
+		{
+			config.readback = true;
+		}
+		else if (arg == "--pipeline-cache")
+		{
+			config.pipelineCachePath = nextValue();
+		}
+		else if (arg == "--compile-threads")
+		{
+			config.compileThreads = std::max(1u, static_cast<uint32_t>(std::stoul(nextValue())));
+		}
+		else if (arg == "--prewarm-variants")
+		{
+			config.prewarmVariants = true;
+		}
+		else if (arg == "--dynamic-rendering")
+		{
+			config.dynamicRendering = true;
+		}
+		else if (arg == "--bench-attachments")
+		{
+			config.benchAttachmentRebuilds = static_cast<uint32_t>(std::stoul(nextValue()));
+		}
+		else if (arg == "--bench-allocator")
+		{
+			config.benchAllocatorOperations = static_cast<uint32_t>(std::stoul(nextValue()));
+		}
+		else if (arg == "--bench-upload")
+		{
+			config.benchUploadMegabytes = static_cast<uint32_t>(std::stoul(nextValue()));
+		}
+		else if (arg == "--frame-arena-kb")
+		{
+			config.frameArenaKilobytes = static_cast<uint32_t>(std::stoul(nextValue()));
+		}
+		else if (arg == "--bench-arena")
+		{
+			config.benchArenaTransforms = static_cast<uint32_t>(std::stoul(nextValue()));
+		}
+		else if (arg == "--objects")
+		{
+			config.objectCount = std::max(1u, static_cast<uint32_t>(std::stoul(nextValue())));
+		}
+		else if (arg == "--bench-culling")
+		{
+			config.benchCulling = true;
+		}
+		else if (arg == "--async-compute")
+		{
+			config.asyncCompute = true;
+		}
+		else if (arg == "--bench-async-compute")
+		{
+			config.benchAsyncCompute = true;
+		}
+		else if (arg == "--cpu-draws")
+		{
+			config.cpuDraws = true;
+		}
+		else if (arg == "--cpu-transforms")
+		{
+			config.cpuTransforms = true;
+			config.cpuDraws = true;
+		}
+		else if (arg == "--bench-transforms")
+		{
+			config.benchTransforms = true;
+		}
+		else if (arg == "--bench-mesh-load")
+		{
+			config.benchMeshLoad = nextValue();
+		}
+		else if (arg == "--mesh")
+		{
+			config.meshPath = nextValue();
+		}
+		else if (arg == "--vertex-layout")
+		{
+			std::string name = nextValue();
+			config.vertexLayout = VertexLayout::findPreset(name);
+			if (config.vertexLayout == VertexLayoutPreset::Count)
+				throw std::runtime_error("unknown vertex layout: " + name);
+			vertexLayoutSet = true;
+		}
+		else if (arg == "--bench-vertex-layouts")
+		{
+			config.benchVertexLayouts = true;
+		}
+		else if (arg == "--record-threads")
+		{
+			config.recordThreads = static_cast<uint32_t>(std::stoul(nextValue()));
+		}
+		else if (arg == "--bench-recording")
+		{
+			// measures recording of the per-object draw list.
+			config.benchRecording = true;
+			config.cpuDraws = true;
+		}
+		else if (arg == "--no-batching")
+		{
+			config.batchInstances = false;
+		}
+		else if (arg == "--bench-batching")
+		{
+			config.benchBatching = true;
+			config.cpuDraws = true;
+		}
+		else if (arg == "--no-draw-sort")
+		{
+			config.sortDraws = false;
+		}
+		else if (arg == "--sort-threads")
+		{
+			config.sortThreads = static_cast<uint32_t>(std::stoul(nextValue()));
+		}
+		else if (arg == "--draw-pipelines")
+		{
+			config.drawPipelines = static_cast<uint32_t>(std::stoul(nextValue()));
+			if (config.drawPipelines < 1 || config.drawPipelines > 3)
+				throw std::runtime_error("--draw-pipelines must be 1 to 3.");
+		}
+		else if (arg == "--bench-draw-sort")
+		{
+			config.benchDrawSort = true;
+			config.cpuDraws = true;
+		}
+		else if (arg == "--texture")
+		{
+			config.texturePaths.push_back(nextValue());
+		}
+		else if (arg == "--texture-budget-mb")
+		{
+			config.textureBudgetMegabytes = static_cast<uint32_t>(std::stoul(nextValue()));
+		}
+		else if (arg == "--texture-threads")
+		{
+			config.textureThreads = std::max(1u, static_cast<uint32_t>(std::stoul(nextValue())));
+		}
+		else if (arg == "--present-mode")
+		{
+			std::string name = nextValue();
+			const VkPresentModeKHR presentModes[] = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR,
+													 VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+			auto found = std::find_if(std::begin(presentModes), std::end(presentModes), [&](VkPresentModeKHR presentMode)
+									  { return name == presentModeName(presentMode); });
+			if (found == std::end(presentModes))
+				throw std::runtime_error("unknown present mode: " + name);
+			config.presentMode = *found;
+		}
+		else if (arg == "--target-fps")
+		{
+			config.targetFps = std::stod(nextValue());
+		}
+		else if (arg == "--shader-archive")
+		{
+			config.shaderArchive = nextValue();
+		}
+		else if (arg == "--pack-shaders")
+		{
+			// --pack-shaders ARCHIVE FILE..., the rest of the command line are the inputs.
+			config.shaderArchive = nextValue();
+			config.packShaderFiles.assign(argv + i + 1, argv + argc);
+			if (config.packShaderFiles.empty())
+				throw std::runtime_error("--pack-shaders needs at least one .spv file");
+			break;
+		}
+		else if (arg == "--hot-reload")
+		{
+			config.hotReload = true;
+		}
+		else if (arg == "--profile")
+		{
+			config.profile = true;
+		}
+		else if (arg == "--trace")
+		{
+			config.traceFile = nextValue();
+			config.profile = true;
+		}
+		else
+		{
+			throw std::runtime_error("unknown option: " + arg);
+		}
+	}
+
+	if (config.readback && !config.headless)
+	{
+		throw std::runtime_error("--readback requires --headless");
+	}
+
+	if (!config.meshPath.empty() && !vertexLayoutSet)
+	{
+		config.vertexLayout = VertexLayoutPreset::Packed;
+	}
+
+	// headless runs have no window to close, so they always stop after a fixed number of frames.
+	if (config.headless && config.maxFrames == 0)
+	{
+		config.maxFrames = 1000;
+	}
+
+	return config;
+}
+
+// per-object glm math over an array of transforms against the InstanceStore batch kernels, CPU only.
+void benchmarkInstanceTransforms()
+{
+	using clock = std::chrono::steady_clock;
+	const uint32_t instanceCounts[] = {10000, 100000, 1000000};
+	const glm::vec3 boundsCenter(0.0f);
+	const glm::vec3 boundsExtent(0.5f, 0.5f, 0.0f);
+
+	glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 200.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::vec4 planes[6];
+	GpuCuller::extractFrustumPlanes(proj * view, planes);
+
+	std::cout << "instance transforms: " << InstanceStore::simdName() << ", " << InstanceStore::kSimdWidth << " lanes" << std::endl;
+	for (uint32_t count : instanceCounts)
+	{
+		std::mt19937 rng(1234);
+		std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::vector<InstanceTransform> transforms(count);
+		InstanceStore store;
+		store.reserve(count);
+		for (auto &transform : transforms)
+		{
+			glm::vec4 rotation(unit(rng), unit(rng), unit(rng), unit(rng));
+			float length = std::sqrt(rotation.x * rotation.x + rotation.y * rotation.y + rotation.z * rotation.z + rotation.w * rotation.w);
+			transform.position = glm::vec3(position(rng), position(rng), position(rng));
+			transform.rotation = glm::vec4(rotation.x / length, rotation.y / length, rotation.z / length, rotation.w / length);
+			transform.scale = glm::vec3(0.75f + unit(rng) * 0.25f);
+			store.add(transform, boundsCenter, boundsExtent);
+		}
+
+		std::vector<glm::mat4> matrices(count);
+		std::vector<glm::vec4> spheres(count);
+		std::vector<uint32_t> visible(count);
+		uint32_t repeats = std::max(3u, 10000000u / count);
+
+		// matrix, world box and bounding sphere per object, the way the renderer would without the store.
+		auto start = clock::now();
+		for (uint32_t r = 0; r < repeats; ++r)
+		{
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				const InstanceTransform &transform = transforms[i];
+				glm::quat rotation(transform.rotation.w, transform.rotation.x, transform.rotation.y, transform.rotation.z);
+				glm::mat4 model = glm::translate(glm::mat4(1.0f), transform.position) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.0f), transform.scale);
+				matrices[i] = model;
+
+				glm::vec4 center = model * glm::vec4(boundsCenter, 1.0f);
+				glm::vec3 extent;
+				for (int row = 0; row < 3; ++row)
+				{
+					extent[row] = std::fabs(model[0][row]) * boundsExtent.x + std::fabs(model[1][row]) * boundsExtent.y + std::fabs(model[2][row]) * boundsExtent.z;
+				}
+				spheres[i] = glm::vec4(center.x, center.y, center.z, glm::length(extent));
+			}
+		}
+		double scalarTransformNs = std::chrono::duration<double, std::nano>(clock::now() - start).count() / (static_cast<double>(repeats) * count);
+
+		start = clock::now();
+		uint32_t scalarVisible = 0;
+		for (uint32_t r = 0; r < repeats; ++r)
+		{
+			scalarVisible = 0;
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				const glm::vec4 &sphere = spheres[i];
+				bool inside = true;
+				for (int p = 0; p < 6 && inside; ++p)
+				{
+					inside = glm::dot(glm::vec3(planes[p].x, planes[p].y, planes[p].z), glm::vec3(sphere.x, sphere.y, sphere.z)) + planes[p].w >= -sphere.w;
+				}
+				if (inside)
+				{
+					visible[scalarVisible++] = i;
+				}
+			}
+		}
+		double scalarCullNs = std::chrono::duration<double, std::nano>(clock::now() - start).count() / (static_cast<double>(repeats) * count);
+
+		start = clock::now();
+		for (uint32_t r = 0; r < repeats; ++r)
+		{
+			store.computeTransforms(matrices.data());
+		}
+		double simdTransformNs = std::chrono::duration<double, std::nano>(clock::now() - start).count() / (static_cast<double>(repeats) * count);
+
+		start = clock::now();
+		uint32_t simdVisible = 0;
+		for (uint32_t r = 0; r < repeats; ++r)
+		{
+			simdVisible = store.cullSpheres(planes, visible.data());
+		}
+		double simdCullNs = std::chrono::duration<double, std::nano>(clock::now() - start).count() / (static_cast<double>(repeats) * count);
+
+		std::cout << count << " instances: transform glm " << scalarTransformNs << " ns, batched " << simdTransformNs << " ns ("
+				  << scalarTransformNs / simdTransformNs << "x); cull glm " << scalarCullNs << " ns, batched " << simdCullNs << " ns ("
+				  << scalarCullNs / simdCullNs << "x); visible " << scalarVisible << "/" << simdVisible << std::endl;
+	}
+}
+
+// OBJ text parsing against mapping the packed mesh, both ending with the vertex and index
+// streams copied into one buffer the way an upload copies them into staging memory. CPU only.
+void benchmarkMeshLoad(const std::string &objPath)
 {
-	ApplicationFw app;
+	using clock = std::chrono::steady_clock;
+	const uint32_t runCount = 10;
+	const MeshStream uploadedStreams[] = {MeshStream::Position, MeshStream::Normal, MeshStream::Uv, MeshStream::Index};
+
+	std::string meshPath = objPath + ".mesh";
+	MeshFile::write(meshPath, MeshFile::importObj(objPath));
+
+	// stands in for the staging ring, sized up front so neither path pays for it.
+	std::vector<uint8_t> staging;
+	auto copyStreams = [&](const MeshFile &mesh)
+	{
+		size_t offset = 0;
+		for (MeshStream type : uploadedStreams)
+		{
+			const MeshFile::Stream &stream = mesh.stream(type);
+			if (!stream.data)
+				continue;
+			if (offset + stream.size > staging.size())
+			{
+				staging.resize(offset + stream.size);
+			}
+			std::memcpy(staging.data() + offset, stream.data, stream.size);
+			offset += stream.size;
+		}
+	};
+
+	MeshFileHeader header;
+	size_t objBytes = 0;
+	size_t meshBytes = 0;
+	{
+		MappedFile objFile;
+		MappedFile meshFile;
+		objFile.open(objPath);
+		meshFile.open(meshPath);
+		objBytes = objFile.size();
+		meshBytes = meshFile.size();
+
+		MeshFile mesh;
+		mesh.open(meshPath);
+		header = mesh.header();
+		copyStreams(mesh);
+	}
+
+	// the first run of each path warms the page cache and is not counted.
+	double parseMs = 0.0, packMs = 0.0, textCopyMs = 0.0;
+	for (uint32_t run = 0; run <= runCount; ++run)
+	{
+		auto start = clock::now();
+		MeshData data = MeshFile::importObj(objPath);
+		auto parsed = clock::now();
+		std::vector<uint8_t> image = MeshFile::pack(data);
+		MeshFile mesh;
+		mesh.open(image.data(), image.size(), objPath);
+		auto packed = clock::now();
+		copyStreams(mesh);
+		auto copied = clock::now();
+		if (run > 0)
+		{
+			parseMs += std::chrono::duration<double, std::milli>(parsed - start).count();
+			packMs += std::chrono::duration<double, std::milli>(packed - parsed).count();
+			textCopyMs += std::chrono::duration<double, std::milli>(copied - packed).count();
+		}
+	}
+
+	double mapMs = 0.0, meshCopyMs = 0.0;
+	for (uint32_t run = 0; run <= runCount; ++run)
+	{
+		auto start = clock::now();
+		MeshFile mesh;
+		mesh.open(meshPath);
+		auto mapped = clock::now();
+		copyStreams(mesh);
+		auto copied = clock::now();
+		if (run > 0)
+		{
+			mapMs += std::chrono::duration<double, std::milli>(mapped - start).count();
+			meshCopyMs += std::chrono::duration<double, std::milli>(copied - mapped).count();
+		}
+	}
+
+	double textMs = (parseMs + packMs + textCopyMs) / runCount;
+	double meshMs = (mapMs + meshCopyMs) / runCount;
+	std::cout << "mesh load: " << objPath << ", " << header.vertexCount << " vertices, " << header.indexCount / 3 << " triangles, "
+			  << header.meshletCount << " meshlets; OBJ " << objBytes / 1024 << " KiB, packed " << meshBytes / 1024 << " KiB" << std::endl;
+	std::cout << "  text: parse " << parseMs / runCount << " ms + pack " << packMs / runCount << " ms + copy " << textCopyMs / runCount
+			  << " ms = " << textMs << " ms" << std::endl;
+	std::cout << "  packed: map " << mapMs / runCount << " ms + copy " << meshCopyMs / runCount << " ms = " << meshMs << " ms ("
+			  << (meshMs > 0.0 ? textMs / meshMs : 0.0) << "x)" << std::endl;
+}
 
+int main(int argc, char **argv)
+{
 	try
 	{
+		AppConfig config = parseCommandLine(argc, argv);
+		if (!config.packShaderFiles.empty())
+		{
+			ShaderStore::writeArchive(config.shaderArchive, config.packShaderFiles);
+			std::cout << "packed " << config.packShaderFiles.size() << " shaders into " << config.shaderArchive << std::endl;
+			return EXIT_SUCCESS;
+		}
+		if (config.benchTransforms)
+		{
+			benchmarkInstanceTransforms();
+			return EXIT_SUCCESS;
+		}
+		if (!config.benchMeshLoad.empty())
+		{
+			benchmarkMeshLoad(config.benchMeshLoad);
+			return EXIT_SUCCESS;
+		}
+
+		ApplicationFw app(config);
 		app.run();
 	}
 	catch (const std::exception &e)
@@ -12,6 +12,13 @@ source setup-env.sh
 popd
 
 echo "VULKAN SDK: " $VULKAN_SDK
-clang++ -g -O2 -std=c++17 -stdlib=libc++ -lglfw -lvulkan -framework CoreVideo -framework IOKit -framework Cocoa glfw_test_vulkan.cpp -o vulkan_glfw
-
+$VULKAN_SDK/bin/glslc shader.vert -o shader.vert.spv
+$VULKAN_SDK/bin/glslc shader.frag -o shader.frag.spv
+$VULKAN_SDK/bin/glslc depth.vert -o depth.vert.spv
+$VULKAN_SDK/bin/glslc cull.comp -o cull.comp.spv
+clang++ -g -O2 -std=c++17 -stdlib=libc++ -lglfw -lvulkan -lshaderc_combined -framework CoreVideo -framework IOKit -framework Cocoa glfw_test_vulkan.cpp AsyncCompute.cpp DeletionQueue.cpp DescriptorHeap.cpp DrawQueue.cpp FrameArena.cpp FramePacer.cpp GpuCuller.cpp GpuProfiler.cpp InstanceStore.cpp MemoryAllocator.cpp MeshFile.cpp ParallelRecorder.cpp PipelineCompiler.cpp RenderGraph.cpp ShaderReloader.cpp ShaderStore.cpp StagingUploader.cpp TextureStreamer.cpp ThreadPool.cpp VertexLayout.cpp -o vulkan_glfw
+# offline OBJ to packed mesh converter, see MeshFile.h.
+clang++ -g -O2 -std=c++17 -stdlib=libc++ -lvulkan mesh_convert.cpp MeshFile.cpp ShaderStore.cpp VertexLayout.cpp -o mesh_convert
+# shaders are loaded from one memory-mapped archive, loose .spv files are the fallback.
+./vulkan_glfw --pack-shaders shaders.spva shader.vert.spv shader.frag.spv depth.vert.spv cull.comp.spv
 
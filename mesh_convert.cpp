@@ -0,0 +1,43 @@
+// Offline converter from Wavefront OBJ to the packed mesh format vulkan_glfw loads.
+// usage: mesh_convert input.obj output.mesh
+
+#include "MeshFile.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+int main(int argc, char **argv)
+{
+	if (argc != 3)
+	{
+		std::cerr << "usage: " << argv[0] << " input.obj output.mesh" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	try
+	{
+		auto start = std::chrono::steady_clock::now();
+		MeshData mesh = MeshFile::importObj(argv[1]);
+		MeshFile::write(argv[2], mesh);
+		double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		// read back through the loader, so a file that converts also loads.
+		MeshFile packed;
+		if (!packed.open(argv[2]))
+			throw std::runtime_error("cannot map " + std::string(argv[2]) + ".");
+
+		const MeshFileHeader &header = packed.header();
+		std::cout << argv[2] << ": " << header.vertexCount << " vertices, " << header.indexCount / 3 << " triangles, "
+				  << header.meshletCount << " meshlets, " << (packed.stream(MeshStream::Uv).data ? "with" : "without") << " uvs, "
+				  << (packed.indexType() == VK_INDEX_TYPE_UINT16 ? "16" : "32") << "-bit indices, converted in " << totalMs << " ms" << std::endl;
+	}
+	catch (const std::exception &e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
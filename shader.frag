@@ -1,6 +1,32 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(set = 0, binding = 0) uniform texture2D textures[];
+layout(set = 0, binding = 2) uniform sampler samplers[];
+
+layout(push_constant) uniform Push {
+  uint frameData;
+  uint camera;
+  uint objectBuffer;
+  uint texture;
+  uint samplerIndex;
+  uint transforms;
+  vec2 uvOffset;
+  vec2 uvScale;
+  uint instances;
+  float positionScale;
+  float positionOffset[3];
+} pc;
 
 layout(location = 0) out vec4 outColor;
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragUv;
 
-void main() { outColor = vec4(fragColor, 1.0); }
\ No newline at end of file
+void main() {
+  vec4 color = vec4(fragColor, 1.0);
+  // 0xffffffff marks an untextured draw.
+  if (pc.texture != 0xffffffffu) {
+    color *= texture(sampler2D(textures[pc.texture], samplers[pc.samplerIndex]), fragUv);
+  }
+  outColor = color;
+}
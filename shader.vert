@@ -1,13 +1,71 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
-vec2 positions[3] = vec2[](vec2(0.0, -0.5), vec2(0.5, 0.5), vec2(-0.5, 0.5));
+// set per vertex layout, see VertexLayout.h: normals are either xyz or octahedral xy.
+layout(constant_id = 0) const bool kOctahedralNormals = false;
 
-vec3 colors[3] =
-    vec3[](vec3(1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0), vec3(0.0, 0.0, 1.0));
+// stored position, mapped into [-0.5, 0.5] with pc.positionScale and pc.positionOffset.
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+// per instance: xyz center, w radius, written by the culling pass.
+layout(location = 2) in vec4 inInstance;
+// stored uv, mapped back with pc.uvScale and pc.uvOffset.
+layout(location = 3) in vec2 inUv;
+
+// frame arena buffers, the camera is viewProj, view, proj and viewInverse starting at pc.camera.
+layout(std430, set = 0, binding = 1) readonly buffer Matrices { mat4 matrices[]; } buffers[];
+// the same storage buffers seen as the object spheres and as the batched instance lists.
+layout(std430, set = 0, binding = 1) readonly buffer Objects { vec4 spheres[]; } objectBuffers[];
+layout(std430, set = 0, binding = 1) readonly buffer Instances { uint objects[]; } instanceBuffers[];
+
+// resources are slots in the descriptor heap, see DrawPushConstants.
+layout(push_constant) uniform Push {
+  uint frameData;
+  uint camera;
+  uint objectBuffer;
+  uint texture;
+  uint samplerIndex;
+  uint transforms;
+  vec2 uvOffset;
+  vec2 uvScale;
+  uint instances;
+  float positionScale;
+  float positionOffset[3];
+} pc;
 
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragUv;
+
+vec3 decodeOctahedral(vec2 encoded) {
+  vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+  if (normal.z < 0.0) {
+    normal.xy = (1.0 - abs(normal.yx)) * vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);
+  }
+  return normalize(normal);
+}
 
 void main() {
-  gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-  fragColor = colors[gl_VertexIndex];
-}
\ No newline at end of file
+  // unbatched draws pass the object as firstInstance, batched ones look it up in the frame's
+  // instance list, which holds the objects of each batch contiguously.
+  uint object = gl_InstanceIndex;
+  vec4 sphere = inInstance;
+  if (pc.instances != 0xffffffffu) {
+    object = instanceBuffers[pc.frameData].objects[pc.instances + gl_InstanceIndex];
+    sphere = objectBuffers[pc.objectBuffer].spheres[object];
+  }
+
+  vec3 normal = kOctahedralNormals ? decodeOctahedral(inNormal.xy) : inNormal;
+  vec3 position = inPosition * pc.positionScale + vec3(pc.positionOffset[0], pc.positionOffset[1], pc.positionOffset[2]);
+  vec3 worldPosition;
+  if (pc.transforms != 0xffffffffu) {
+    // CPU computed model matrices, one per object.
+    mat4 model = buffers[pc.frameData].matrices[pc.transforms + object];
+    worldPosition = (model * vec4(position, 1.0)).xyz;
+    normal = mat3(model) * normal;
+  } else {
+    worldPosition = sphere.xyz + position * sphere.w * 2.0;
+  }
+  gl_Position = buffers[pc.frameData].matrices[pc.camera] * vec4(worldPosition, 1.0);
+  fragColor = normalize(normal) * 0.5 + 0.5;
+  fragUv = inUv * pc.uvScale + pc.uvOffset;
+}